@@ -0,0 +1,1558 @@
+#define _DEFAULT_SOURCE  /* clock_gettime, mkstemp, syscall */
+#include "../../src/tsp.h"
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Typedefs */
+typedef int (*bench_func_t)(int argc, char **argv);
+
+/* Generated instances mimic the layout of TSPA-TSPD */
+#define GEN_MAX_X 4000
+#define GEN_MAX_Y 2000
+#define GEN_MAX_COST 1000
+
+/* Auxiliary struct for defining intra moves */
+#define MOVE_TYPE_NODES 0  /* intra-route node swap */
+#define MOVE_TYPE_EDGES 1  /* intra-route edge swap */
+#define MOVE_TYPE_INTER 2  /* inter-route node swap */
+struct lsearch_move {
+	struct tsp_move indices;
+	char type;
+};
+
+/* Allocation counter, see __wrap_malloc below */
+static size_t n_allocs;
+
+struct bench {
+	const char *name;
+	const char *usage;
+	bench_func_t func;
+};
+
+int bench_scaling(int argc, char **argv);
+int bench_storage(int argc, char **argv);
+int bench_init(int argc, char **argv);
+int bench_parse(int argc, char **argv);
+int bench_matrix(int argc, char **argv);
+int bench_locality(int argc, char **argv);
+int bench_fold(int argc, char **argv);
+int bench_copy(int argc, char **argv);
+int bench_ls(int argc, char **argv);
+int bench_twolevel(int argc, char **argv);
+int bench_pool(int argc, char **argv);
+int bench_cow(int argc, char **argv);
+int bench_optstore(int argc, char **argv);
+int bench_scan(int argc, char **argv);
+int bench_intra(int argc, char **argv);
+int bench_batch(int argc, char **argv);
+int bench_eval(int argc, char **argv);
+
+static const struct bench benches[] = {
+	{ "scaling", "[n_nodes|file.tsp...]", bench_scaling },
+	{ "storage", "[n_nodes] [n_runs]", bench_storage },
+	{ "init", "[n_nodes...]", bench_init },
+	{ "parse", "[n_nodes]", bench_parse },
+	{ "matrix", "[n_nodes] [storage]", bench_matrix },
+	{ "locality", "[n_nodes] [n_moves]", bench_locality },
+	{ "fold", "[n_nodes] [n_runs]", bench_fold },
+	{ "copy", "[n_nodes] [n_copies]", bench_copy },
+	{ "ls", "[n_nodes] [n_runs]", bench_ls },
+	{ "twolevel", "[n_nodes...]", bench_twolevel },
+	{ "pool", "[n_nodes] [n_children]", bench_pool },
+	{ "cow", "[n_nodes] [population_size]", bench_cow },
+	{ "optstore", "[n_nodes] [n_samples]", bench_optstore },
+	{ "scan", "[n_nodes...]", bench_scan },
+	{ "intra", "[n_nodes...]", bench_intra },
+	{ "batch", "[n_nodes] [n_tours]", bench_batch },
+	{ "eval", "[n_nodes] [n_moves]", bench_eval },
+};
+
+
+/* Count every allocation made by the bench binary and the libraries it
+ * links statically. The Makefile links with --wrap, which sends their calls
+ * to these functions and the real allocator to __real_*. */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t n, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	__atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	__atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	__atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+	return __real_realloc(ptr, size);
+}
+
+size_t allocs_count(void)
+{
+	return __atomic_load_n(&n_allocs, __ATOMIC_RELAXED);
+}
+
+double seconds_since(clock_t time_before)
+{
+	return (double)(clock() - time_before) / CLOCKS_PER_SEC;
+}
+
+/* Wall-clock time, for code that runs on several threads */
+double wall_seconds_since(struct timespec time_before)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - time_before.tv_sec) + (now.tv_nsec - time_before.tv_nsec) / 1e9;
+}
+
+/* Peak resident set size of the process in MiB */
+double peak_rss_mib(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+/* Opens a counter of the hardware cache misses of this thread, or returns -1
+ * if there is none (e.g. in most virtual machines). */
+int cache_miss_counter_open(void)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long cache_miss_counter_read(int fd)
+{
+	long long count;
+	if (fd == -1 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+		return -1;
+	}
+	return count;
+}
+
+/* Generates a random instance with n_nodes nodes, in the same format as
+ * the one returned by tsp_nodes_read. */
+struct sp_stack *generate_nodes(size_t n_nodes)
+{
+	struct sp_stack *const nodes = sp_stack_create(sizeof(struct tsp_node), n_nodes);
+	for (size_t i = 0; i < n_nodes; i++) {
+		struct tsp_node node;
+		node.id = i;
+		node.x = randint(0, GEN_MAX_X);
+		node.y = randint(0, GEN_MAX_Y);
+		node.cost = randint(0, GEN_MAX_COST);
+		sp_stack_push(nodes, &node);
+	}
+	return nodes;
+}
+
+void greedy_cycle(struct tsp_graph *graph, size_t target_size)
+{
+	struct tsp_tour *vacant = graph->nodes_vacant;
+	struct tsp_tour *active = graph->nodes_active;
+
+	if (active->size == 0 && target_size != 0)
+		tsp_graph_activate_random(graph, 1);
+	if (active->size == 1 && target_size != 1) {
+		const size_t idx = tsp_nodes_find_nn(vacant, graph->dist_matrix, tsp_tour_peek(active));
+		tsp_graph_activate_node(graph, idx);
+	}
+	while (active->size < target_size) {
+		const struct tsp_move move = tsp_graph_find_nc(graph);
+		tsp_graph_insert(graph, move);
+	}
+}
+
+/* Builds a route by repeatedly activating the nearest vacant node to the last
+ * active one, starting from the node with the given ID in the instance file. */
+void nearest_neighbor_route(struct tsp_graph *graph, size_t target_size, unsigned start_id)
+{
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
+	unsigned id = start_id;
+	for (size_t i = 0; i < matrix->size; i++) {
+		if (tsp_dist_matrix_orig_id(matrix, i) == start_id) {
+			id = i;
+		}
+	}
+	tsp_graph_activate_node_by_id(graph, id);
+	while (graph->nodes_active->size < target_size) {
+		tsp_graph_activate_node(graph, tsp_nodes_find_nn(graph->nodes_vacant, matrix, tsp_tour_peek(graph->nodes_active)));
+	}
+}
+
+/* Whether two stacks of nodes hold the same nodes in the same order */
+bool node_records_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
+{
+	if (nodes1->size != nodes2->size) {
+		return false;
+	}
+	for (size_t i = 0; i < nodes1->size; i++) {
+		if (!tsp_node_eq(*(struct tsp_node*)sp_stack_get(nodes1, i), *(struct tsp_node*)sp_stack_get(nodes2, i))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Steepest local search that stops after max_moves improving moves.
+ * Returns the number of full neighbourhood scans. */
+size_t lsearch_steepest_moves(struct tsp_graph *graph, size_t max_moves)
+{
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_intra_rows *const rows = tsp_intra_rows_create(graph->dist_matrix->size);
+	size_t n_moves = 0;
+	size_t n_scans = 0;
+
+	bool did_improve = true;
+	while (did_improve && n_moves++ < max_moves) {
+		struct lsearch_move best_move = {0};
+		long min_delta = 0;
+		did_improve = false;
+		n_scans++;
+
+		tsp_intra_rows_load(rows, active, graph->dist_matrix);
+		for (size_t i = 0; i < active->size; i++) {
+			size_t j;
+			bool edges;
+			const long delta = tsp_intra_rows_find_best(rows, i, &j, &edges);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = edges ? MOVE_TYPE_EDGES : MOVE_TYPE_NODES;
+				did_improve = true;
+			}
+		}
+
+		for (size_t i = 0; i < active->size && vacant->size != 0; i++) {
+			size_t j;
+			const long delta = tsp_graph_find_best_inter_swap(graph, i, &j);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = MOVE_TYPE_INTER;
+				did_improve = true;
+			}
+		}
+
+		if (did_improve) {
+			const size_t i = best_move.indices.src,
+			             j = best_move.indices.dest;
+			switch (best_move.type) {
+				case MOVE_TYPE_NODES:
+					tsp_graph_swap_nodes(graph, i, j);
+				break;
+				case MOVE_TYPE_EDGES:
+					tsp_graph_swap_edges(graph, i, j);
+				break;
+				case MOVE_TYPE_INTER:
+					tsp_graph_inter_swap(graph, i, j);
+				break;
+				default:
+					error(("invalid move type"));
+				break;
+			}
+		}
+	}
+	tsp_intra_rows_destroy(rows);
+	return n_scans;
+}
+
+void lsearch_steepest(struct tsp_graph *graph)
+{
+	lsearch_steepest_moves(graph, SIZE_MAX);
+}
+
+/* Runs construction, local search, recombination and similarity on generated
+ * instances well beyond the size of TSPA-TSPD, or on TSPLIB instances given
+ * by path. Every node ID is a valid index into the per-node lookup tables,
+ * so any undersized table trips an assert. */
+int bench_scaling(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 500, 1000, 2000 };
+	const size_t n_sizes = argc > 0 ? (size_t)argc : ARRLEN(default_sizes);
+
+	random_seed(0);
+
+	printf("%8s\t%10s\t%10s\t%10s\t%10s\t%10s\t%10s\n",
+		"n_nodes", "init [s]", "cycle [s]", "ls [s]", "rcl [s]", "common [s]", "sim [s]");
+	for (size_t i = 0; i < n_sizes; i++) {
+		const char *const arg = argc > 0 ? argv[i] : NULL;
+		const bool is_file = arg != NULL && strspn(arg, "0123456789") != strlen(arg);
+		clock_t time_before;
+		double time_init, time_cycle, time_ls, time_rcl, time_common, time_sim;
+		struct tsp_graph *graph1;
+
+		time_before = clock();
+		if (is_file) {
+			graph1 = tsp_graph_read_tsplib(arg, NULL);
+		} else {
+			const size_t n_nodes = arg != NULL ? strtoul(arg, NULL, 10) : default_sizes[i];
+			struct sp_stack *const nodes = generate_nodes(n_nodes);
+			graph1 = tsp_graph_create(nodes);
+			sp_stack_destroy(nodes, NULL);
+		}
+		struct tsp_graph *const graph2 = tsp_graph_empty();
+		struct tsp_graph *const child = tsp_graph_empty();
+		tsp_graph_copy(graph2, graph1);
+		tsp_graph_copy(child, graph1);
+		time_init = seconds_since(time_before);
+
+		const size_t n_nodes = graph1->dist_matrix->size;
+		const size_t target_size = (n_nodes + 1) / 2;
+		if (n_nodes < 8) {
+			warn(("skipping instance size %zu: too small", n_nodes));
+			tsp_graph_destroy(graph1);
+			tsp_graph_destroy(graph2);
+			tsp_graph_destroy(child);
+			continue;
+		}
+
+		time_before = clock();
+		greedy_cycle(graph1, target_size);
+		time_cycle = seconds_since(time_before);
+		const unsigned long score_cycle = tsp_graph_score(graph1);
+
+		time_before = clock();
+		lsearch_steepest(graph1);
+		time_ls = seconds_since(time_before);
+		const unsigned long score_ls = tsp_graph_score(graph1);
+		assert(score_ls <= score_cycle);
+
+		time_before = clock();
+		struct sp_stack *const rcl = tsp_graph_find_rcl(graph1, MIN(10, graph1->nodes_vacant->size), 0.04);
+		time_rcl = seconds_since(time_before);
+		for (size_t j = 0; j < rcl->size; j++) {
+			const struct tsp_move move = *(struct tsp_move*)sp_stack_get(rcl, j);
+			assert(move.src < graph1->nodes_vacant->size);
+		}
+		sp_stack_destroy(rcl, NULL);
+
+		tsp_graph_activate_random(graph2, target_size);
+		time_before = clock();
+		tsp_graph_activate_common_from_parents(child, graph1, graph2);
+		time_common = seconds_since(time_before);
+		assert(child->nodes_active->size <= target_size);
+
+		time_before = clock();
+		const size_t sim_nodes_self = tsp_graph_compute_similarity_nodes(graph1, graph1);
+		const size_t sim_edges_self = tsp_graph_compute_similarity_edges(graph1, graph1);
+		const size_t sim_nodes = tsp_graph_compute_similarity_nodes(graph1, graph2);
+		const size_t sim_edges = tsp_graph_compute_similarity_edges(graph1, graph2);
+		time_sim = seconds_since(time_before);
+		assert(sim_nodes_self == target_size);
+		assert(sim_edges_self == target_size);
+		assert(sim_nodes <= target_size);
+		assert(sim_edges <= sim_nodes);
+
+		printf("%8zu\t%10.3f\t%10.3f\t%10.3f\t%10.3f\t%10.3f\t%10.3f\n",
+			n_nodes, time_init, time_cycle, time_ls, time_rcl, time_common, time_sim);
+		info(("n_nodes=%zu: cycle score %lu, ls score %lu, similarity to random %zu nodes / %zu edges",
+			n_nodes, score_cycle, score_ls, sim_nodes, sim_edges));
+
+		tsp_graph_destroy(graph1);
+		tsp_graph_destroy(graph2);
+		tsp_graph_destroy(child);
+	}
+	return 0;
+}
+
+/* Runs the same steepest local searches on every distance matrix backend */
+int bench_storage(int argc, char **argv)
+{
+	static const enum tsp_dist_storage backends[] = {
+		TSP_DIST_DENSE,
+		TSP_DIST_PACKED,
+		TSP_DIST_TILED,
+		TSP_DIST_COMPUTED,
+	};
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 500;
+	const size_t n_runs = argc > 1 ? strtoul(argv[1], NULL, 10) : 5;
+	unsigned long reference_score_sum = 0;
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+
+	printf("%-10s\t%10s\t%12s\t%10s\t%12s\t%10s\n",
+		"storage", "elem [B]", "matrix [KiB]", "init [s]", "ls avg [s]", "hit rate");
+	for (size_t i = 0; i < ARRLEN(backends); i++) {
+		const char *const name = tsp_dist_storage_name(backends[i]);
+		unsigned long score_sum = 0;
+		double time_ls = 0.0;
+		double hit_rate = 1.0;
+		clock_t time_before;
+
+		tsp_dist_matrix_set_default_storage(backends[i]);
+		time_before = clock();
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		const double time_init = seconds_since(time_before);
+
+		/* Every backend starts from the same sequence of random solutions */
+		random_seed(1);
+		for (size_t j = 0; j < n_runs; j++) {
+			tsp_graph_deactivate_all(graph);
+			tsp_graph_activate_random(graph, n_nodes / 2);
+			time_before = clock();
+			lsearch_steepest(graph);
+			time_ls += seconds_since(time_before);
+			score_sum += tsp_graph_score(graph);
+		}
+		if (i == 0) {
+			reference_score_sum = score_sum;
+		} else if (score_sum != reference_score_sum) {
+			error(("storage %s changed the results: %lu != %lu", name, score_sum, reference_score_sum));
+		}
+		if (graph->dist_matrix->cache != NULL) {
+			const struct tsp_dist_cache *const cache = graph->dist_matrix->cache;
+			hit_rate = (double)cache->n_hits / MAX(1, cache->n_hits + cache->n_computed);
+		}
+
+		printf("%-10s\t%10zu\t%12.1f\t%10.3f\t%12.3f\t%10.3f\n",
+			name,
+			graph->dist_matrix->elem_size,
+			tsp_dist_matrix_nbytes(graph->dist_matrix) / 1024.0,
+			time_init,
+			time_ls / n_runs,
+			hit_rate);
+		tsp_graph_destroy(graph);
+	}
+	tsp_dist_matrix_set_default_storage(TSP_DIST_DENSE);
+
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Times the distance matrix initialization of every stored backend on one
+ * thread and on all CPUs, with the kernels of every instruction set the CPU
+ * supports, and checks every distance against the scalar euclidean_dist and
+ * ROUND. */
+int bench_init(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 2000, 5000, 10000 };
+	static const enum tsp_dist_storage backends[] = {
+		TSP_DIST_DENSE,
+		TSP_DIST_PACKED,
+		TSP_DIST_TILED,
+	};
+	const size_t n_sizes = argc > 0 ? (size_t)argc : ARRLEN(default_sizes);
+	const enum tsp_isa prev_isa = tsp_simd_isa();
+
+	random_seed(0);
+
+	printf("%8s\t%-10s\t%-8s\t%12s\t%12s\n", "n_nodes", "storage", "isa", "1 thread [s]", "all CPUs [s]");
+	for (size_t i = 0; i < n_sizes; i++) {
+		const size_t n_nodes = argc > 0 ? strtoul(argv[i], NULL, 10) : default_sizes[i];
+		struct sp_stack *const nodes = generate_nodes(n_nodes);
+
+		for (size_t j = 0; j < ARRLEN(backends); j++) {
+			for (enum tsp_isa isa = TSP_ISA_SCALAR; isa <= tsp_simd_cpu_isa(); isa++) {
+				struct tsp_dist_matrix matrix;
+				struct timespec time_before;
+				double time_single, time_multi;
+
+				tsp_simd_set_isa(isa);
+				tsp_dist_matrix_set_threads(1);
+				clock_gettime(CLOCK_MONOTONIC, &time_before);
+				tsp_dist_matrix_init_storage(&matrix, nodes, backends[j]);
+				time_single = wall_seconds_since(time_before);
+				tsp_dist_matrix_free(&matrix);
+
+				tsp_dist_matrix_set_threads(0);
+				clock_gettime(CLOCK_MONOTONIC, &time_before);
+				tsp_dist_matrix_init_storage(&matrix, nodes, backends[j]);
+				time_multi = wall_seconds_since(time_before);
+
+				for (size_t id1 = 0; id1 < n_nodes; id1++) {
+					const struct tsp_node node1 = matrix.nodes[id1];
+					for (size_t id2 = 0; id2 < n_nodes; id2++) {
+						const struct tsp_node node2 = matrix.nodes[id2];
+						const unsigned long expected = ROUND(euclidean_dist(node1.x, node1.y, node2.x, node2.y));
+						if (mdist(id1, id2, &matrix) != expected) {
+							error(("%s, %s: distance %zu-%zu is %lu instead of %lu", tsp_dist_storage_name(backends[j]),
+								tsp_simd_isa_name(isa), id1, id2, mdist(id1, id2, &matrix), expected));
+						}
+					}
+				}
+				tsp_dist_matrix_free(&matrix);
+
+				printf("%8zu\t%-10s\t%-8s\t%12.3f\t%12.3f\n",
+					n_nodes, tsp_dist_storage_name(backends[j]), tsp_simd_isa_name(isa), time_single, time_multi);
+			}
+		}
+		sp_stack_destroy(nodes, NULL);
+	}
+	tsp_simd_set_isa(prev_isa);
+	return 0;
+}
+
+/* Writes a generated instance to a temporary CSV file and times reading it
+ * back with tsp_nodes_read against a plain fscanf loop. */
+int bench_parse(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 1000000;
+	char fpath[] = "/tmp/bench_parse_XXXXXX";
+	struct timespec time_before;
+	double time_fscanf, time_read;
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+
+	const int fd = mkstemp(fpath);
+	FILE *f = fd == -1 ? NULL : fdopen(fd, "w");
+	if (f == NULL) {
+		error(("failed to create a temporary file"));
+	}
+	for (size_t i = 0; i < n_nodes; i++) {
+		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes, n_nodes - 1 - i);
+		fprintf(f, "%d;%d;%d\n", node.x, node.y, node.cost);
+	}
+	fclose(f);
+
+	/* The reference parser, as tsp_nodes_read used to be */
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	struct sp_stack *const reference = sp_stack_create(sizeof(struct tsp_node), 200);
+	f = fopen(fpath, "r");
+	for (;;) {
+		struct tsp_node node;
+		if (fscanf(f, "%d;%d;%d\n", &node.x, &node.y, &node.cost) != 3) {
+			break;
+		}
+		node.id = reference->size;
+		sp_stack_push(reference, &node);
+	}
+	fclose(f);
+	time_fscanf = wall_seconds_since(time_before);
+
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	struct sp_stack *const parsed = tsp_nodes_read(fpath);
+	time_read = wall_seconds_since(time_before);
+	unlink(fpath);
+
+	if (!node_records_eq(parsed, nodes) || !node_records_eq(reference, nodes)) {
+		error(("parsed nodes differ from the generated ones"));
+	}
+	printf("%8s\t%12s\t%14s\n", "n_nodes", "fscanf [s]", "nodes_read [s]");
+	printf("%8zu\t%12.3f\t%14.3f\n", n_nodes, time_fscanf, time_read);
+
+	sp_stack_destroy(reference, NULL);
+	sp_stack_destroy(parsed, NULL);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Writes the distances and costs of a generated instance to temporary text
+ * files, and times reading them back with tsp_dist_matrix_read. The peak RSS
+ * shows that the text is never held in memory. */
+int bench_matrix(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 20000;
+	const char *const storage_name = argc > 1 ? argv[1] : "packed";
+	enum tsp_dist_storage storage = TSP_DIST_AUTO;
+	char matrix_fpath[] = "/tmp/bench_matrix_XXXXXX";
+	char costs_fpath[] = "/tmp/bench_costs_XXXXXX";
+	struct tsp_dist_matrix matrix;
+	struct timespec time_before;
+	FILE *f;
+
+	for (int i = TSP_DIST_DENSE; i <= TSP_DIST_AUTO; i++) {
+		if (strcmp(storage_name, tsp_dist_storage_name(i)) == 0) {
+			storage = i;
+		}
+	}
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	const struct tsp_node *const nodes_data = nodes->data;
+
+	/* Rows are written straight from the coordinates, so that no matrix
+	 * exists before the one being read */
+	int fd = mkstemp(matrix_fpath);
+	if (fd == -1 || (f = fdopen(fd, "w")) == NULL) {
+		error(("failed to create a temporary file"));
+	}
+	for (size_t i = 0; i < n_nodes; i++) {
+		for (size_t j = 0; j < n_nodes; j++) {
+			const unsigned long dist = ROUND(euclidean_dist(nodes_data[i].x, nodes_data[i].y, nodes_data[j].x, nodes_data[j].y));
+			fprintf(f, j == 0 ? "%lu" : " %lu", dist);
+		}
+		fputc('\n', f);
+	}
+	const double file_mib = ftell(f) / (1024.0 * 1024.0);
+	fclose(f);
+	fd = mkstemp(costs_fpath);
+	if (fd == -1 || (f = fdopen(fd, "w")) == NULL) {
+		error(("failed to create a temporary file"));
+	}
+	for (size_t i = 0; i < n_nodes; i++) {
+		fprintf(f, "%d\n", nodes_data[i].cost);
+	}
+	fclose(f);
+
+	const double rss_before = peak_rss_mib();
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	tsp_dist_matrix_read_storage(&matrix, matrix_fpath, costs_fpath, storage);
+	const double time_read = wall_seconds_since(time_before);
+	const double rss_after = peak_rss_mib();
+	unlink(matrix_fpath);
+	unlink(costs_fpath);
+
+	for (size_t i = 0; i < n_nodes; i++) {
+		if (matrix.nodes[i].cost != nodes_data[i].cost) {
+			error(("cost of node %zu is %d instead of %d", i, matrix.nodes[i].cost, nodes_data[i].cost));
+		}
+		for (size_t j = 0; j < n_nodes; j++) {
+			const unsigned long dist = ROUND(euclidean_dist(nodes_data[i].x, nodes_data[i].y, nodes_data[j].x, nodes_data[j].y));
+			if (mdist(i, j, &matrix) != dist) {
+				error(("distance %zu-%zu is %lu instead of %lu", i, j, mdist(i, j, &matrix), dist));
+			}
+		}
+	}
+
+	printf("%8s\t%-10s\t%10s\t%10s\t%10s\t%12s\t%14s\n",
+		"n_nodes", "storage", "file [MiB]", "read [s]", "MiB/s", "matrix [MiB]", "peak RSS [MiB]");
+	printf("%8zu\t%-10s\t%10.1f\t%10.3f\t%10.1f\t%12.1f\t%6.1f -> %5.1f\n",
+		n_nodes, tsp_dist_storage_name(matrix.storage), file_mib, time_read, file_mib / time_read,
+		tsp_dist_matrix_nbytes(&matrix) / (1024.0 * 1024.0), rss_before, rss_after);
+
+	tsp_dist_matrix_free(&matrix);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Runs the same steepest local search moves on a generated instance with the
+ * node IDs of the CSV file and with nodes renumbered for locality, and
+ * reports the hardware cache misses where they can be counted. The mean ID
+ * gap between consecutive route nodes shows how far apart their distances
+ * are stored either way. */
+int bench_locality(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 10000;
+	const size_t n_moves = argc > 1 ? strtoul(argv[1], NULL, 10) : 10;
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	if (n_nodes < 8) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	printf("%-10s\t%10s\t%10s\t%10s\t%14s\t%10s\t%10s\n",
+		"numbering", "init [s]", "route [s]", "ls [s]", "cache misses", "ID gap", "score");
+	for (int renumber = 0; renumber <= 1; renumber++) {
+		struct timespec time_before;
+		double time_init, time_route, time_ls;
+		double id_gap = 0.0;
+		long long misses = -1;
+
+		tsp_dist_matrix_set_renumbering(renumber);
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		time_init = wall_seconds_since(time_before);
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		nearest_neighbor_route(graph, n_nodes / 2, 0);
+		time_route = wall_seconds_since(time_before);
+
+		const int fd = cache_miss_counter_open();
+		const long long misses_before = cache_miss_counter_read(fd);
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		lsearch_steepest_moves(graph, n_moves);
+		time_ls = wall_seconds_since(time_before);
+		const long long misses_after = cache_miss_counter_read(fd);
+		if (fd != -1) {
+			close(fd);
+		}
+		if (misses_before != -1 && misses_after != -1) {
+			misses = misses_after - misses_before;
+		}
+
+		const struct tsp_tour *const active = graph->nodes_active;
+		for (size_t i = 0; i < active->size; i++) {
+			const unsigned id1 = tsp_tour_get(active, i);
+			const unsigned id2 = tsp_tour_get(active, (i + 1) % active->size);
+			id_gap += id1 > id2 ? id1 - id2 : id2 - id1;
+		}
+		id_gap /= active->size;
+
+		printf("%-10s\t%10.3f\t%10.3f\t%10.3f\t",
+			renumber ? "locality" : "file", time_init, time_route, time_ls);
+		if (misses == -1) {
+			printf("%14s", "n/a");
+		} else {
+			printf("%14lld", misses);
+		}
+		printf("\t%10.1f\t%10lu\n", id_gap, tsp_nodes_evaluate(active, graph->dist_matrix));
+		tsp_graph_destroy(graph);
+	}
+	tsp_dist_matrix_set_renumbering(false);
+
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Runs inter-route scans, greedy cycle construction and steepest local search
+ * with plain distances and with the costs folded into the matrix
+ * (tsp_dist_matrix_fold_costs). Results must be identical. */
+int bench_fold(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 500;
+	const size_t n_runs = argc > 1 ? strtoul(argv[1], NULL, 10) : 3;
+	unsigned long reference[3] = { 0 };
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	if (n_nodes < 8) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	printf("%-8s\t%10s\t%12s\t%10s\t%10s\n", "costs", "fold [s]", "scan avg [s]", "cycle [s]", "ls avg [s]");
+	for (int fold = 0; fold <= 1; fold++) {
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		unsigned long results[3] = { 0 };
+		double time_fold = 0.0, time_scan = 0.0, time_cycle, time_ls = 0.0;
+		clock_t time_before;
+
+		if (fold) {
+			time_before = clock();
+			if (!tsp_dist_matrix_fold_costs(graph->dist_matrix)) {
+				error(("the folded weights do not fit"));
+			}
+			time_fold = seconds_since(time_before);
+		}
+
+		/* Every variant starts from the same sequence of random solutions */
+		random_seed(1);
+		for (size_t i = 0; i < n_runs; i++) {
+			tsp_graph_deactivate_all(graph);
+			tsp_graph_activate_random(graph, n_nodes / 2);
+			time_before = clock();
+			for (size_t j = 0; j < graph->nodes_active->size; j++) {
+				for (size_t k = 0; k < graph->nodes_vacant->size; k++) {
+					results[0] += tsp_graph_evaluate_inter_swap(graph, j, k);
+				}
+			}
+			time_scan += seconds_since(time_before);
+
+			time_before = clock();
+			lsearch_steepest(graph);
+			time_ls += seconds_since(time_before);
+			results[1] += tsp_graph_score(graph);
+		}
+
+		tsp_graph_deactivate_all(graph);
+		tsp_graph_activate_node_by_id(graph, 0);
+		time_before = clock();
+		greedy_cycle(graph, n_nodes / 2);
+		time_cycle = seconds_since(time_before);
+		results[2] = tsp_graph_score(graph);
+
+		for (size_t i = 0; i < ARRLEN(results); i++) {
+			if (!fold) {
+				reference[i] = results[i];
+			} else if (results[i] != reference[i]) {
+				error(("folding the costs changed result %zu: %lu != %lu", i, results[i], reference[i]));
+			}
+		}
+		printf("%-8s\t%10.3f\t%12.3f\t%10.3f\t%10.3f\n",
+			fold ? "folded" : "separate", time_fold, time_scan / n_runs, time_cycle, time_ls / n_runs);
+		tsp_graph_destroy(graph);
+	}
+
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Times copying a solution with tsp_graph_copy, which shares the instance,
+ * against a deep copy of the distance matrix as tsp_graph_copy used to make,
+ * and reports the memory taken by a population of shared graphs. */
+int bench_copy(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 2000;
+	const size_t n_copies = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+	struct tsp_dist_matrix deep_copy;
+	struct timespec time_before;
+	double time_shared, time_deep;
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	tsp_graph_activate_random(graph, n_nodes / 2);
+	const double rss_before = peak_rss_mib();
+
+	struct tsp_graph **const population = malloc_or_die(MAX(1, n_copies) * sizeof(struct tsp_graph*));
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	for (size_t i = 0; i < n_copies; i++) {
+		population[i] = tsp_graph_empty();
+		tsp_graph_copy(population[i], graph);
+	}
+	time_shared = wall_seconds_since(time_before);
+	const double rss_after = peak_rss_mib();
+	for (size_t i = 0; i < n_copies; i++) {
+		if (tsp_graph_score(population[i]) != tsp_graph_score(graph)) {
+			error(("copy %zu differs from the original", i));
+		}
+		tsp_graph_destroy(population[i]);
+	}
+	free(population);
+
+	tsp_dist_matrix_init_empty(&deep_copy);
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	for (size_t i = 0; i < n_copies; i++) {
+		tsp_dist_matrix_free(&deep_copy);
+		tsp_dist_matrix_copy(&deep_copy, graph->dist_matrix);
+	}
+	time_deep = wall_seconds_since(time_before);
+	tsp_dist_matrix_free(&deep_copy);
+
+	printf("%8s\t%8s\t%16s\t%16s\t%14s\n",
+		"n_nodes", "n_copies", "shared copy [us]", "matrix copy [us]", "peak RSS [MiB]");
+	printf("%8zu\t%8zu\t%16.2f\t%16.2f\t%6.1f -> %5.1f\n",
+		n_nodes, n_copies, time_shared * 1e6 / MAX(1, n_copies), time_deep * 1e6 / MAX(1, n_copies), rss_before, rss_after);
+
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Runs steepest local searches from random solutions of a generated instance
+ * and reports how many moves they evaluate per second. Every scan evaluates
+ * both intra-route moves for each pair of route positions and an inter-route
+ * swap for each pair of a route and a vacant node. */
+int bench_ls(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 500;
+	const size_t n_runs = argc > 1 ? strtoul(argv[1], NULL, 10) : 3;
+	double n_evals = 0.0;
+	double time_ls = 0.0;
+	size_t n_scans = 0;
+	unsigned long score_sum = 0;
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	if (n_nodes < 2) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	for (size_t i = 0; i < n_runs; i++) {
+		struct timespec time_before;
+		tsp_graph_deactivate_all(graph);
+		tsp_graph_activate_random(graph, n_nodes / 2);
+		const double n_active = graph->nodes_active->size;
+		const double n_vacant = graph->nodes_vacant->size;
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		const size_t scans = lsearch_steepest_moves(graph, SIZE_MAX);
+		time_ls += wall_seconds_since(time_before);
+		n_scans += scans;
+		n_evals += scans * (n_active * (n_active + 1) + n_active * n_vacant);
+		score_sum += tsp_graph_score(graph);
+	}
+
+	printf("%8s\t%6s\t%10s\t%8s\t%14s\t%10s\t%10s\n",
+		"n_nodes", "n_runs", "ls avg [s]", "scans", "evals/s [1e6]", "ns/eval", "score avg");
+	printf("%8zu\t%6zu\t%10.3f\t%8zu\t%14.1f\t%10.2f\t%10lu\n",
+		n_nodes, n_runs, time_ls / MAX(1, n_runs), n_scans,
+		n_evals / time_ls / 1e6, time_ls * 1e9 / n_evals, score_sum / MAX(1, n_runs));
+
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Times random 2-opt moves on a flat tour and on a two-level list */
+int bench_twolevel(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 500, 2000, 10000, 100000 };
+	const size_t n_sizes = argc > 0 ? (size_t)argc : ARRLEN(default_sizes);
+	const size_t n_moves = 20000;
+	const size_t n_gets = 1000000;
+
+	printf("%8s\t%8s\t%16s\t%16s\t%10s\t%9s\n",
+		"n_nodes", "moves", "array [us/move]", "2-level [us/move]", "get [ns]", "preferred");
+	for (size_t i = 0; i < n_sizes; i++) {
+		const size_t n_nodes = argc > 0 ? strtoul(argv[i], NULL, 10) : default_sizes[i];
+		if (n_nodes < 2) {
+			error(("instance size %zu is too small", n_nodes));
+		}
+		struct timespec time_before;
+
+		/* Random route and random 2-opt moves */
+		random_seed(0);
+		struct tsp_tour *const tour = tsp_tour_create(n_nodes);
+		tsp_tour_fill(tour, n_nodes);
+		tsp_tour_shuffle_top(tour, n_nodes - 1);
+		struct tsp_move *const moves = malloc_or_die(n_moves * sizeof(struct tsp_move));
+		for (size_t j = 0; j < n_moves; j++) {
+			moves[j].src = randint(0, n_nodes - 1);
+			moves[j].dest = randint(0, n_nodes - 1);
+		}
+		struct tsp_tlist *const list = tsp_tlist_create(tour);
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t j = 0; j < n_moves; j++) {
+			tsp_nodes_swap_edges(tour, moves[j].src, moves[j].dest);
+		}
+		const double time_array = wall_seconds_since(time_before);
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t j = 0; j < n_moves; j++) {
+			tsp_tlist_swap_edges(list, moves[j].src, moves[j].dest);
+		}
+		const double time_tlist = wall_seconds_since(time_before);
+
+		volatile tsp_id sink;
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t j = 0; j < n_gets; j++) {
+			sink = tsp_tlist_get(list, (j * 7919) % n_nodes);
+		}
+		(void)sink;
+		const double time_get = wall_seconds_since(time_before);
+
+		/* Both representations must hold the same route */
+		for (size_t j = 0; j < n_nodes; j++) {
+			if (tsp_tour_get(tour, j) != tsp_tlist_get(list, j)) {
+				error(("routes differ at index %zu", j));
+			}
+		}
+
+		printf("%8zu\t%8zu\t%16.3f\t%16.3f\t%10.1f\t%9s\n",
+			n_nodes, n_moves, time_array * 1e6 / n_moves, time_tlist * 1e6 / n_moves,
+			time_get * 1e9 / n_gets, tsp_tlist_preferred(n_nodes) ? "2-level" : "array");
+
+		tsp_tlist_destroy(list);
+		tsp_tour_destroy(tour);
+		free(moves);
+	}
+	return 0;
+}
+
+/* One steady-state generation of the evolutionary algorithm of task 9:
+ * recombines population_size children, each replacing the worst solution
+ * if it is better and not already in the population */
+void evolve(struct tsp_graph **population, size_t population_size, struct tsp_graph *child)
+{
+	for (size_t k = 0; k < population_size; k++) {
+		const size_t parent1_idx = randint(0, population_size - 1);
+		size_t parent2_idx = parent1_idx;
+		while (parent2_idx == parent1_idx) {
+			parent2_idx = randint(0, population_size - 1);
+		}
+		const size_t target_size = population[parent1_idx]->nodes_active->size;
+
+		tsp_graph_deactivate_all(child);
+		tsp_graph_activate_common_from_parents(child, population[parent1_idx], population[parent2_idx]);
+		while (child->nodes_active->size < target_size) {
+			tsp_graph_insert(child, tsp_graph_find_nc(child));
+		}
+
+		size_t worst_idx = 0;
+		bool is_duplicate = false;
+		for (size_t l = 0; l < population_size; l++) {
+			is_duplicate = is_duplicate || tsp_graph_eq(child, population[l]);
+			if (tsp_graph_score(population[l]) > tsp_graph_score(population[worst_idx])) {
+				worst_idx = l;
+			}
+		}
+		if (!is_duplicate && tsp_graph_score(child) < tsp_graph_score(population[worst_idx])) {
+			tsp_graph_copy(population[worst_idx], child);
+		}
+	}
+}
+
+/* Runs the steady-state loop of task 9 with the child created and destroyed
+ * every generation, and with the population and the child taken from a
+ * tsp_graph_pool, counting the allocations made inside the loop */
+int bench_pool(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 200;
+	const size_t n_children = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+	const size_t population_size = 20;
+	const size_t n_generations = MAX(1, n_children / population_size);
+	if (n_nodes < 4) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	struct tsp_graph **const population = malloc_or_die(population_size * sizeof(struct tsp_graph*));
+
+	printf("%8s\t%10s\t%10s\t%14s\t%12s\t%10s\n",
+		"n_nodes", "mode", "children", "allocs/child", "us/child", "best");
+	for (int pooled = 0; pooled < 2; pooled++) {
+		struct tsp_graph_pool *const pool = tsp_graph_pool_create(graph, population_size + 1);
+		struct timespec time_before;
+
+		random_seed(0);
+		for (size_t i = 0; i < population_size; i++) {
+			population[i] = pooled ? tsp_graph_pool_acquire(pool) : tsp_graph_create_shared(graph);
+			tsp_graph_activate_random(population[i], n_nodes / 2);
+			lsearch_steepest(population[i]);
+		}
+
+		const size_t allocs_before = allocs_count();
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t i = 0; i < n_generations; i++) {
+			struct tsp_graph *const child = pooled ? tsp_graph_pool_acquire(pool) : tsp_graph_create_shared(graph);
+			evolve(population, population_size, child);
+			if (pooled) {
+				tsp_graph_pool_release(pool, child);
+			} else {
+				tsp_graph_destroy(child);
+			}
+		}
+		const double time_loop = wall_seconds_since(time_before);
+		const size_t allocs = allocs_count() - allocs_before;
+
+		unsigned long best = ULONG_MAX;
+		for (size_t i = 0; i < population_size; i++) {
+			best = MIN(best, tsp_graph_score(population[i]));
+			if (pooled) {
+				tsp_graph_pool_release(pool, population[i]);
+			} else {
+				tsp_graph_destroy(population[i]);
+			}
+		}
+		printf("%8zu\t%10s\t%10zu\t%14.2f\t%12.2f\t%10lu\n",
+			n_nodes, pooled ? "pooled" : "malloc", n_generations * population_size,
+			(double)allocs / (n_generations * population_size),
+			time_loop * 1e6 / (n_generations * population_size), best);
+		tsp_graph_pool_destroy(pool);
+	}
+
+	free(population);
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Applies a few random moves of every local search neighbourhood to a route.
+ * 2-opt moves reverse at most 2 * max_reversal + 1 nodes. */
+void perturb_route(struct tsp_tour *route, size_t n_moves, size_t n_ids, size_t max_reversal)
+{
+	for (size_t i = 0; i < n_moves; i++) {
+		const size_t idx = randint(0, route->size - 1);
+		switch (randint(0, 2)) {
+			case 0:
+				tsp_nodes_swap_nodes(route, idx, randint(0, route->size - 1));
+			break;
+			case 1: {
+				const size_t end = idx + randint(1, 2 * max_reversal);
+				tsp_nodes_swap_edges(route, idx, MIN(route->size - 1, end));
+			} break;
+			default: {
+				size_t id;
+				do {
+					id = randint(0, n_ids - 1);
+				} while (tsp_tour_contains(route, id));
+				tsp_tour_set(route, idx, id);
+			} break;
+		}
+	}
+}
+
+/* Grows a population of solutions, each a perturbed copy of a random earlier
+ * one, and stores it both as full tour copies and as cowtours sharing one
+ * chunk store. Reports the footprint of both and the time per stored
+ * solution, and checks that every cowtour reads back as the route stored. */
+int bench_cow(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 2000;
+	const size_t population_size = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000;
+	const size_t n_moves = 5;
+	if (n_nodes < 8 || population_size < 1) {
+		error(("instance size %zu or population size %zu is too small", n_nodes, population_size));
+	}
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	nearest_neighbor_route(graph, n_nodes / 2, 0);
+
+	struct tsp_chunk_store *const store = tsp_chunk_store_create(4096);
+	struct tsp_cowtour **const population = malloc_or_die(population_size * sizeof(struct tsp_cowtour *));
+	size_t *const hashes = malloc_or_die(population_size * sizeof(size_t));
+	struct tsp_tour *const route = tsp_tour_create(n_nodes);
+	struct tsp_tour *const route_copy = tsp_tour_create(n_nodes);
+	double time_cow = 0.0, time_copy = 0.0;
+
+	for (size_t i = 0; i < population_size; i++) {
+		struct timespec time_before;
+		if (i == 0) {
+			tsp_tour_copy(route, graph->nodes_active);
+		} else {
+			tsp_cowtour_to_tour(population[randint(0, i - 1)], route);
+			perturb_route(route, n_moves, n_nodes, 25);
+		}
+		hashes[i] = tsp_nodes_hash(route);
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		population[i] = tsp_cowtour_create(store);
+		tsp_cowtour_assign(population[i], route);
+		time_cow += wall_seconds_since(time_before);
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		tsp_tour_copy(route_copy, route);
+		time_copy += wall_seconds_since(time_before);
+	}
+
+	size_t cow_bytes = tsp_chunk_store_footprint(store);
+	for (size_t i = 0; i < population_size; i++) {
+		cow_bytes += sizeof(struct tsp_cowtour) + population[i]->capacity * sizeof(struct tsp_chunk *);
+		tsp_cowtour_to_tour(population[i], route);
+		if (tsp_nodes_hash(route) != hashes[i]) {
+			error(("solution %zu reads back differently", i));
+		}
+	}
+	const size_t copy_bytes = population_size * (sizeof(struct tsp_tour) + route_copy->capacity * sizeof(tsp_id) + route_copy->n_ids * sizeof(uint32_t));
+
+	printf("%8s\t%10s\t%8s\t%14s\t%12s\t%12s\t%12s\n",
+		"n_nodes", "population", "chunks", "copies [MiB]", "cow [MiB]", "copy [us]", "cow [us]");
+	printf("%8zu\t%10zu\t%8zu\t%14.2f\t%12.2f\t%12.2f\t%12.2f\n",
+		n_nodes, population_size, tsp_chunk_store_count(store),
+		copy_bytes / 1048576.0, cow_bytes / 1048576.0,
+		time_copy * 1e6 / population_size, time_cow * 1e6 / population_size);
+
+	for (size_t i = 0; i < population_size; i++) {
+		tsp_cowtour_destroy(population[i]);
+	}
+	tsp_chunk_store_destroy(store);
+	tsp_tour_destroy(route);
+	tsp_tour_destroy(route_copy);
+	free(hashes);
+	free(population);
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Writes perturbed variants of a route of a generated instance to a solution
+ * store, in memory and backed by a temporary file, and scans them back.
+ * Reports bytes per record against full graphs and raw ID arrays, and the
+ * time per record written and read. */
+int bench_optstore(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 200;
+	const size_t n_samples = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+	char fpath[] = "/tmp/bench_optstore_XXXXXX";
+	if (n_nodes < 8) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+	const int fd = mkstemp(fpath);
+	if (fd == -1) {
+		error(("failed to create a temporary file"));
+	}
+	close(fd);
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	nearest_neighbor_route(graph, n_nodes / 2, 0);
+	struct tsp_tour *const route = tsp_tour_create(n_nodes);
+	size_t *const hashes = malloc_or_die(MAX(1, n_samples) * sizeof(size_t));
+	const size_t graph_bytes = sizeof(struct tsp_graph) + 2 * sizeof(struct tsp_tour)
+		+ n_nodes * (sizeof(tsp_id) + sizeof(uint32_t)) * 2 + (n_nodes + 63) / 64 * sizeof(uint64_t);
+	const size_t raw_bytes = (n_nodes / 2) * sizeof(tsp_id) + sizeof(unsigned long);
+
+	printf("%8s\t%10s\t%8s\t%12s\t%12s\t%12s\t%12s\t%12s\n",
+		"n_nodes", "samples", "backing", "graph [B]", "raw [B]", "store [B]", "write [us]", "read [us]");
+	for (int on_disk = 0; on_disk < 2; on_disk++) {
+		struct tsp_optstore *const store = tsp_optstore_create(on_disk ? fpath : NULL);
+		struct tsp_optstore_reader reader;
+		struct timespec time_before;
+		double time_write = 0.0;
+		unsigned long score;
+
+		random_seed(1);
+		tsp_tour_copy(route, graph->nodes_active);
+		for (size_t i = 0; i < n_samples; i++) {
+			perturb_route(route, 5, n_nodes, 10);
+			score = tsp_nodes_evaluate(route, graph->dist_matrix);
+			hashes[i] = tsp_nodes_hash(route) ^ score;
+			clock_gettime(CLOCK_MONOTONIC, &time_before);
+			tsp_optstore_append(store, route, score);
+			time_write += wall_seconds_since(time_before);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		tsp_optstore_reader_open(&reader, store);
+		while (tsp_optstore_read(&reader, route, &score)) {
+			if ((tsp_nodes_hash(route) ^ score) != hashes[reader.index - 1]) {
+				error(("record %zu reads back differently", reader.index - 1));
+			}
+		}
+		tsp_optstore_reader_close(&reader);
+		const double time_read = wall_seconds_since(time_before);
+		if (reader.index != n_samples) {
+			error(("read %zu records out of %zu", reader.index, n_samples));
+		}
+
+		printf("%8zu\t%10zu\t%8s\t%12zu\t%12zu\t%12.1f\t%12.2f\t%12.2f\n",
+			n_nodes, n_samples, on_disk ? "file" : "memory", graph_bytes, raw_bytes,
+			(double)store->size / MAX(1, n_samples),
+			time_write * 1e6 / MAX(1, n_samples), time_read * 1e6 / MAX(1, n_samples));
+		tsp_optstore_destroy(store);
+	}
+
+	unlink(fpath);
+	free(hashes);
+	tsp_tour_destroy(route);
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Scans of the vacant nodes made by one steepest local search scan: the
+ * nearest neighbor of every active node, the best node to insert after every
+ * active node and the best inter-route swap of every active node. Results are
+ * written to out, so that the scalar and vectorized kernels can be compared. */
+double scan_vacant(const struct tsp_graph *graph, size_t n_reps, long *out)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct timespec time_before;
+
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	for (size_t r = 0; r < n_reps; r++) {
+		for (size_t i = 0; i < active->size; i++) {
+			const tsp_id id = tsp_tour_get(active, i);
+			const tsp_id next_id = tsp_tour_get(active, (i + 1) % active->size);
+			size_t j;
+			out[3 * i] = tsp_nodes_find_nn(vacant, graph->dist_matrix, id);
+			out[3 * i + 1] = tsp_nodes_find_2nn(vacant, graph->dist_matrix, id, next_id);
+			out[3 * i + 2] = tsp_graph_find_best_inter_swap(graph, i, &j) * (long)vacant->size + j;
+		}
+	}
+	return wall_seconds_since(time_before);
+}
+
+/* Times the vacant-node scans with the kernels of every instruction set */
+int bench_scan(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 200, 1000, 4000 };
+	const size_t n_sizes = argc > 0 ? (size_t)argc : ARRLEN(default_sizes);
+	const enum tsp_isa prev_isa = tsp_simd_isa();
+
+	printf("%8s\t%8s\t%8s\t%12s\t%8s\n",
+		"n_nodes", "reps", "isa", "ns/id", "speedup");
+	for (size_t i = 0; i < n_sizes; i++) {
+		const size_t n_nodes = argc > 0 ? strtoul(argv[i], NULL, 10) : default_sizes[i];
+		if (n_nodes < 4) {
+			error(("instance size %zu is too small", n_nodes));
+		}
+
+		random_seed(0);
+		struct sp_stack *const nodes = generate_nodes(n_nodes);
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		tsp_graph_activate_random(graph, n_nodes / 2);
+		const size_t n_active = graph->nodes_active->size;
+		const size_t n_reps = MAX(1, 20000000 / (n_active * graph->nodes_vacant->size * 3));
+		const double n_ids = (double)n_reps * n_active * graph->nodes_vacant->size * 3;
+		long *const scalar = malloc_or_die(3 * n_active * sizeof(long));
+		long *const simd = malloc_or_die(3 * n_active * sizeof(long));
+		double time_scalar = 0.0;
+
+		for (enum tsp_isa isa = TSP_ISA_SCALAR; isa <= tsp_simd_cpu_isa(); isa++) {
+			tsp_simd_set_isa(isa);
+			const double time = scan_vacant(graph, n_reps, isa == TSP_ISA_SCALAR ? scalar : simd);
+			if (isa == TSP_ISA_SCALAR) {
+				time_scalar = time;
+			}
+
+			/* Every kernel must pick the same nodes, ties included */
+			for (size_t j = 0; isa != TSP_ISA_SCALAR && j < 3 * n_active; j++) {
+				if (scalar[j] != simd[j]) {
+					error(("%s: scan %zu of active node %zu differs", tsp_simd_isa_name(isa), j % 3, j / 3));
+				}
+			}
+			printf("%8zu\t%8zu\t%8s\t%12.3f\t%8.2f\n",
+				n_nodes, n_reps, tsp_simd_isa_name(isa), time * 1e9 / n_ids, time_scalar / time);
+		}
+
+		free(scalar);
+		free(simd);
+		tsp_graph_destroy(graph);
+		sp_stack_destroy(nodes, NULL);
+	}
+	tsp_simd_set_isa(prev_isa);
+	return 0;
+}
+
+/* Best intra-route move of every active node, found by evaluating every pair
+ * of indices (rows == NULL) or with a row scan. Moves are written to out as
+ * delta, index and type, so that the scans can be compared. */
+double scan_intra(const struct tsp_graph *graph, struct tsp_intra_rows *rows, size_t n_reps, long *out)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	struct timespec time_before;
+
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	for (size_t r = 0; r < n_reps; r++) {
+		if (rows != NULL) {
+			tsp_intra_rows_load(rows, active, graph->dist_matrix);
+		}
+		for (size_t i = 0; i < active->size; i++) {
+			size_t dest = i;
+			bool edges = false;
+			long min = 0;
+			if (rows != NULL) {
+				min = tsp_intra_rows_find_best(rows, i, &dest, &edges);
+			} else {
+				for (size_t j = i; j < active->size; j++) {
+					long delta = tsp_nodes_evaluate_swap_nodes(active, graph->dist_matrix, i, j);
+					if (delta < min) {
+						min = delta;
+						dest = j;
+						edges = false;
+					}
+					delta = tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, i, j);
+					if (delta < min) {
+						min = delta;
+						dest = j;
+						edges = true;
+					}
+				}
+			}
+			out[3 * i] = min;
+			out[3 * i + 1] = dest;
+			out[3 * i + 2] = edges;
+		}
+	}
+	return wall_seconds_since(time_before);
+}
+
+/* Times the intra-route scans, pairwise and a row at a time */
+int bench_intra(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 200, 1000, 4000 };
+	const size_t n_sizes = argc > 0 ? (size_t)argc : ARRLEN(default_sizes);
+	const enum tsp_isa prev_isa = tsp_simd_isa();
+
+	printf("%8s\t%8s\t%8s\t%12s\t%8s\n",
+		"n_nodes", "reps", "scan", "ns/pair", "speedup");
+	for (size_t i = 0; i < n_sizes; i++) {
+		const size_t n_nodes = argc > 0 ? strtoul(argv[i], NULL, 10) : default_sizes[i];
+		if (n_nodes < 4) {
+			error(("instance size %zu is too small", n_nodes));
+		}
+
+		random_seed(0);
+		struct sp_stack *const nodes = generate_nodes(n_nodes);
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		tsp_graph_activate_random(graph, n_nodes / 2);
+		const size_t n_active = graph->nodes_active->size;
+		const size_t n_reps = MAX(1, 10000000 / (n_active * n_active));
+		struct tsp_intra_rows *const rows = tsp_intra_rows_create(n_active);
+		const double n_pairs = (double)n_reps * n_active * (n_active + 1) / 2;
+		long *const pairs = malloc_or_die(3 * n_active * sizeof(long));
+		long *const rows_out = malloc_or_die(3 * n_active * sizeof(long));
+
+		const double time_pairs = scan_intra(graph, NULL, n_reps, pairs);
+		printf("%8zu\t%8zu\t%8s\t%12.3f\t%8.2f\n",
+			n_nodes, n_reps, "pairs", time_pairs * 1e9 / n_pairs, 1.0);
+		for (enum tsp_isa isa = TSP_ISA_SCALAR; isa <= tsp_simd_cpu_isa(); isa++) {
+			tsp_simd_set_isa(isa);
+			const double time = scan_intra(graph, rows, n_reps, rows_out);
+
+			/* Every scan must pick the same moves, ties included */
+			for (size_t j = 0; j < 3 * n_active; j++) {
+				if (pairs[j] != rows_out[j]) {
+					error(("%s: best move of active node %zu differs", tsp_simd_isa_name(isa), j / 3));
+				}
+			}
+			printf("%8zu\t%8zu\t%8s\t%12.3f\t%8.2f\n",
+				n_nodes, n_reps, tsp_simd_isa_name(isa), time * 1e9 / n_pairs, time_pairs / time);
+		}
+
+		free(pairs);
+		free(rows_out);
+		tsp_intra_rows_destroy(rows);
+		tsp_graph_destroy(graph);
+		sp_stack_destroy(nodes, NULL);
+	}
+	tsp_simd_set_isa(prev_isa);
+	return 0;
+}
+
+/* Scores a population of random routes one by one and in batches, as the
+ * fitness landscape study of task 8 and the population of task 9 would */
+int bench_batch(int argc, char **argv)
+{
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 200;
+	const size_t n_tours = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000;
+	const size_t n_reps = 50;
+	const enum tsp_isa prev_isa = tsp_simd_isa();
+	if (n_nodes < 2) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	random_seed(0);
+	struct sp_stack *const nodes = generate_nodes(n_nodes);
+	struct tsp_graph *const graph = tsp_graph_create(nodes);
+	struct tsp_tour **const tours = malloc_or_die(MAX(1, n_tours) * sizeof(struct tsp_tour*));
+	unsigned long *const single = malloc_or_die(MAX(1, n_tours) * sizeof(unsigned long));
+	unsigned long *const batch = malloc_or_die(MAX(1, n_tours) * sizeof(unsigned long));
+	for (size_t i = 0; i < n_tours; i++) {
+		tours[i] = tsp_tour_create(n_nodes);
+		tsp_tour_fill(tours[i], n_nodes);
+		tsp_tour_shuffle_top(tours[i], n_nodes / 2);
+		while (tours[i]->size > n_nodes / 2) {
+			tsp_tour_remove(tours[i], tours[i]->size - 1);
+		}
+	}
+	const double n_edges = (double)n_reps * n_tours * (n_nodes / 2);
+	struct timespec time_before;
+
+	clock_gettime(CLOCK_MONOTONIC, &time_before);
+	for (size_t r = 0; r < n_reps; r++) {
+		for (size_t i = 0; i < n_tours; i++) {
+			single[i] = tsp_nodes_evaluate(tours[i], graph->dist_matrix);
+		}
+	}
+	const double time_single = wall_seconds_since(time_before);
+
+	printf("%8s\t%8s\t%8s\t%12s\t%14s\t%8s\n",
+		"n_nodes", "tours", "mode", "ns/edge", "edges/s [1e6]", "speedup");
+	printf("%8zu\t%8zu\t%8s\t%12.3f\t%14.1f\t%8.2f\n",
+		n_nodes, n_tours, "single", time_single * 1e9 / n_edges, n_edges / time_single / 1e6, 1.0);
+	for (enum tsp_isa isa = TSP_ISA_SCALAR; isa <= tsp_simd_cpu_isa(); isa++) {
+		tsp_simd_set_isa(isa);
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t r = 0; r < n_reps; r++) {
+			tsp_tours_evaluate_batch((const struct tsp_tour *const *)tours, n_tours, graph->dist_matrix, batch);
+		}
+		const double time_batch = wall_seconds_since(time_before);
+		for (size_t i = 0; i < n_tours; i++) {
+			if (batch[i] != single[i]) {
+				error(("score of tour %zu differs: got %lu, expected %lu", i, batch[i], single[i]));
+			}
+		}
+		printf("%8zu\t%8zu\t%8s\t%12.3f\t%14.1f\t%8.2f\n",
+			n_nodes, n_tours, tsp_simd_isa_name(isa), time_batch * 1e9 / n_edges,
+			n_edges / time_batch / 1e6, time_single / time_batch);
+	}
+	tsp_simd_set_isa(prev_isa);
+
+	for (size_t i = 0; i < n_tours; i++) {
+		tsp_tour_destroy(tours[i]);
+	}
+	free(tours);
+	free(single);
+	free(batch);
+	tsp_graph_destroy(graph);
+	sp_stack_destroy(nodes, NULL);
+	return 0;
+}
+
+/* Evaluates random moves with the out-of-line evaluators of graph.c and with
+ * the inlined ones of eval.h, for every storage they are specialized for */
+int bench_eval(int argc, char **argv)
+{
+	static const enum tsp_dist_storage storages[] = { TSP_DIST_DENSE, TSP_DIST_PACKED, TSP_DIST_TILED };
+	const size_t n_nodes = argc > 0 ? strtoul(argv[0], NULL, 10) : 200;
+	const size_t n_moves = argc > 1 ? strtoul(argv[1], NULL, 10) : 3000000;
+	const enum tsp_dist_storage default_storage = tsp_dist_matrix_get_default_storage();
+	if (n_nodes < 4) {
+		error(("instance size %zu is too small", n_nodes));
+	}
+
+	printf("%8s\t%8s\t%10s\t%16s\t%16s\t%8s\n",
+		"n_nodes", "storage", "layout", "called [ns/move]", "inlined [ns/move]", "speedup");
+	for (size_t i = 0; i < ARRLEN(storages); i++) {
+		random_seed(0);
+		tsp_dist_matrix_set_default_storage(storages[i]);
+		struct sp_stack *const nodes = generate_nodes(n_nodes);
+		struct tsp_graph *const graph = tsp_graph_create(nodes);
+		tsp_graph_activate_random(graph, n_nodes / 2);
+		const struct tsp_tour *const active = graph->nodes_active;
+		const struct tsp_tour *const vacant = graph->nodes_vacant;
+		struct tsp_move *const moves = malloc_or_die(n_moves * sizeof(struct tsp_move));
+		for (size_t j = 0; j < n_moves; j++) {
+			moves[j].src = randint(0, active->size - 1);
+			moves[j].dest = randint(0, active->size - 1);
+		}
+		struct tsp_eval eval;
+		tsp_eval_init(&eval, graph->dist_matrix);
+		struct timespec time_before;
+
+		long sum_called = 0;
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t j = 0; j < n_moves; j++) {
+			const size_t src = moves[j].src, dest = moves[j].dest;
+			sum_called += tsp_nodes_evaluate_swap_nodes(active, graph->dist_matrix, src, dest);
+			sum_called += tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, src, dest);
+			sum_called += tsp_graph_evaluate_inter_swap(graph, src, dest % vacant->size);
+		}
+		const double time_called = wall_seconds_since(time_before);
+
+		long sum_inlined = 0;
+		clock_gettime(CLOCK_MONOTONIC, &time_before);
+		for (size_t j = 0; j < n_moves; j++) {
+			const size_t src = moves[j].src, dest = moves[j].dest;
+			sum_inlined += tsp_eval_swap_nodes(&eval, active, src, dest);
+			sum_inlined += tsp_eval_swap_edges(&eval, active, src, dest);
+			sum_inlined += tsp_eval_inter_swap(&eval, active, vacant, src, dest % vacant->size);
+		}
+		const double time_inlined = wall_seconds_since(time_before);
+
+		if (sum_called != sum_inlined) {
+			error(("deltas differ: got %ld, expected %ld", sum_inlined, sum_called));
+		}
+		static const char *const layout_names[] = { "generic", "dense", "packed16", "packed32" };
+		printf("%8zu\t%8s\t%10s\t%16.3f\t%16.3f\t%8.2f\n",
+			n_nodes, tsp_dist_storage_name(storages[i]), layout_names[eval.layout],
+			time_called * 1e9 / n_moves, time_inlined * 1e9 / n_moves, time_called / time_inlined);
+
+		free(moves);
+		tsp_graph_destroy(graph);
+		sp_stack_destroy(nodes, NULL);
+	}
+	tsp_dist_matrix_set_default_storage(default_storage);
+	return 0;
+}
+
+void print_usage(const char *argv0)
+{
+	fprintf(stderr, "usage:\n");
+	for (size_t i = 0; i < ARRLEN(benches); i++) {
+		fprintf(stderr, "  %s %s %s\n", argv0, benches[i].name, benches[i].usage);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	assert(sp_is_abort());
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < ARRLEN(benches); i++) {
+		if (strcmp(argv[1], benches[i].name) == 0) {
+			return benches[i].func(argc - 2, argv + 2);
+		}
+	}
+	print_usage(argv[0]);
+	return EXIT_FAILURE;
+}
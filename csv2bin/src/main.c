@@ -0,0 +1,47 @@
+#include "../../src/tsp.h"
+#include <string.h>
+
+/* Converts CSV instances (as read by tsp_nodes_read) into binary instance
+ * files with a precomputed distance matrix, which tsp_graph_load can map
+ * without any parsing. The output path replaces the extension with ".bin".
+ * With -r, the nodes of the following instances are renumbered for locality
+ * (see tsp_dist_matrix_set_renumbering). */
+int main(int argc, char **argv)
+{
+	assert(sp_is_abort());
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s [-r] <instance.csv>...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0) {
+			tsp_dist_matrix_set_renumbering(true);
+			continue;
+		}
+		struct tsp_dist_matrix matrix;
+		const size_t len = strlen(argv[i]);
+		char *const out_fpath = malloc_or_die(len + sizeof(".bin"));
+		char *ext;
+
+		strcpy(out_fpath, argv[i]);
+		ext = strrchr(out_fpath, '.');
+		if (ext == NULL || strchr(ext, '/') != NULL) {
+			ext = out_fpath + len;
+		}
+		strcpy(ext, ".bin");
+		if (strcmp(out_fpath, argv[i]) == 0) {
+			error(("refusing to overwrite the input file %s", argv[i]));
+		}
+
+		struct sp_stack *const nodes = tsp_nodes_read(argv[i]);
+		tsp_dist_matrix_init(&matrix, nodes);
+		tsp_dist_matrix_save(&matrix, out_fpath);
+		info(("wrote %zu nodes to %s", matrix.size, out_fpath));
+
+		tsp_dist_matrix_free(&matrix);
+		sp_stack_destroy(nodes, NULL);
+		free(out_fpath);
+	}
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include "bitset.h"
+#include "helpers.h"
+#include <string.h>
+
+/* Private functions */
+size_t _bitset_n_words(size_t size);
+
+
+struct tsp_bitset *tsp_bitset_create(size_t size)
+{
+	struct tsp_bitset *const ret = malloc_or_die(sizeof(struct tsp_bitset));
+	ret->n_words = _bitset_n_words(size);
+	ret->words = calloc_or_die(MAX(1, ret->n_words) * sizeof(uint64_t));
+	ret->size = size;
+	return ret;
+}
+
+void tsp_bitset_copy(struct tsp_bitset *dest, const struct tsp_bitset *src)
+{
+	if (dest == src) {
+		return;
+	}
+	tsp_bitset_resize(dest, src->size);
+	memcpy(dest->words, src->words, src->n_words * sizeof(uint64_t));
+	memset(dest->words + src->n_words, 0, (dest->n_words - src->n_words) * sizeof(uint64_t));
+}
+
+/* Makes room for at least IDs 0..size-1. New IDs are not in the set. */
+void tsp_bitset_resize(struct tsp_bitset *set, size_t size)
+{
+	if (size <= set->size) {
+		return;
+	}
+	const size_t n_words = _bitset_n_words(size);
+	if (n_words > set->n_words) {
+		set->words = realloc(set->words, n_words * sizeof(uint64_t));
+		if (set->words == NULL) {
+			error(("failed to grow a bitset to %zu IDs", size));
+		}
+		memset(set->words + set->n_words, 0, (n_words - set->n_words) * sizeof(uint64_t));
+		set->n_words = n_words;
+	}
+	set->size = size;
+}
+
+void tsp_bitset_clear(struct tsp_bitset *set)
+{
+	memset(set->words, 0, set->n_words * sizeof(uint64_t));
+}
+
+/* Intersection of two sets. dest may be either of them. */
+void tsp_bitset_and(struct tsp_bitset *dest, const struct tsp_bitset *set1, const struct tsp_bitset *set2)
+{
+	const size_t n_words = MIN(set1->n_words, set2->n_words);
+	tsp_bitset_resize(dest, MAX(set1->size, set2->size));
+	for (size_t i = 0; i < n_words; i++) {
+		dest->words[i] = set1->words[i] & set2->words[i];
+	}
+	memset(dest->words + n_words, 0, (dest->n_words - n_words) * sizeof(uint64_t));
+}
+
+/* Union of two sets. dest may be either of them. */
+void tsp_bitset_or(struct tsp_bitset *dest, const struct tsp_bitset *set1, const struct tsp_bitset *set2)
+{
+	tsp_bitset_resize(dest, MAX(set1->size, set2->size));
+	for (size_t i = 0; i < dest->n_words; i++) {
+		dest->words[i] = (i < set1->n_words ? set1->words[i] : 0) | (i < set2->n_words ? set2->words[i] : 0);
+	}
+}
+
+/* Number of IDs in a set */
+size_t tsp_bitset_count(const struct tsp_bitset *set)
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < set->n_words; i++) {
+		ret += __builtin_popcountll(set->words[i]);
+	}
+	return ret;
+}
+
+/* Number of IDs in both sets, without building their intersection */
+size_t tsp_bitset_count_and(const struct tsp_bitset *set1, const struct tsp_bitset *set2)
+{
+	const size_t n_words = MIN(set1->n_words, set2->n_words);
+	size_t ret = 0;
+	for (size_t i = 0; i < n_words; i++) {
+		ret += __builtin_popcountll(set1->words[i] & set2->words[i]);
+	}
+	return ret;
+}
+
+/* Smallest ID in the set that is at least id, or SIZE_MAX if there is none.
+ * Iterates over a set with
+ *     for (size_t id = tsp_bitset_next(set, 0); id != SIZE_MAX; id = tsp_bitset_next(set, id + 1)) */
+size_t tsp_bitset_next(const struct tsp_bitset *set, size_t id)
+{
+	if (id >= set->size) {
+		return SIZE_MAX;
+	}
+	size_t i = id / TSP_BITSET_WORD_BITS;
+	uint64_t word = set->words[i] & (~(uint64_t)0 << (id % TSP_BITSET_WORD_BITS));
+	while (word == 0) {
+		if (++i == set->n_words) {
+			return SIZE_MAX;
+		}
+		word = set->words[i];
+	}
+	return i * TSP_BITSET_WORD_BITS + __builtin_ctzll(word);
+}
+
+void tsp_bitset_destroy(struct tsp_bitset *set)
+{
+	free(set->words);
+	free(set);
+}
+
+size_t _bitset_n_words(size_t size)
+{
+	return (size + TSP_BITSET_WORD_BITS - 1) / TSP_BITSET_WORD_BITS;
+}
@@ -0,0 +1,51 @@
+#ifndef TSP_BITSET_H
+#define TSP_BITSET_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#define TSP_BITSET_WORD_BITS 64
+
+/* Set of node IDs packed into 64-bit words, so that set operations and
+ * counting go a word, i.e. 64 IDs, at a time. */
+struct tsp_bitset {
+	uint64_t *words;
+	size_t n_words;
+	size_t size;  /* Number of IDs the set can hold */
+};
+
+struct tsp_bitset *tsp_bitset_create(size_t size);
+void tsp_bitset_copy(struct tsp_bitset *dest, const struct tsp_bitset *src);
+void tsp_bitset_resize(struct tsp_bitset *set, size_t size);
+void tsp_bitset_clear(struct tsp_bitset *set);
+void tsp_bitset_and(struct tsp_bitset *dest, const struct tsp_bitset *set1, const struct tsp_bitset *set2);
+void tsp_bitset_or(struct tsp_bitset *dest, const struct tsp_bitset *set1, const struct tsp_bitset *set2);
+size_t tsp_bitset_count(const struct tsp_bitset *set);
+size_t tsp_bitset_count_and(const struct tsp_bitset *set1, const struct tsp_bitset *set2);
+size_t tsp_bitset_next(const struct tsp_bitset *set, size_t id);
+void tsp_bitset_destroy(struct tsp_bitset *set);
+
+
+/* Adds an ID, growing the set if it does not fit */
+static inline void tsp_bitset_set(struct tsp_bitset *set, size_t id)
+{
+	if (id >= set->size) {
+		tsp_bitset_resize(set, id + 1);
+	}
+	set->words[id / TSP_BITSET_WORD_BITS] |= (uint64_t)1 << (id % TSP_BITSET_WORD_BITS);
+}
+
+static inline void tsp_bitset_unset(struct tsp_bitset *set, size_t id)
+{
+	assert(id < set->size);
+	set->words[id / TSP_BITSET_WORD_BITS] &= ~((uint64_t)1 << (id % TSP_BITSET_WORD_BITS));
+}
+
+static inline bool tsp_bitset_test(const struct tsp_bitset *set, size_t id)
+{
+	return id < set->size && (set->words[id / TSP_BITSET_WORD_BITS] >> (id % TSP_BITSET_WORD_BITS)) & 1;
+}
+
+#endif /* TSP_BITSET_H */
@@ -0,0 +1,247 @@
+#include "cowtour.h"
+#include "graph.h"
+#include "helpers.h"
+#include <string.h>
+#include <limits.h>
+
+/* Private functions */
+bool _chunk_boundary(tsp_id id);
+size_t _chunk_hash(const tsp_id *ids, size_t n);
+struct tsp_chunk *_store_intern(struct tsp_chunk_store *store, const tsp_id *ids, size_t n);
+void _store_release(struct tsp_chunk_store *store, struct tsp_chunk *chunk);
+void _cowtour_grow(struct tsp_cowtour *cow, size_t capacity);
+
+
+/* Creates an empty store, whose index spreads chunks over n_buckets buckets */
+struct tsp_chunk_store *tsp_chunk_store_create(size_t n_buckets)
+{
+	struct tsp_chunk_store *const store = malloc_or_die(sizeof(struct tsp_chunk_store));
+	store->index = hashmap_create(MAX(1, n_buckets));
+	store->capacity = 64;
+	store->chunks = malloc_or_die(store->capacity * sizeof(struct tsp_chunk *));
+	store->free_slots = malloc_or_die(store->capacity * sizeof(int));
+	store->n_slots = 0;
+	store->n_free = 0;
+	store->buf_capacity = 0;
+	store->buf = NULL;
+	return store;
+}
+
+/* Bytes taken by the chunks in the store and their index entries */
+size_t tsp_chunk_store_footprint(const struct tsp_chunk_store *store)
+{
+	size_t ret = store->index->size * sizeof(struct hashmap_pair);
+	for (size_t i = 0; i < store->n_slots; i++) {
+		if (store->chunks[i] != NULL) {
+			ret += sizeof(struct tsp_chunk) + store->chunks[i]->size * sizeof(tsp_id);
+		}
+	}
+	return ret;
+}
+
+/* Number of chunks in the store */
+size_t tsp_chunk_store_count(const struct tsp_chunk_store *store)
+{
+	return store->n_slots - store->n_free;
+}
+
+/* Destroys the store. All of its cowtours must have been destroyed first. */
+void tsp_chunk_store_destroy(struct tsp_chunk_store *store)
+{
+	if (tsp_chunk_store_count(store) != 0) {
+		error(("destroying a chunk store with %zu chunks still in use", tsp_chunk_store_count(store)));
+	}
+	hashmap_destroy(store->index);
+	free(store->chunks);
+	free(store->free_slots);
+	free(store->buf);
+	free(store);
+}
+
+struct tsp_cowtour *tsp_cowtour_create(struct tsp_chunk_store *store)
+{
+	struct tsp_cowtour *const cow = malloc_or_die(sizeof(struct tsp_cowtour));
+	cow->store = store;
+	cow->capacity = 1;
+	cow->chunks = malloc_or_die(cow->capacity * sizeof(struct tsp_chunk *));
+	cow->n_chunks = 0;
+	cow->size = 0;
+	return cow;
+}
+
+/* Stores a route in a cowtour, sharing every chunk that the store already
+ * holds. Takes time linear in the size of the route. */
+void tsp_cowtour_assign(struct tsp_cowtour *cow, const struct tsp_tour *nodes)
+{
+	struct tsp_chunk_store *const store = cow->store;
+	if (nodes->size > store->buf_capacity) {
+		store->buf_capacity = MAX(nodes->size, store->buf_capacity * 2);
+		free(store->buf);
+		store->buf = malloc_or_die(store->buf_capacity * sizeof(tsp_id));
+	}
+	tsp_nodes_canonical(nodes, store->buf);
+
+	/* Intern the new chunks before releasing the old ones, so that chunks
+	 * common to both are never freed */
+	struct tsp_chunk **const old_chunks = cow->chunks;
+	const size_t n_old_chunks = cow->n_chunks;
+	cow->chunks = malloc_or_die(MAX(1, cow->capacity) * sizeof(struct tsp_chunk *));
+	cow->n_chunks = 0;
+	size_t begin = 0;
+	for (size_t i = 0; i < nodes->size; i++) {
+		if (_chunk_boundary(store->buf[i]) || i + 1 - begin == TSP_CHUNK_MAX_SIZE || i + 1 == nodes->size) {
+			_cowtour_grow(cow, cow->n_chunks + 1);
+			cow->chunks[cow->n_chunks++] = _store_intern(store, store->buf + begin, i + 1 - begin);
+			begin = i + 1;
+		}
+	}
+	cow->size = nodes->size;
+
+	for (size_t i = 0; i < n_old_chunks; i++) {
+		_store_release(store, old_chunks[i]);
+	}
+	free(old_chunks);
+}
+
+/* Makes dest share all chunks of src */
+void tsp_cowtour_copy(struct tsp_cowtour *dest, const struct tsp_cowtour *src)
+{
+	if (dest == src) {
+		return;
+	}
+	assert(dest->store == src->store);
+	for (size_t i = 0; i < src->n_chunks; i++) {
+		src->chunks[i]->refs++;
+	}
+	for (size_t i = 0; i < dest->n_chunks; i++) {
+		_store_release(dest->store, dest->chunks[i]);
+	}
+	_cowtour_grow(dest, src->n_chunks);
+	memcpy(dest->chunks, src->chunks, src->n_chunks * sizeof(struct tsp_chunk *));
+	dest->n_chunks = src->n_chunks;
+	dest->size = src->size;
+}
+
+/* Writes the route into a tour, in canonical form */
+void tsp_cowtour_to_tour(const struct tsp_cowtour *cow, struct tsp_tour *tour)
+{
+	tsp_tour_clear(tour);
+	for (size_t i = cow->n_chunks; i-- > 0;) {
+		const struct tsp_chunk *const chunk = cow->chunks[i];
+		for (size_t j = chunk->size; j-- > 0;) {
+			tsp_tour_push(tour, chunk->ids[j]);
+		}
+	}
+}
+
+/* Whether two cowtours hold the same route, in any rotation or direction */
+bool tsp_cowtour_eq(const struct tsp_cowtour *cow1, const struct tsp_cowtour *cow2)
+{
+	if (cow1->size != cow2->size || cow1->n_chunks != cow2->n_chunks) {
+		return false;
+	}
+	for (size_t i = 0; i < cow1->n_chunks; i++) {
+		const struct tsp_chunk *const chunk1 = cow1->chunks[i];
+		const struct tsp_chunk *const chunk2 = cow2->chunks[i];
+		if (chunk1 != chunk2 && (chunk1->size != chunk2->size || memcmp(chunk1->ids, chunk2->ids, chunk1->size * sizeof(tsp_id)) != 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void tsp_cowtour_destroy(struct tsp_cowtour *cow)
+{
+	for (size_t i = 0; i < cow->n_chunks; i++) {
+		_store_release(cow->store, cow->chunks[i]);
+	}
+	free(cow->chunks);
+	free(cow);
+}
+
+/* Whether a chunk ends after node id. Depends on the ID alone, so that
+ * inserting or removing a node only moves the boundaries next to it. */
+bool _chunk_boundary(tsp_id id)
+{
+	return (((uint64_t)id + 1) * 0x9E3779B97F4A7C15ULL >> 32) % TSP_CHUNK_AVG_SIZE == 0;
+}
+
+/* FNV-1a over the IDs */
+size_t _chunk_hash(const tsp_id *ids, size_t n)
+{
+	uint64_t ret = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < n; i++) {
+		ret = (ret ^ ids[i]) * 0x100000001B3ULL;
+	}
+	return ret;
+}
+
+/* Returns the chunk holding ids, shared if the store has one, new otherwise */
+struct tsp_chunk *_store_intern(struct tsp_chunk_store *store, const tsp_id *ids, size_t n)
+{
+	const size_t hash = _chunk_hash(ids, n);
+	const bool is_indexed = hashmap_contains_key(store->index, hash);
+	if (is_indexed) {
+		struct tsp_chunk *const chunk = store->chunks[hashmap_get(store->index, hash)];
+		if (chunk->size == n && memcmp(chunk->ids, ids, n * sizeof(tsp_id)) == 0) {
+			chunk->refs++;
+			return chunk;
+		}
+	}
+
+	struct tsp_chunk *const chunk = malloc_or_die(sizeof(struct tsp_chunk));
+	chunk->ids = malloc_or_die(n * sizeof(tsp_id));
+	memcpy(chunk->ids, ids, n * sizeof(tsp_id));
+	chunk->size = n;
+	chunk->refs = 1;
+	chunk->hash = hash;
+	if (store->n_free != 0) {
+		chunk->slot = store->free_slots[--store->n_free];
+	} else {
+		if (store->n_slots == store->capacity) {
+			store->capacity *= 2;
+			store->chunks = realloc(store->chunks, store->capacity * sizeof(struct tsp_chunk *));
+			store->free_slots = realloc(store->free_slots, store->capacity * sizeof(int));
+			if (store->chunks == NULL || store->free_slots == NULL) {
+				error(("failed to grow a chunk store to %zu chunks", store->capacity));
+			}
+		}
+		assert(store->n_slots < INT_MAX);
+		chunk->slot = store->n_slots++;
+	}
+	store->chunks[chunk->slot] = chunk;
+
+	/* On a hash collision the chunk stays out of the index, unshared */
+	if (!is_indexed) {
+		hashmap_set(store->index, hash, chunk->slot);
+	}
+	return chunk;
+}
+
+/* Drops a reference to a chunk, and frees it if it was the last one */
+void _store_release(struct tsp_chunk_store *store, struct tsp_chunk *chunk)
+{
+	assert(chunk->refs != 0);
+	if (--chunk->refs != 0) {
+		return;
+	}
+	if (hashmap_contains_key(store->index, chunk->hash) && hashmap_get(store->index, chunk->hash) == chunk->slot) {
+		hashmap_unset(store->index, chunk->hash);
+	}
+	store->chunks[chunk->slot] = NULL;
+	store->free_slots[store->n_free++] = chunk->slot;
+	free(chunk->ids);
+	free(chunk);
+}
+
+void _cowtour_grow(struct tsp_cowtour *cow, size_t capacity)
+{
+	if (capacity <= cow->capacity) {
+		return;
+	}
+	cow->capacity = MAX(capacity, cow->capacity * 2);
+	cow->chunks = realloc(cow->chunks, cow->capacity * sizeof(struct tsp_chunk *));
+	if (cow->chunks == NULL) {
+		error(("failed to grow a cowtour to %zu chunks", cow->capacity));
+	}
+}
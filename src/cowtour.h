@@ -0,0 +1,61 @@
+#ifndef TSP_COWTOUR_H
+#define TSP_COWTOUR_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hashmap.h"
+#include "tour.h"
+
+/* A chunk ends after a node whose ID has its key (see _chunk_boundary) divisible
+ * by TSP_CHUNK_AVG_SIZE, or once it holds TSP_CHUNK_MAX_SIZE nodes */
+#define TSP_CHUNK_AVG_SIZE 16
+#define TSP_CHUNK_MAX_SIZE 64
+
+/* Immutable run of node IDs, shared by every cowtour that contains it */
+struct tsp_chunk {
+	tsp_id *ids;
+	size_t size;
+	size_t refs;  /* Number of cowtours that use the chunk */
+	size_t hash;  /* Hash of ids */
+	int slot;     /* Position in chunks of the store */
+};
+
+/* Deduplicating store of the chunks of many cowtours. Chunks are looked up by
+ * the hash of their contents, and freed when no cowtour uses them. */
+struct tsp_chunk_store {
+	struct hashmap *index;      /* Hash of contents -> slot in chunks */
+	struct tsp_chunk **chunks;  /* Live chunks, NULL in free slots */
+	int *free_slots;
+	size_t n_slots;
+	size_t n_free;
+	size_t capacity;
+	tsp_id *buf;                /* Canonical form of the route being stored */
+	size_t buf_capacity;
+};
+
+/* Copy-on-write route: a list of shared chunks. Routes are stored in the
+ * canonical form of tsp_nodes_canonical, and cut into chunks at boundaries
+ * chosen by node ID rather than by position, so two similar routes, even if
+ * one has a node inserted or removed, share all chunks but the ones around
+ * their differences. Copying a cowtour only copies the chunk list. */
+struct tsp_cowtour {
+	struct tsp_chunk_store *store;
+	struct tsp_chunk **chunks;
+	size_t n_chunks;
+	size_t capacity;
+	size_t size;  /* Number of nodes */
+};
+
+struct tsp_chunk_store *tsp_chunk_store_create(size_t n_buckets);
+size_t tsp_chunk_store_footprint(const struct tsp_chunk_store *store);
+size_t tsp_chunk_store_count(const struct tsp_chunk_store *store);
+void tsp_chunk_store_destroy(struct tsp_chunk_store *store);
+
+struct tsp_cowtour *tsp_cowtour_create(struct tsp_chunk_store *store);
+void tsp_cowtour_assign(struct tsp_cowtour *cow, const struct tsp_tour *nodes);
+void tsp_cowtour_copy(struct tsp_cowtour *dest, const struct tsp_cowtour *src);
+void tsp_cowtour_to_tour(const struct tsp_cowtour *cow, struct tsp_tour *tour);
+bool tsp_cowtour_eq(const struct tsp_cowtour *cow1, const struct tsp_cowtour *cow2);
+void tsp_cowtour_destroy(struct tsp_cowtour *cow);
+
+#endif /* TSP_COWTOUR_H */
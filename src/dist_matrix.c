@@ -0,0 +1,1244 @@
+#include "dist_matrix.h"
+#include "helpers.h"
+#include "scanner.h"
+#include "simd.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+/* Binary instance files (see tsp_dist_matrix_save) */
+#define TSP_BIN_MAGIC "TSPBIN1"
+#define TSP_BIN_ALIGN 64
+
+/* Largest instances given each backend by TSP_DIST_AUTO. A dense matrix of
+ * 2048 nodes takes 16 MiB, a tiled one of 32768 nodes at most 2 GiB. */
+#define TSP_DIST_AUTO_DENSE_MAX 2048
+#define TSP_DIST_AUTO_TILED_MAX 32768
+
+#define TSP_DIST_NO_SLOT UINT32_MAX
+
+/* Instances smaller than this are initialized on the calling thread only */
+#define TSP_DIST_THREADS_MIN_SIZE 1024
+#define TSP_DIST_MAX_THREADS 64
+
+/* Header of a binary instance file. The file is meant to be mapped on the
+ * machine that wrote it, so all fields are in native byte order. The sizes
+ * of the record types are stored to reject files from a different ABI. */
+struct tsp_bin_header {
+	char magic[8];
+	uint32_t node_size;      /* sizeof(struct tsp_node) */
+	uint32_t dist_size;      /* sizeof(unsigned) */
+	uint64_t n_nodes;
+	uint64_t nodes_offset;   /* Offset of the node array, indexed by node ID */
+	uint64_t dist_offset;    /* Offset of the n_nodes x n_nodes distance matrix */
+	uint64_t ids_offset;     /* Offset of the original node IDs, 0 if not renumbered */
+};
+
+
+/* Rows of stored distances to be computed by tsp_dist_matrix_init */
+struct fill_job {
+	const struct tsp_dist_matrix *matrix;
+	double *xs;  /* Coordinates, indexed by node ID */
+	double *ys;
+	bool vectorize;
+	unsigned *out;
+	size_t n_rows;
+	uint32_t (*fill)(const struct fill_job *job, size_t row);
+};
+
+struct fill_thread {
+	const struct fill_job *job;
+	size_t idx;
+	size_t n_threads;
+	uint32_t dist_max;
+};
+
+/* Position of a node along the Hilbert curve */
+struct hilbert_key {
+	uint64_t key;
+	unsigned id;
+};
+
+
+/* Private functions */
+bool _fits_int32(const struct tsp_node *nodes, size_t size);
+uint32_t _fill_row(const struct fill_job *job, size_t id, size_t begin, size_t end, unsigned *out);
+uint32_t _fill_dense(const struct fill_job *job, size_t row);
+uint32_t _fill_packed(const struct fill_job *job, size_t row);
+uint32_t _fill_tiled(const struct fill_job *job, size_t row);
+void *_fill_thread(void *arg);
+uint32_t _fill_run(const struct fill_job *job);
+void _narrow_stored(struct tsp_dist_matrix *matrix, size_t n_elems, uint32_t dist_max);
+void _widen_stored(struct tsp_dist_matrix *matrix, size_t n_elems);
+uint64_t _pair_hash(uint64_t pair, uint64_t dist);
+uint64_t _hilbert_index(uint32_t x, uint32_t y);
+int _hilbert_key_cmp(const void *a, const void *b);
+void _renumber_nodes(struct tsp_dist_matrix *matrix, const struct tsp_node *nodes, const unsigned *orig_ids, unsigned *order);
+struct tsp_dist_cache *_cache_create(size_t size);
+void _cache_clear(struct tsp_dist_cache *cache, size_t size);
+void _cache_destroy(struct tsp_dist_cache *cache);
+void _cache_load_row(const struct tsp_dist_matrix *matrix, size_t id);
+
+
+/* Storage mode used by tsp_dist_matrix_init */
+static enum tsp_dist_storage default_storage = TSP_DIST_DENSE;
+
+/* Number of threads used by tsp_dist_matrix_init, 0 for one per CPU */
+static size_t n_init_threads = 0;
+
+/* Whether instances are renumbered for locality as they are loaded */
+static bool renumbering = false;
+
+
+static inline unsigned node_dist(struct tsp_node node1, struct tsp_node node2)
+{
+	return ROUND(euclidean_dist(node1.x, node1.y, node2.x, node2.y));
+}
+
+/* Sets the storage mode of all distance matrices created by tsp_dist_matrix_init
+ * (and therefore tsp_graph_create) from now on. */
+void tsp_dist_matrix_set_default_storage(enum tsp_dist_storage storage)
+{
+	default_storage = storage;
+}
+
+enum tsp_dist_storage tsp_dist_matrix_get_default_storage(void)
+{
+	return default_storage;
+}
+
+/* Sets the number of threads used to compute distance matrices, or 0 to use
+ * one per online CPU (the default). */
+void tsp_dist_matrix_set_threads(size_t n_threads)
+{
+	n_init_threads = n_threads;
+}
+
+/* Makes tsp_dist_matrix_init and tsp_dist_matrix_read renumber the nodes of
+ * every instance from now on, so that nodes close to each other get close IDs
+ * and their distances share cache lines. Coordinate instances are sorted along
+ * a Hilbert curve, matrix-only ones follow a greedy nearest neighbour tour.
+ * The IDs from the instance file are kept in orig_ids. */
+void tsp_dist_matrix_set_renumbering(bool renumber)
+{
+	renumbering = renumber;
+}
+
+bool tsp_dist_matrix_get_renumbering(void)
+{
+	return renumbering;
+}
+
+/* Returns the backend picked by TSP_DIST_AUTO for an instance of the given size. */
+enum tsp_dist_storage tsp_dist_storage_for_size(size_t size)
+{
+	if (size <= TSP_DIST_AUTO_DENSE_MAX) {
+		return TSP_DIST_DENSE;
+	}
+	if (size <= TSP_DIST_AUTO_TILED_MAX) {
+		return TSP_DIST_TILED;
+	}
+	return TSP_DIST_COMPUTED;
+}
+
+const char *tsp_dist_storage_name(enum tsp_dist_storage storage)
+{
+	switch (storage) {
+		case TSP_DIST_DENSE: return "dense";
+		case TSP_DIST_PACKED: return "packed";
+		case TSP_DIST_TILED: return "tiled";
+		case TSP_DIST_COMPUTED: return "computed";
+		case TSP_DIST_AUTO: return "auto";
+	}
+	return "unknown";
+}
+
+/* Initializes a matrix with no nodes, which can be passed to
+ * tsp_dist_matrix_copy and tsp_dist_matrix_free. */
+void tsp_dist_matrix_init_empty(struct tsp_dist_matrix *matrix)
+{
+	matrix->dist = NULL;
+	matrix->data = NULL;
+	matrix->cache = NULL;
+	matrix->nodes = NULL;
+	matrix->costs = NULL;
+	matrix->size = 0;
+	matrix->storage = TSP_DIST_DENSE;
+	matrix->elem_size = sizeof(unsigned);
+	matrix->n_tiles = 0;
+	matrix->orig_ids = NULL;
+	matrix->weights = NULL;
+	matrix->map = NULL;
+	matrix->map_size = 0;
+}
+
+/* Allocates an empty matrix with a single owner. Once initialized, it is
+ * meant to be read-only, so that it can be shared with tsp_dist_matrix_share
+ * instead of copied. */
+struct tsp_dist_matrix *tsp_dist_matrix_create(void)
+{
+	struct tsp_dist_matrix *const matrix = malloc_or_die(sizeof(struct tsp_dist_matrix));
+	tsp_dist_matrix_init_empty(matrix);
+	matrix->n_refs = 1;
+	return matrix;
+}
+
+/* Adds an owner to a matrix from tsp_dist_matrix_create, and returns it. */
+struct tsp_dist_matrix *tsp_dist_matrix_share(struct tsp_dist_matrix *matrix)
+{
+	matrix->n_refs++;
+	return matrix;
+}
+
+/* Removes an owner from a matrix from tsp_dist_matrix_create, and destroys
+ * it when there are none left. */
+void tsp_dist_matrix_release(struct tsp_dist_matrix *matrix)
+{
+	if (matrix == NULL) {
+		return;
+	}
+	assert(matrix->n_refs > 0);
+	if (--matrix->n_refs == 0) {
+		tsp_dist_matrix_free(matrix);
+		free(matrix);
+	}
+}
+
+void tsp_dist_matrix_init(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes)
+{
+	tsp_dist_matrix_init_storage(matrix, nodes, default_storage);
+}
+
+void tsp_dist_matrix_init_storage(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes, enum tsp_dist_storage storage)
+{
+	const size_t size = nodes->size;
+	const struct tsp_node *const nodes_data = nodes->data;
+	struct fill_job job;
+
+	assert(sizeof(unsigned) == sizeof(uint32_t));
+	if (storage == TSP_DIST_AUTO) {
+		storage = tsp_dist_storage_for_size(size);
+	}
+
+	tsp_dist_matrix_init_empty(matrix);
+	matrix->nodes = malloc_or_die(MAX(1, size) * sizeof(struct tsp_node));
+	for (size_t i = 0; i < size; i++) {
+		matrix->nodes[nodes_data[i].id] = nodes_data[i];
+	}
+	matrix->size = size;
+	matrix->storage = storage;
+	if (renumbering) {
+		_renumber_nodes(matrix, matrix->nodes, NULL, tsp_nodes_hilbert_order(matrix->nodes, size));
+	}
+	tsp_dist_matrix_update_costs(matrix);
+
+	if (storage == TSP_DIST_COMPUTED) {
+		matrix->cache = _cache_create(size);
+		return;
+	}
+
+	job.matrix = matrix;
+	job.xs = malloc_or_die(MAX(1, size) * sizeof(double));
+	job.ys = malloc_or_die(MAX(1, size) * sizeof(double));
+	for (size_t i = 0; i < size; i++) {
+		job.xs[i] = matrix->nodes[i].x;
+		job.ys[i] = matrix->nodes[i].y;
+	}
+	job.vectorize = _fits_int32(matrix->nodes, size);
+
+	switch (storage) {
+		case TSP_DIST_DENSE: {
+			matrix->dist = malloc_or_die(MAX(1, size * size) * sizeof(unsigned));
+			job.out = matrix->dist;
+			job.fill = _fill_dense;
+			job.n_rows = size;
+			_fill_run(&job);
+		} break;
+		case TSP_DIST_PACKED: {
+			/* Upper triangle, row by row, without the diagonal */
+			const size_t n_pairs = size * (size - (size != 0)) / 2;
+			job.out = malloc_or_die(MAX(1, n_pairs) * sizeof(uint32_t));
+			job.fill = _fill_packed;
+			job.n_rows = size;
+			matrix->data = job.out;
+			_narrow_stored(matrix, n_pairs, _fill_run(&job));
+		} break;
+		case TSP_DIST_TILED: {
+			/* Upper triangle of tiles, row by row, including the diagonal
+			 * tiles in full. Each tile is stored row-major, so the distances
+			 * from a node to its neighbours by ID share few cache lines. */
+			const size_t n_tiles = (size + TSP_DIST_TILE - 1) / TSP_DIST_TILE;
+			const size_t n_elems = n_tiles * (n_tiles + 1) / 2 * TSP_DIST_TILE * TSP_DIST_TILE;
+			job.out = malloc_or_die(MAX(1, n_elems) * sizeof(uint32_t));
+			job.fill = _fill_tiled;
+			job.n_rows = n_tiles * TSP_DIST_TILE;
+			matrix->data = job.out;
+			matrix->n_tiles = n_tiles;
+			_narrow_stored(matrix, n_elems, _fill_run(&job));
+		} break;
+		default:
+			error(("invalid distance matrix storage %d", storage));
+		break;
+	}
+	free(job.xs);
+	free(job.ys);
+}
+
+/* Reads an instance given only by its distances: a matrix file with one row
+ * of whitespace-separated distances per node, and optionally a costs file
+ * with one cost per node (all costs are 0 without it). Both are streamed
+ * through a small buffer straight into the backend's storage. The nodes get
+ * zero coordinates, so the computed backend is not available. */
+void tsp_dist_matrix_read(struct tsp_dist_matrix *matrix, const char *matrix_fpath, const char *costs_fpath)
+{
+	tsp_dist_matrix_read_storage(matrix, matrix_fpath, costs_fpath, default_storage);
+}
+
+void tsp_dist_matrix_read_storage(struct tsp_dist_matrix *matrix, const char *matrix_fpath, const char *costs_fpath, enum tsp_dist_storage storage)
+{
+	struct tsp_stream stream;
+	struct tsp_dist_builder builder;
+	unsigned long val = 0;
+	size_t first_row_capacity = 256;
+	uint32_t *first_row = malloc_or_die(first_row_capacity * sizeof(uint32_t));
+	size_t size = 0;
+	size_t first_lineno = 0;
+	size_t bad_node;
+	int ret;
+
+	tsp_stream_open(&stream, matrix_fpath);
+
+	/* The length of the first row gives the number of nodes */
+	while ((ret = tsp_stream_read_ulong(&stream, &val, UINT32_MAX)) == 1) {
+		if (first_lineno == 0) {
+			first_lineno = stream.token_lineno;
+		} else if (stream.token_lineno != first_lineno) {
+			break;
+		}
+		if (size == first_row_capacity) {
+			first_row_capacity *= 2;
+			first_row = realloc(first_row, first_row_capacity * sizeof(uint32_t));
+			if (first_row == NULL) {
+				error(("realloc failed -- out of memory!"));
+			}
+		}
+		first_row[size++] = val;
+	}
+	if (ret == 0) {
+		error(("failed to parse line %zu in %s: expected a distance", stream.lineno, matrix_fpath));
+	}
+	const bool have_pending = ret == 1;
+	const unsigned long pending = val;
+	if (size == 0) {
+		error(("no distances in %s", matrix_fpath));
+	}
+	if (storage == TSP_DIST_COMPUTED) {
+		error(("the computed backend needs node coordinates, which %s does not have", matrix_fpath));
+	}
+	tsp_dist_builder_begin(&builder, matrix, size, storage);
+
+	/* The first row has been read already, along with the first distance of the second one */
+	for (size_t i = 0; i < size; i++) {
+		for (size_t j = 0; j < size; j++) {
+			if (i == 0) {
+				val = first_row[j];
+			} else if (i == 1 && j == 0 && have_pending) {
+				val = pending;
+			} else {
+				ret = tsp_stream_read_ulong(&stream, &val, UINT32_MAX);
+				if (ret == EOF) {
+					error(("unexpected EOF while reading row %zu of %zu from %s", i + 1, size, matrix_fpath));
+				} else if (ret == 0) {
+					error(("failed to parse line %zu in %s: expected a distance", stream.lineno, matrix_fpath));
+				}
+			}
+			if (!tsp_dist_builder_set(&builder, i, j, val)) {
+				error(("line %zu in %s: distance from node %zu to itself is not 0", stream.token_lineno, matrix_fpath, i));
+			}
+		}
+	}
+	if (tsp_stream_read_ulong(&stream, &val, UINT32_MAX) != EOF) {
+		error(("line %zu in %s: expected %zu rows of %zu distances", stream.lineno, matrix_fpath, size, size));
+	}
+	tsp_stream_close(&stream);
+	free(first_row);
+	if (!tsp_dist_builder_end(&builder, &bad_node)) {
+		error(("%s: distances from node %zu differ from the distances to it", matrix_fpath, bad_node));
+	}
+
+	if (costs_fpath != NULL) {
+		tsp_nodes_read_costs(matrix->nodes, size, costs_fpath);
+		tsp_dist_matrix_update_costs(matrix);
+	}
+	if (renumbering) {
+		tsp_dist_matrix_renumber(matrix, tsp_dist_matrix_greedy_order(matrix));
+	}
+	info(("successfully read %zu x %zu distances from %s", size, size, matrix_fpath));
+}
+
+/* Reads one cost per node from a file of whitespace-separated integers */
+void tsp_nodes_read_costs(struct tsp_node *nodes, size_t size, const char *fpath)
+{
+	struct tsp_stream stream;
+	unsigned long val;
+	int ret;
+
+	tsp_stream_open(&stream, fpath);
+	for (size_t i = 0; i < size; i++) {
+		ret = tsp_stream_read_ulong(&stream, &val, INT_MAX);
+		if (ret == EOF) {
+			error(("unexpected EOF while reading cost %zu of %zu from %s", i + 1, size, fpath));
+		} else if (ret == 0) {
+			error(("failed to parse line %zu in %s: expected a cost", stream.lineno, fpath));
+		}
+		nodes[i].cost = val;
+	}
+	if (tsp_stream_read_ulong(&stream, &val, INT_MAX) != EOF) {
+		error(("line %zu in %s: expected %zu costs", stream.lineno, fpath, size));
+	}
+	tsp_stream_close(&stream);
+}
+
+/* Starts building a matrix of the given size from explicit distances, set
+ * one by one with tsp_dist_builder_set in any order. The nodes get IDs
+ * 0..size-1, zero coordinates and zero costs. tsp_dist_builder_end checks
+ * that both distances of each pair were equal, and the triangular backends
+ * keep only one of them. */
+void tsp_dist_builder_begin(struct tsp_dist_builder *builder, struct tsp_dist_matrix *matrix, size_t size, enum tsp_dist_storage storage)
+{
+	if (storage == TSP_DIST_AUTO) {
+		storage = tsp_dist_storage_for_size(size);
+		if (storage == TSP_DIST_COMPUTED) {
+			storage = TSP_DIST_PACKED;
+		}
+	}
+	if (storage == TSP_DIST_COMPUTED) {
+		error(("the computed backend needs node coordinates"));
+	}
+
+	tsp_dist_matrix_init_empty(matrix);
+	matrix->nodes = calloc_or_die(MAX(1, size) * sizeof(struct tsp_node));
+	for (size_t i = 0; i < size; i++) {
+		matrix->nodes[i].id = i;
+	}
+	matrix->size = size;
+	matrix->storage = storage;
+	tsp_dist_matrix_update_costs(matrix);
+	builder->matrix = matrix;
+	builder->n_elems = 0;
+	switch (storage) {
+		case TSP_DIST_DENSE:
+			matrix->dist = malloc_or_die(MAX(1, size * size) * sizeof(unsigned));
+		break;
+		/* The triangular backends start out with 16-bit elements and
+		 * are widened on the first distance that does not fit */
+		case TSP_DIST_PACKED:
+			builder->n_elems = size * (size - (size != 0)) / 2;
+			matrix->data = malloc_or_die(MAX(1, builder->n_elems) * sizeof(uint16_t));
+			matrix->elem_size = sizeof(uint16_t);
+		break;
+		case TSP_DIST_TILED:
+			matrix->n_tiles = (size + TSP_DIST_TILE - 1) / TSP_DIST_TILE;
+			builder->n_elems = matrix->n_tiles * (matrix->n_tiles + 1) / 2 * TSP_DIST_TILE * TSP_DIST_TILE;
+			matrix->data = calloc_or_die(MAX(1, builder->n_elems) * sizeof(uint16_t));
+			matrix->elem_size = sizeof(uint16_t);
+		break;
+		default:
+			error(("invalid distance matrix storage %d", storage));
+		break;
+	}
+	/* Looking up the mirrored distance of every pair would walk the
+	 * storage column-wise, so symmetry is checked by hashing each pair
+	 * into a per-node sum, once from each side */
+	builder->upper_sums = calloc_or_die(MAX(1, size) * sizeof(uint64_t));
+	builder->lower_sums = calloc_or_die(MAX(1, size) * sizeof(uint64_t));
+}
+
+/* Sets the distance from node i to node j. Returns false if given a non-zero
+ * distance from a node to itself. */
+bool tsp_dist_builder_set(struct tsp_dist_builder *builder, size_t i, size_t j, uint32_t dist)
+{
+	struct tsp_dist_matrix *const matrix = builder->matrix;
+	const size_t size = matrix->size;
+	size_t idx;
+
+	if (matrix->storage == TSP_DIST_DENSE) {
+		matrix->dist[i * size + j] = dist;
+	}
+	if (i == j) {
+		return dist == 0;
+	}
+	if (i < j) {
+		builder->upper_sums[i] += _pair_hash(i * size + j, dist);
+	} else {
+		builder->lower_sums[j] += _pair_hash(j * size + i, dist);
+	}
+	if (matrix->storage == TSP_DIST_DENSE) {
+		return true;
+	} else if (matrix->storage == TSP_DIST_PACKED) {
+		if (i > j) {
+			return true;
+		}
+		idx = tsp_dist_packed_idx(i, j, size);
+	} else {
+		if (i / TSP_DIST_TILE > j / TSP_DIST_TILE) {
+			return true;
+		}
+		idx = tsp_dist_tiled_idx(i, j, matrix->n_tiles);
+	}
+	if (dist > UINT16_MAX && matrix->elem_size == sizeof(uint16_t)) {
+		_widen_stored(matrix, builder->n_elems);
+	}
+	if (matrix->elem_size == sizeof(uint16_t)) {
+		((uint16_t*)matrix->data)[idx] = dist;
+	} else {
+		((uint32_t*)matrix->data)[idx] = dist;
+	}
+	return true;
+}
+
+/* Finishes building. Returns false, and the first offending node in
+ * bad_node, if the matrix was asymmetric, which no evaluator supports. */
+bool tsp_dist_builder_end(struct tsp_dist_builder *builder, size_t *bad_node)
+{
+	bool symmetric = true;
+	for (size_t i = 0; i < builder->matrix->size && symmetric; i++) {
+		if (builder->upper_sums[i] != builder->lower_sums[i]) {
+			*bad_node = i;
+			symmetric = false;
+		}
+	}
+	free(builder->upper_sums);
+	free(builder->lower_sums);
+	builder->upper_sums = NULL;
+	builder->lower_sums = NULL;
+	return symmetric;
+}
+
+/* Whether every distance between the nodes, rounded, fits in an int32_t,
+ * which is what the vector kernel converts to. */
+bool _fits_int32(const struct tsp_node *nodes, size_t size)
+{
+	double min_x = 0.0, max_x = 0.0, min_y = 0.0, max_y = 0.0;
+	for (size_t i = 0; i < size; i++) {
+		min_x = i == 0 ? nodes[i].x : MIN(min_x, nodes[i].x);
+		max_x = i == 0 ? nodes[i].x : MAX(max_x, nodes[i].x);
+		min_y = i == 0 ? nodes[i].y : MIN(min_y, nodes[i].y);
+		max_y = i == 0 ? nodes[i].y : MAX(max_y, nodes[i].y);
+	}
+	return euclidean_dist(min_x, min_y, max_x, max_y) + 0.5 < (double)INT32_MAX;
+}
+
+/* Computes the rounded distances from node id to nodes begin..end-1 into out
+ * and returns the largest one. The vector loop performs exactly the same
+ * IEEE operations as euclidean_dist and ROUND, so the results are identical
+ * to the scalar ones. */
+uint32_t _fill_row(const struct fill_job *job, size_t id, size_t begin, size_t end, unsigned *out)
+{
+	const double x = job->xs[id];
+	const double y = job->ys[id];
+	if (job->vectorize) {
+		return tsp_dist_row(x, y, &job->xs[begin], &job->ys[begin], end - begin, out);
+	}
+	uint32_t dist_max = 0;
+	for (size_t j = begin; j < end; j++) {
+		const unsigned dist = ROUND(euclidean_dist(x, y, job->xs[j], job->ys[j]));
+		out[j - begin] = dist;
+		dist_max = MAX(dist_max, dist);
+	}
+	return dist_max;
+}
+
+uint32_t _fill_dense(const struct fill_job *job, size_t row)
+{
+	const size_t size = job->matrix->size;
+	return _fill_row(job, row, 0, size, &job->out[row * size]);
+}
+
+uint32_t _fill_packed(const struct fill_job *job, size_t row)
+{
+	const size_t size = job->matrix->size;
+	return _fill_row(job, row, row + 1, size, &job->out[tsp_dist_packed_idx(row, row + 1, size)]);
+}
+
+/* Fills one row of nodes across all tiles right of the diagonal, including the
+ * diagonal tile. Rows and columns past the last node are padded with zeros. */
+uint32_t _fill_tiled(const struct fill_job *job, size_t row)
+{
+	const size_t size = job->matrix->size;
+	const size_t n_tiles = job->matrix->n_tiles;
+	uint32_t dist_max = 0;
+	for (size_t t = row / TSP_DIST_TILE; t < n_tiles; t++) {
+		const size_t begin = t * TSP_DIST_TILE;
+		const size_t end = row < size ? MIN(size, begin + TSP_DIST_TILE) : begin;
+		unsigned *const out = &job->out[tsp_dist_tiled_idx(row, begin, n_tiles)];
+		if (row < size) {
+			dist_max = MAX(dist_max, _fill_row(job, row, begin, end, out));
+		}
+		memset(&out[end - begin], 0, (TSP_DIST_TILE - (end - begin)) * sizeof(unsigned));
+	}
+	return dist_max;
+}
+
+void *_fill_thread(void *arg)
+{
+	struct fill_thread *const thread = arg;
+	const struct fill_job *const job = thread->job;
+	thread->dist_max = 0;
+	/* Rows are dealt out round-robin, because triangular storage makes
+	 * the first rows the longest */
+	for (size_t row = thread->idx; row < job->n_rows; row += thread->n_threads) {
+		thread->dist_max = MAX(thread->dist_max, job->fill(job, row));
+	}
+	return NULL;
+}
+
+/* Fills all rows of the job, on several threads for large instances, and
+ * returns the largest distance. */
+uint32_t _fill_run(const struct fill_job *job)
+{
+	struct fill_thread threads[TSP_DIST_MAX_THREADS];
+	pthread_t tids[TSP_DIST_MAX_THREADS];
+	size_t n_threads = n_init_threads;
+	uint32_t dist_max = 0;
+
+	if (n_threads == 0) {
+		const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = n_cpus > 0 ? (size_t)n_cpus : 1;
+	}
+	n_threads = MIN(n_threads, TSP_DIST_MAX_THREADS);
+	if (job->matrix->size < TSP_DIST_THREADS_MIN_SIZE) {
+		n_threads = 1;
+	}
+
+	for (size_t i = 0; i < n_threads; i++) {
+		threads[i].job = job;
+		threads[i].idx = i;
+		threads[i].n_threads = n_threads;
+	}
+	for (size_t i = 1; i < n_threads; i++) {
+		if (pthread_create(&tids[i], NULL, _fill_thread, &threads[i]) != 0) {
+			error(("failed to create a thread"));
+		}
+	}
+	_fill_thread(&threads[0]);
+	for (size_t i = 0; i < n_threads; i++) {
+		if (i != 0) {
+			pthread_join(tids[i], NULL);
+		}
+		dist_max = MAX(dist_max, threads[i].dist_max);
+	}
+	return dist_max;
+}
+
+/* Narrows the 32-bit stored distances in place to 16 bits, if the largest
+ * distance allows it. */
+void _narrow_stored(struct tsp_dist_matrix *matrix, size_t n_elems, uint32_t dist_max)
+{
+	matrix->elem_size = sizeof(uint32_t);
+	if (dist_max > UINT16_MAX) {
+		return;
+	}
+	/* Byte-wise, because both views alias the same buffer */
+	unsigned char *const bytes = matrix->data;
+	for (size_t k = 0; k < n_elems; k++) {
+		uint32_t wide;
+		uint16_t narrow;
+		memcpy(&wide, bytes + k * sizeof(uint32_t), sizeof(uint32_t));
+		narrow = wide;
+		memcpy(bytes + k * sizeof(uint16_t), &narrow, sizeof(uint16_t));
+	}
+	void *const data = realloc(matrix->data, MAX(1, n_elems) * sizeof(uint16_t));
+	if (data != NULL) {
+		matrix->data = data;
+	}
+	matrix->elem_size = sizeof(uint16_t);
+}
+
+/* Mixes a pair index and its distance (splitmix64 finalizer) */
+uint64_t _pair_hash(uint64_t pair, uint64_t dist)
+{
+	uint64_t x = pair * 0x9E3779B97F4A7C15ULL ^ dist;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/* Widens 16-bit stored distances in place to 32 bits */
+void _widen_stored(struct tsp_dist_matrix *matrix, size_t n_elems)
+{
+	unsigned char *const bytes = realloc(matrix->data, MAX(1, n_elems) * sizeof(uint32_t));
+	if (bytes == NULL) {
+		error(("realloc failed -- out of memory!"));
+	}
+	/* Back to front, so that no element is overwritten before it is read */
+	for (size_t k = n_elems; k-- > 0;) {
+		uint16_t narrow;
+		uint32_t wide;
+		memcpy(&narrow, bytes + k * sizeof(uint16_t), sizeof(uint16_t));
+		wide = narrow;
+		memcpy(bytes + k * sizeof(uint32_t), &wide, sizeof(uint32_t));
+	}
+	matrix->data = bytes;
+	matrix->elem_size = sizeof(uint32_t);
+}
+
+struct tsp_dist_cache *_cache_create(size_t size)
+{
+	struct tsp_dist_cache *const cache = malloc_or_die(sizeof(struct tsp_dist_cache));
+	cache->n_rows = MIN(TSP_DIST_CACHE_ROWS, size);
+	cache->rows = malloc_or_die(MAX(1, cache->n_rows * size) * sizeof(unsigned));
+	cache->row_of_slot = malloc_or_die(MAX(1, cache->n_rows) * sizeof(uint32_t));
+	cache->last_used = malloc_or_die(MAX(1, cache->n_rows) * sizeof(uint64_t));
+	cache->slot_of_row = malloc_or_die(MAX(1, size) * sizeof(uint32_t));
+	cache->misses = malloc_or_die(MAX(1, size) * sizeof(uint32_t));
+	/* Only nodes that keep missing get a row, so that a local search
+	 * scanning all pairs does not flush the rows of its hot nodes */
+	cache->threshold = MAX(16, size / 4);
+	cache->aging_period = 4 * size;
+	_cache_clear(cache, size);
+	return cache;
+}
+
+void _cache_clear(struct tsp_dist_cache *cache, size_t size)
+{
+	for (size_t i = 0; i < cache->n_rows; i++) {
+		cache->row_of_slot[i] = TSP_DIST_NO_SLOT;
+		cache->last_used[i] = 0;
+	}
+	for (size_t i = 0; i < size; i++) {
+		cache->slot_of_row[i] = TSP_DIST_NO_SLOT;
+		cache->misses[i] = 0;
+	}
+	cache->tick = 0;
+	cache->n_recent_misses = 0;
+	cache->n_hits = 0;
+	cache->n_computed = 0;
+	cache->n_loads = 0;
+}
+
+void _cache_destroy(struct tsp_dist_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+	free(cache->rows);
+	free(cache->row_of_slot);
+	free(cache->last_used);
+	free(cache->slot_of_row);
+	free(cache->misses);
+	free(cache);
+}
+
+/* Computes the row of the given node into the least recently used slot */
+void _cache_load_row(const struct tsp_dist_matrix *matrix, size_t id)
+{
+	struct tsp_dist_cache *const cache = matrix->cache;
+	size_t slot = 0;
+	for (size_t i = 1; i < cache->n_rows; i++) {
+		if (cache->last_used[i] < cache->last_used[slot]) {
+			slot = i;
+		}
+	}
+	if (cache->row_of_slot[slot] != TSP_DIST_NO_SLOT) {
+		cache->slot_of_row[cache->row_of_slot[slot]] = TSP_DIST_NO_SLOT;
+	}
+	unsigned *const row = &cache->rows[slot * matrix->size];
+	const struct tsp_node node = matrix->nodes[id];
+	for (size_t j = 0; j < matrix->size; j++) {
+		row[j] = node_dist(node, matrix->nodes[j]);
+	}
+	cache->row_of_slot[slot] = id;
+	cache->slot_of_row[id] = slot;
+	cache->last_used[slot] = ++cache->tick;
+	cache->misses[id] = 0;
+	cache->n_loads++;
+}
+
+/* Lookup of the TSP_DIST_COMPUTED backend. Distances come from a cached row
+ * of either node if there is one, and are computed from the coordinates
+ * otherwise. Nodes that miss often get their row cached, evicting the least
+ * recently used one. */
+unsigned long tsp_dist_computed_get(const struct tsp_dist_matrix *matrix, size_t id1, size_t id2)
+{
+	struct tsp_dist_cache *const cache = matrix->cache;
+	uint32_t slot;
+
+	if (id1 == id2) {
+		return 0;
+	}
+	if ((slot = cache->slot_of_row[id1]) != TSP_DIST_NO_SLOT) {
+		cache->last_used[slot] = ++cache->tick;
+		cache->n_hits++;
+		return cache->rows[slot * matrix->size + id2];
+	}
+	if ((slot = cache->slot_of_row[id2]) != TSP_DIST_NO_SLOT) {
+		cache->last_used[slot] = ++cache->tick;
+		cache->n_hits++;
+		return cache->rows[slot * matrix->size + id1];
+	}
+
+	cache->n_computed++;
+	if (++cache->misses[id1] >= cache->threshold) {
+		_cache_load_row(matrix, id1);
+	} else if (++cache->misses[id2] >= cache->threshold) {
+		_cache_load_row(matrix, id2);
+	}
+	if (++cache->n_recent_misses >= cache->aging_period) {
+		for (size_t i = 0; i < matrix->size; i++) {
+			cache->misses[i] /= 2;
+		}
+		cache->n_recent_misses = 0;
+	}
+	return node_dist(matrix->nodes[id1], matrix->nodes[id2]);
+}
+
+/* Position of (x, y) along a Hilbert curve filling a 2^16 x 2^16 grid */
+uint64_t _hilbert_index(uint32_t x, uint32_t y)
+{
+	const uint32_t n = 1u << 16;
+	uint64_t d = 0;
+	for (uint32_t s = n / 2; s > 0; s /= 2) {
+		const uint32_t rx = (x & s) != 0;
+		const uint32_t ry = (y & s) != 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+		/* Rotate the quadrant, so that the curve stays continuous */
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			const uint32_t t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+int _hilbert_key_cmp(const void *a, const void *b)
+{
+	const struct hilbert_key *const k1 = a;
+	const struct hilbert_key *const k2 = b;
+	if (k1->key != k2->key) {
+		return k1->key < k2->key ? -1 : 1;
+	}
+	return k1->id < k2->id ? -1 : k1->id > k2->id;
+}
+
+/* Returns the IDs of the nodes (indexed by node ID) sorted along a Hilbert
+ * curve over their bounding box, for tsp_dist_matrix_renumber. */
+unsigned *tsp_nodes_hilbert_order(const struct tsp_node *nodes, size_t size)
+{
+	struct hilbert_key *const keys = malloc_or_die(MAX(1, size) * sizeof(struct hilbert_key));
+	unsigned *const order = malloc_or_die(MAX(1, size) * sizeof(unsigned));
+	int64_t min_x = INT_MAX, max_x = INT_MIN, min_y = INT_MAX, max_y = INT_MIN;
+
+	for (size_t i = 0; i < size; i++) {
+		min_x = MIN(min_x, nodes[i].x);
+		max_x = MAX(max_x, nodes[i].x);
+		min_y = MIN(min_y, nodes[i].y);
+		max_y = MAX(max_y, nodes[i].y);
+	}
+	/* Both axes share the scale, so that the curve does not stretch */
+	const uint64_t range = MAX(1, MAX(max_x - min_x, max_y - min_y));
+	for (size_t i = 0; i < size; i++) {
+		const uint32_t x = (uint64_t)(nodes[i].x - min_x) * 0xffff / range;
+		const uint32_t y = (uint64_t)(nodes[i].y - min_y) * 0xffff / range;
+		keys[i].key = _hilbert_index(x, y);
+		keys[i].id = i;
+	}
+	qsort(keys, size, sizeof(struct hilbert_key), _hilbert_key_cmp);
+	for (size_t i = 0; i < size; i++) {
+		order[i] = keys[i].id;
+	}
+	free(keys);
+	return order;
+}
+
+/* Returns the IDs of the nodes in the order of a nearest neighbour tour
+ * starting from node 0, for tsp_dist_matrix_renumber. Takes O(size^2)
+ * distance lookups, but needs no coordinates. */
+unsigned *tsp_dist_matrix_greedy_order(const struct tsp_dist_matrix *matrix)
+{
+	const size_t size = matrix->size;
+	unsigned *const order = malloc_or_die(MAX(1, size) * sizeof(unsigned));
+	bool *const visited = calloc_or_die(MAX(1, size) * sizeof(bool));
+
+	for (size_t k = 0; k < size; k++) {
+		size_t next = 0;
+		if (k != 0) {
+			unsigned long best_dist = ULONG_MAX;
+			for (size_t j = 0; j < size; j++) {
+				if (visited[j]) {
+					continue;
+				}
+				const unsigned long dist = mdist(order[k - 1], j, matrix);
+				if (dist < best_dist) {
+					best_dist = dist;
+					next = j;
+				}
+			}
+		}
+		order[k] = next;
+		visited[next] = true;
+	}
+	free(visited);
+	return order;
+}
+
+/* Replaces the nodes of a matrix by the given ones in the given order, each
+ * renamed to its position, and records their IDs in the instance file. Takes
+ * ownership of order, which becomes the new orig_ids. */
+void _renumber_nodes(struct tsp_dist_matrix *matrix, const struct tsp_node *nodes, const unsigned *orig_ids, unsigned *order)
+{
+	struct tsp_node *const renumbered = malloc_or_die(MAX(1, matrix->size) * sizeof(struct tsp_node));
+	for (size_t i = 0; i < matrix->size; i++) {
+		renumbered[i] = nodes[order[i]];
+		renumbered[i].id = i;
+		if (orig_ids != NULL) {
+			order[i] = orig_ids[order[i]];
+		}
+	}
+	free(matrix->nodes);
+	free(matrix->orig_ids);
+	matrix->nodes = renumbered;
+	matrix->orig_ids = order;
+	tsp_dist_matrix_update_costs(matrix);
+}
+
+/* Renumbers the nodes of a matrix, so that node i becomes the node whose ID
+ * was order[i]. The stored distances are rebuilt in the same backend, so the
+ * old and the new matrix briefly coexist. Takes ownership of order. Node IDs
+ * held elsewhere (e.g. in graph stacks) become invalid. */
+void tsp_dist_matrix_renumber(struct tsp_dist_matrix *matrix, unsigned *order)
+{
+	struct tsp_dist_matrix renumbered;
+	const size_t size = matrix->size;
+
+	if (matrix->storage == TSP_DIST_COMPUTED) {
+		tsp_dist_matrix_init_empty(&renumbered);
+		renumbered.size = size;
+		renumbered.storage = TSP_DIST_COMPUTED;
+		renumbered.cache = _cache_create(size);
+	} else {
+		struct tsp_dist_builder builder;
+		size_t bad_node;
+		tsp_dist_builder_begin(&builder, &renumbered, size, matrix->storage);
+		for (size_t i = 0; i < size; i++) {
+			for (size_t j = 0; j < size; j++) {
+				tsp_dist_builder_set(&builder, i, j, mdist(order[i], order[j], matrix));
+			}
+		}
+		if (!tsp_dist_builder_end(&builder, &bad_node)) {
+			error(("renumbering made node %zu asymmetric", bad_node));
+		}
+	}
+	_renumber_nodes(&renumbered, matrix->nodes, matrix->orig_ids, order);
+	renumbered.n_refs = matrix->n_refs;
+	tsp_dist_matrix_free(matrix);
+	*matrix = renumbered;
+}
+
+/* Stores the folded weight (see mweight) of every pair of nodes, which the
+ * evaluators then use instead of separate distance and cost lookups. The
+ * weights take another size x size matrix, and must be folded again if the
+ * costs change. Returns false, folding nothing, if the matrix is not dense,
+ * as that would bring back the memory the other backends save, or if some
+ * weight does not fit in an unsigned. */
+bool tsp_dist_matrix_fold_costs(struct tsp_dist_matrix *matrix)
+{
+	const size_t size = matrix->size;
+	if (matrix->storage != TSP_DIST_DENSE) {
+		return false;
+	}
+	unsigned *const weights = malloc_or_die(MAX(1, size * size) * sizeof(unsigned));
+
+	for (size_t i = 0; i < size; i++) {
+		const struct tsp_node node = matrix->nodes[i];
+		unsigned *const row = &weights[i * size];
+		for (size_t j = 0; j < size; j++) {
+			const int64_t weight = 2 * (int64_t)mdist(i, j, matrix) + node.cost + matrix->nodes[j].cost;
+			if (weight < 0 || weight > UINT_MAX) {
+				free(weights);
+				return false;
+			}
+			row[j] = weight;
+		}
+	}
+	free(matrix->weights);
+	matrix->weights = weights;
+	return true;
+}
+
+/* Refreshes the cost table read by the evaluators from the costs of the
+ * nodes. Must be called whenever the latter change. */
+void tsp_dist_matrix_update_costs(struct tsp_dist_matrix *matrix)
+{
+	int *const costs = realloc(matrix->costs, MAX(1, matrix->size) * sizeof(int));
+	if (costs == NULL) {
+		error(("failed to allocate the costs of %zu nodes", matrix->size));
+	}
+	for (size_t i = 0; i < matrix->size; i++) {
+		costs[i] = matrix->nodes[i].cost;
+	}
+	matrix->costs = costs;
+}
+
+/* Makes dest an independent copy of src. A mapped dest is read-only,
+ * so it is replaced by a private copy. */
+void tsp_dist_matrix_copy(struct tsp_dist_matrix *dest, const struct tsp_dist_matrix *src)
+{
+	const size_t nodes_nbytes = src->size * sizeof(struct tsp_node);
+	const size_t dist_nbytes = src->storage == TSP_DIST_COMPUTED ? 0 : tsp_dist_matrix_nbytes(src);
+
+	if (
+		dest->map != NULL ||
+		dest->size != src->size ||
+		dest->storage != src->storage ||
+		dest->elem_size != src->elem_size ||
+		dest->n_tiles != src->n_tiles ||
+		dest->nodes == NULL
+	) {
+		tsp_dist_matrix_free(dest);
+		switch (src->storage) {
+			case TSP_DIST_DENSE:
+				dest->dist = malloc_or_die(MAX(1, dist_nbytes));
+			break;
+			case TSP_DIST_COMPUTED:
+				dest->cache = _cache_create(src->size);
+			break;
+			default:
+				dest->data = malloc_or_die(MAX(1, dist_nbytes));
+			break;
+		}
+		dest->nodes = malloc_or_die(MAX(1, nodes_nbytes));
+	}
+	switch (src->storage) {
+		case TSP_DIST_DENSE:
+			memcpy(dest->dist, src->dist, dist_nbytes);
+		break;
+		case TSP_DIST_COMPUTED:
+			/* The cached rows may belong to different coordinates */
+			_cache_clear(dest->cache, src->size);
+		break;
+		default:
+			memcpy(dest->data, src->data, dist_nbytes);
+		break;
+	}
+	memcpy(dest->nodes, src->nodes, nodes_nbytes);
+	if (src->orig_ids == NULL) {
+		free(dest->orig_ids);
+		dest->orig_ids = NULL;
+	} else {
+		if (dest->orig_ids == NULL) {
+			dest->orig_ids = malloc_or_die(MAX(1, src->size) * sizeof(unsigned));
+		}
+		memcpy(dest->orig_ids, src->orig_ids, src->size * sizeof(unsigned));
+	}
+	if (src->weights == NULL) {
+		free(dest->weights);
+		dest->weights = NULL;
+	} else {
+		if (dest->weights == NULL) {
+			dest->weights = malloc_or_die(MAX(1, src->size * src->size) * sizeof(unsigned));
+		}
+		memcpy(dest->weights, src->weights, src->size * src->size * sizeof(unsigned));
+	}
+	dest->size = src->size;
+	dest->storage = src->storage;
+	dest->elem_size = src->elem_size;
+	dest->n_tiles = src->n_tiles;
+	tsp_dist_matrix_update_costs(dest);
+}
+
+/* Returns the number of bytes taken up by the stored or cached distances. */
+size_t tsp_dist_matrix_nbytes(const struct tsp_dist_matrix *matrix)
+{
+	switch (matrix->storage) {
+		case TSP_DIST_DENSE:
+			return matrix->size * matrix->size * matrix->elem_size;
+		case TSP_DIST_PACKED:
+			return matrix->size * (matrix->size - (matrix->size != 0)) / 2 * matrix->elem_size;
+		case TSP_DIST_TILED:
+			return matrix->n_tiles * (matrix->n_tiles + 1) / 2 * TSP_DIST_TILE * TSP_DIST_TILE * matrix->elem_size;
+		default:
+			return matrix->cache->n_rows * (matrix->size * sizeof(unsigned) + sizeof(uint32_t) + sizeof(uint64_t))
+				+ matrix->size * 2 * sizeof(uint32_t);
+	}
+}
+
+void tsp_dist_matrix_print(struct tsp_dist_matrix matrix)
+{
+	printf("tsp_dist_matrix_print()\n");
+	printf("       ");
+	for (size_t j = 0; j < matrix.size; j++) {
+		printf("[%3zu]  ", j);
+	}
+	putchar('\n');
+	for (size_t i = 0; i < matrix.size; i++) {
+		printf("[%3zu]  ", i);
+		for (size_t j = 0; j < matrix.size; j++) {
+			const unsigned long dist = mdist(i, j, &matrix);
+			printf("%5lu  ", dist);
+		}
+		putchar('\n');
+	}
+}
+
+/* Writes the node records and the distance matrix to a binary instance file,
+ * which can later be mapped with tsp_dist_matrix_map. */
+void tsp_dist_matrix_save(const struct tsp_dist_matrix *matrix, const char *fpath)
+{
+	struct tsp_bin_header header;
+	const size_t nodes_nbytes = matrix->size * sizeof(struct tsp_node);
+	const size_t dist_nbytes = matrix->size * matrix->size * sizeof(unsigned);
+	static const char padding[TSP_BIN_ALIGN];
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TSP_BIN_MAGIC, sizeof(TSP_BIN_MAGIC));
+	header.node_size = sizeof(struct tsp_node);
+	header.dist_size = sizeof(unsigned);
+	header.n_nodes = matrix->size;
+	header.nodes_offset = TSP_BIN_ALIGN;
+	header.dist_offset = header.nodes_offset + ((nodes_nbytes + TSP_BIN_ALIGN - 1) / TSP_BIN_ALIGN) * TSP_BIN_ALIGN;
+	header.ids_offset = matrix->orig_ids != NULL ? header.dist_offset + dist_nbytes : 0;
+
+	FILE *const f = fopen(fpath, "wb");
+	if (f == NULL) {
+		error(("failed to open %s for writing", fpath));
+	}
+	if (
+		fwrite(&header, sizeof(header), 1, f) != 1 ||
+		fwrite(padding, header.nodes_offset - sizeof(header), 1, f) != 1 ||
+		(nodes_nbytes != 0 && fwrite(matrix->nodes, nodes_nbytes, 1, f) != 1) ||
+		(header.dist_offset != header.nodes_offset + nodes_nbytes && fwrite(padding, header.dist_offset - header.nodes_offset - nodes_nbytes, 1, f) != 1)
+	) {
+		error(("failed to write %s", fpath));
+	}
+	if (matrix->storage == TSP_DIST_DENSE) {
+		if (dist_nbytes != 0 && fwrite(matrix->dist, dist_nbytes, 1, f) != 1) {
+			error(("failed to write %s", fpath));
+		}
+	} else {
+		/* The file always holds the full matrix, so expand it row by row */
+		unsigned *const row = malloc_or_die(MAX(1, matrix->size) * sizeof(unsigned));
+		for (size_t i = 0; i < matrix->size; i++) {
+			for (size_t j = 0; j < matrix->size; j++) {
+				row[j] = mdist(i, j, matrix);
+			}
+			if (fwrite(row, matrix->size * sizeof(unsigned), 1, f) != 1) {
+				error(("failed to write %s", fpath));
+			}
+		}
+		free(row);
+	}
+	if (matrix->orig_ids != NULL && matrix->size != 0 && fwrite(matrix->orig_ids, matrix->size * sizeof(unsigned), 1, f) != 1) {
+		error(("failed to write %s", fpath));
+	}
+	fclose(f);
+}
+
+/* Maps a binary instance file read-only. The node and distance arrays point
+ * straight into the mapping, so the pages are shared between all processes
+ * that map the same file, and must never be written to. */
+void tsp_dist_matrix_map(struct tsp_dist_matrix *matrix, const char *fpath)
+{
+	struct stat st;
+	const int fd = open(fpath, O_RDONLY);
+	if (fd == -1) {
+		error(("file not found: %s", fpath));
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct tsp_bin_header)) {
+		error(("not a binary instance file: %s", fpath));
+	}
+	void *const map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		error(("failed to map %s", fpath));
+	}
+
+	const struct tsp_bin_header *const header = map;
+	if (memcmp(header->magic, TSP_BIN_MAGIC, sizeof(TSP_BIN_MAGIC)) != 0) {
+		error(("not a binary instance file: %s", fpath));
+	}
+	if (header->node_size != sizeof(struct tsp_node) || header->dist_size != sizeof(unsigned)) {
+		error(("binary instance file %s was written on an incompatible platform", fpath));
+	}
+	/* Offsets and sizes come from the file, so every bound is checked by
+	 * division, which cannot overflow */
+	const uint64_t file_size = st.st_size;
+	const uint64_t n_nodes = header->n_nodes;
+	if (
+		header->nodes_offset < sizeof(struct tsp_bin_header) ||
+		header->nodes_offset > header->dist_offset ||
+		n_nodes > (header->dist_offset - header->nodes_offset) / sizeof(struct tsp_node) ||
+		n_nodes > UINT_MAX
+	) {
+		error(("binary instance file %s is corrupt", fpath));
+	}
+	if (
+		header->dist_offset > file_size ||
+		(n_nodes != 0 && n_nodes > (file_size - header->dist_offset) / sizeof(unsigned) / n_nodes)
+	) {
+		error(("binary instance file %s is truncated", fpath));
+	}
+	if (
+		header->ids_offset != 0 &&
+		(header->ids_offset > file_size || n_nodes > (file_size - header->ids_offset) / sizeof(unsigned))
+	) {
+		error(("binary instance file %s is truncated", fpath));
+	}
+	/* The arrays are accessed in place, so they must be aligned as written
+	 * by tsp_dist_matrix_save (the IDs follow the distances directly) */
+	if (
+		header->nodes_offset % TSP_BIN_ALIGN != 0 ||
+		header->dist_offset % TSP_BIN_ALIGN != 0 ||
+		header->ids_offset % __alignof__(unsigned) != 0
+	) {
+		error(("binary instance file %s is corrupt", fpath));
+	}
+
+	const struct tsp_node *const nodes = (const struct tsp_node*)((const char*)map + header->nodes_offset);
+	const unsigned *const orig_ids = header->ids_offset != 0 ? (const unsigned*)((const char*)map + header->ids_offset) : NULL;
+	for (size_t i = 0; i < n_nodes; i++) {
+		if (nodes[i].id >= n_nodes || (orig_ids != NULL && orig_ids[i] >= n_nodes)) {
+			error(("binary instance file %s is corrupt: node %zu has an invalid ID", fpath, i));
+		}
+	}
+
+	tsp_dist_matrix_init_empty(matrix);
+	matrix->nodes = (struct tsp_node*)((char*)map + header->nodes_offset);
+	matrix->dist = (unsigned*)((char*)map + header->dist_offset);
+	matrix->size = header->n_nodes;
+	if (header->ids_offset != 0) {
+		matrix->orig_ids = (unsigned*)((char*)map + header->ids_offset);
+	}
+	matrix->map = map;
+	matrix->map_size = st.st_size;
+	tsp_dist_matrix_update_costs(matrix);
+}
+
+/* Releases the node and distance arrays, whether allocated or mapped. */
+void tsp_dist_matrix_free(struct tsp_dist_matrix *matrix)
+{
+	if (matrix->map != NULL) {
+		munmap(matrix->map, matrix->map_size);
+	} else {
+		free(matrix->dist);
+		free(matrix->data);
+		_cache_destroy(matrix->cache);
+		free(matrix->nodes);
+		free(matrix->orig_ids);
+	}
+	/* Costs and folded weights are never part of a mapping */
+	free(matrix->costs);
+	free(matrix->weights);
+	tsp_dist_matrix_init_empty(matrix);
+}
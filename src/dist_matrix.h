@@ -0,0 +1,177 @@
+#ifndef TSP_DIST_MATRIX_H
+#define TSP_DIST_MATRIX_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../libstaple/src/staple.h"
+
+/* Side length of a single tile of the TSP_DIST_TILED backend */
+#define TSP_DIST_TILE 64
+
+/* Number of rows kept by the TSP_DIST_COMPUTED backend's row cache */
+#define TSP_DIST_CACHE_ROWS 64
+
+/* Structs */
+struct tsp_node {
+	unsigned id;  /* Unique ID used to access the distance matrix */
+	int x;
+	int y;
+	int cost;
+};
+
+/* Backends of the distance oracle. All of them return identical distances,
+ * they only trade memory for lookup speed. */
+enum tsp_dist_storage {
+	TSP_DIST_DENSE,     /* Full size x size matrix of unsigned */
+	TSP_DIST_PACKED,    /* Upper triangle of uint16_t or uint32_t, whichever fits */
+	TSP_DIST_TILED,     /* Upper triangle of TSP_DIST_TILE x TSP_DIST_TILE tiles, uint16_t or uint32_t */
+	TSP_DIST_COMPUTED,  /* Computed from coordinates on demand, with an LRU row cache */
+	TSP_DIST_AUTO,      /* Whichever of the above suits the number of nodes */
+};
+
+/* LRU row cache of the TSP_DIST_COMPUTED backend. It changes on every lookup,
+ * so every matrix owns a separate one, shared by the graphs sharing it. */
+struct tsp_dist_cache {
+	unsigned *rows;          /* n_rows x size distances */
+	uint32_t *row_of_slot;   /* Node ID cached in each slot, UINT32_MAX if empty */
+	uint32_t *slot_of_row;   /* Slot caching each node ID, UINT32_MAX if not cached */
+	uint64_t *last_used;     /* Tick of the last hit of each slot */
+	uint32_t *misses;        /* Recent misses of each node ID, halved periodically */
+	uint64_t tick;
+	size_t n_rows;
+	size_t threshold;        /* Misses after which a row gets cached */
+	size_t aging_period;     /* Misses after which all miss counters are halved */
+	size_t n_recent_misses;  /* Misses since the counters were last halved */
+	size_t n_hits;           /* Statistics */
+	size_t n_computed;
+	size_t n_loads;
+};
+
+struct tsp_dist_matrix {
+	unsigned *dist;                /* 2D size x size matrix of distances (TSP_DIST_DENSE) */
+	void *data;                    /* Stored distances (TSP_DIST_PACKED, TSP_DIST_TILED) */
+	struct tsp_dist_cache *cache;  /* Row cache (TSP_DIST_COMPUTED) */
+	struct tsp_node *nodes;        /* 1D array of nodes, indexed by node ID */
+	int *costs;                    /* Cost of each node, indexed by node ID (see tsp_dist_matrix_update_costs) */
+	size_t size;                   /* Number of nodes */
+	enum tsp_dist_storage storage;
+	size_t elem_size;              /* Size of a single stored distance in bytes */
+	size_t n_tiles;                /* Number of tiles along each side (TSP_DIST_TILED) */
+	unsigned *orig_ids;            /* ID each node had in the instance file, NULL if not renumbered */
+	unsigned *weights;             /* size x size folded edge weights, or NULL (see tsp_dist_matrix_fold_costs) */
+	void *map;                     /* Read-only mapping of a binary instance file, or NULL */
+	size_t map_size;               /* Length of the mapping in bytes */
+	size_t n_refs;                 /* Number of owners (only of matrices from tsp_dist_matrix_create) */
+};
+
+/* State of a matrix being built from explicit distances */
+struct tsp_dist_builder {
+	struct tsp_dist_matrix *matrix;
+	size_t n_elems;         /* Number of stored elements (TSP_DIST_PACKED, TSP_DIST_TILED) */
+	uint64_t *upper_sums;   /* Per-node hashes of the pairs seen from each side, */
+	uint64_t *lower_sums;   /* to check the symmetry of the matrix */
+};
+
+
+/* Functions */
+void tsp_dist_matrix_set_default_storage(enum tsp_dist_storage storage);
+enum tsp_dist_storage tsp_dist_matrix_get_default_storage(void);
+void tsp_dist_matrix_set_threads(size_t n_threads);
+void tsp_dist_matrix_set_renumbering(bool renumber);
+bool tsp_dist_matrix_get_renumbering(void);
+enum tsp_dist_storage tsp_dist_storage_for_size(size_t size);
+const char *tsp_dist_storage_name(enum tsp_dist_storage storage);
+void tsp_dist_matrix_init_empty(struct tsp_dist_matrix *matrix);
+struct tsp_dist_matrix *tsp_dist_matrix_create(void);
+struct tsp_dist_matrix *tsp_dist_matrix_share(struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_release(struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_init(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes);
+void tsp_dist_matrix_init_storage(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes, enum tsp_dist_storage storage);
+void tsp_dist_matrix_read(struct tsp_dist_matrix *matrix, const char *matrix_fpath, const char *costs_fpath);
+void tsp_dist_matrix_read_storage(struct tsp_dist_matrix *matrix, const char *matrix_fpath, const char *costs_fpath, enum tsp_dist_storage storage);
+void tsp_nodes_read_costs(struct tsp_node *nodes, size_t size, const char *fpath);
+void tsp_dist_builder_begin(struct tsp_dist_builder *builder, struct tsp_dist_matrix *matrix, size_t size, enum tsp_dist_storage storage);
+bool tsp_dist_builder_set(struct tsp_dist_builder *builder, size_t i, size_t j, uint32_t dist);
+bool tsp_dist_builder_end(struct tsp_dist_builder *builder, size_t *bad_node);
+unsigned *tsp_nodes_hilbert_order(const struct tsp_node *nodes, size_t size);
+unsigned *tsp_dist_matrix_greedy_order(const struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_renumber(struct tsp_dist_matrix *matrix, unsigned *order);
+bool tsp_dist_matrix_fold_costs(struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_update_costs(struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_copy(struct tsp_dist_matrix *dest, const struct tsp_dist_matrix *src);
+size_t tsp_dist_matrix_nbytes(const struct tsp_dist_matrix *matrix);
+void tsp_dist_matrix_print(struct tsp_dist_matrix matrix);
+void tsp_dist_matrix_save(const struct tsp_dist_matrix *matrix, const char *fpath);
+void tsp_dist_matrix_map(struct tsp_dist_matrix *matrix, const char *fpath);
+void tsp_dist_matrix_free(struct tsp_dist_matrix *matrix);
+unsigned long tsp_dist_computed_get(const struct tsp_dist_matrix *matrix, size_t id1, size_t id2);
+
+
+/* Index of the (id1, id2) pair in a packed upper triangle, where id1 < id2 */
+static inline size_t tsp_dist_packed_idx(size_t id1, size_t id2, size_t size)
+{
+	return id1 * (2 * size - id1 - 3) / 2 + id2 - 1;
+}
+
+/* Index of the (id1, id2) pair in the tiled upper triangle, where the tile
+ * of id1 does not come after the tile of id2 */
+static inline size_t tsp_dist_tiled_idx(size_t id1, size_t id2, size_t n_tiles)
+{
+	const size_t t1 = id1 / TSP_DIST_TILE;
+	const size_t t2 = id2 / TSP_DIST_TILE;
+	const size_t tile = t1 * n_tiles - t1 * (t1 - 1) / 2 + (t2 - t1);
+	return tile * TSP_DIST_TILE * TSP_DIST_TILE + (id1 % TSP_DIST_TILE) * TSP_DIST_TILE + (id2 % TSP_DIST_TILE);
+}
+
+static inline unsigned long tsp_dist_stored_get(const struct tsp_dist_matrix *matrix, size_t idx)
+{
+	if (matrix->elem_size == sizeof(uint16_t)) {
+		return ((const uint16_t*)matrix->data)[idx];
+	}
+	return ((const uint32_t*)matrix->data)[idx];
+}
+
+/* ID a node had in the instance file, before any renumbering */
+static inline unsigned tsp_dist_matrix_orig_id(const struct tsp_dist_matrix *matrix, unsigned id)
+{
+	return matrix->orig_ids != NULL ? matrix->orig_ids[id] : id;
+}
+
+/* Distance between two nodes, given by their IDs */
+static inline unsigned long mdist(size_t id1, size_t id2, const struct tsp_dist_matrix *matrix)
+{
+	switch (matrix->storage) {
+		case TSP_DIST_DENSE:
+			return matrix->dist[id1 * matrix->size + id2];
+		case TSP_DIST_PACKED:
+			if (id1 == id2) {
+				return 0;
+			}
+			return tsp_dist_stored_get(matrix, id1 < id2
+				? tsp_dist_packed_idx(id1, id2, matrix->size)
+				: tsp_dist_packed_idx(id2, id1, matrix->size));
+		case TSP_DIST_TILED:
+			return tsp_dist_stored_get(matrix, id1 / TSP_DIST_TILE <= id2 / TSP_DIST_TILE
+				? tsp_dist_tiled_idx(id1, id2, matrix->n_tiles)
+				: tsp_dist_tiled_idx(id2, id1, matrix->n_tiles));
+		default:
+			return tsp_dist_computed_get(matrix, id1, id2);
+	}
+}
+
+/* Cost of a node, given by its ID */
+static inline int mcost(size_t id, const struct tsp_dist_matrix *matrix)
+{
+	return matrix->costs[id];
+}
+
+/* Folded weight of an edge: twice the distance plus the costs of both nodes.
+ * Every node of a cycle has two edges, so half the sum of its weights is the
+ * objective, and likewise for the deltas of moves. Requires weights. */
+static inline unsigned long mweight(size_t id1, size_t id2, const struct tsp_dist_matrix *matrix)
+{
+	return matrix->weights[id1 * matrix->size + id2];
+}
+
+#endif /* TSP_DIST_MATRIX_H */
@@ -0,0 +1,23 @@
+#include "eval.h"
+
+/* Picks the evaluators specialized for the storage of a matrix */
+void tsp_eval_init(struct tsp_eval *eval, const struct tsp_dist_matrix *matrix)
+{
+	eval->matrix = matrix;
+	eval->costs = matrix->costs;
+	eval->size = matrix->size;
+	switch (matrix->storage) {
+		case TSP_DIST_DENSE:
+			eval->data = matrix->dist;
+			eval->layout = TSP_EVAL_DENSE;
+		break;
+		case TSP_DIST_PACKED:
+			eval->data = matrix->data;
+			eval->layout = matrix->elem_size == sizeof(uint16_t) ? TSP_EVAL_PACKED16 : TSP_EVAL_PACKED32;
+		break;
+		default:
+			eval->data = NULL;
+			eval->layout = TSP_EVAL_GENERIC;
+		break;
+	}
+}
@@ -0,0 +1,156 @@
+#ifndef TSP_EVAL_H
+#define TSP_EVAL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "dist_matrix.h"
+#include "tour.h"
+
+/* Layouts of a distance matrix with evaluators specialized for them. Each
+ * layout fixes the type of a stored distance and the width of a delta, so
+ * that lookups need not check the storage of the matrix every time. */
+enum tsp_eval_layout {
+	TSP_EVAL_GENERIC,   /* Any storage, looked up through mdist, long deltas */
+	TSP_EVAL_DENSE,     /* size x size unsigned, int64_t deltas */
+	TSP_EVAL_PACKED16,  /* Packed upper triangle of uint16_t, int32_t deltas */
+	TSP_EVAL_PACKED32,  /* Packed upper triangle of uint32_t, int64_t deltas */
+};
+
+/* Distance matrix as seen by the evaluators below, set up by tsp_eval_init */
+struct tsp_eval {
+	const struct tsp_dist_matrix *matrix;
+	const void *data;  /* Stored distances, unless the layout is TSP_EVAL_GENERIC */
+	const int *costs;
+	size_t size;
+	enum tsp_eval_layout layout;
+};
+
+void tsp_eval_init(struct tsp_eval *eval, const struct tsp_dist_matrix *matrix);
+
+
+/* Lookups of the distance between node IDs id1 and id2, as size_t variables */
+#define TSP_EVAL_GET_GENERIC(eval, elem_t, id1, id2) \
+	mdist(id1, id2, (eval)->matrix)
+#define TSP_EVAL_GET_DENSE(eval, elem_t, id1, id2) \
+	((const elem_t*)(eval)->data)[(id1) * (eval)->size + (id2)]
+#define TSP_EVAL_GET_PACKED(eval, elem_t, id1, id2) \
+	((id1) == (id2) ? 0 : ((const elem_t*)(eval)->data)[(id1) < (id2) \
+		? tsp_dist_packed_idx(id1, id2, (eval)->size) \
+		: tsp_dist_packed_idx(id2, id1, (eval)->size)])
+
+/* Defines the evaluators of a layout, suffixed with name:
+ *   tsp_eval_dist_<name>, the distance between two node IDs,
+ *   tsp_eval_swap_nodes_<name>, see tsp_nodes_evaluate_swap_nodes,
+ *   tsp_eval_swap_edges_<name>, see tsp_nodes_evaluate_swap_edges,
+ *   tsp_eval_inter_swap_<name>, see tsp_graph_evaluate_inter_swap.
+ * GET is one of the TSP_EVAL_GET_* lookups, reading elements of elem_t.
+ * Costs can take any int, so inter-route swaps add them in int64_t whatever
+ * delta_t is. */
+#define TSP_EVAL_DEFINE(name, elem_t, delta_t, GET) \
+static inline delta_t tsp_eval_dist_##name(const struct tsp_eval *eval, size_t id1, size_t id2) \
+{ \
+	return (delta_t)GET(eval, elem_t, id1, id2); \
+} \
+\
+static inline delta_t tsp_eval_swap_nodes_##name(const struct tsp_eval *eval, const struct tsp_tour *nodes, size_t idx1, size_t idx2) \
+{ \
+	const size_t n1 = tsp_tour_get(nodes, idx1); \
+	const size_t n2 = tsp_tour_get(nodes, idx2); \
+	const size_t n1_prev = tsp_tour_get(nodes, (idx1 + nodes->size - 1) % nodes->size); \
+	const size_t n1_next = tsp_tour_get(nodes, (idx1 + 1) % nodes->size); \
+	const size_t n2_prev = tsp_tour_get(nodes, (idx2 + nodes->size - 1) % nodes->size); \
+	const size_t n2_next = tsp_tour_get(nodes, (idx2 + 1) % nodes->size); \
+	return \
+		- tsp_eval_dist_##name(eval, n1, n1_prev) \
+		- tsp_eval_dist_##name(eval, n1, n1_next) \
+		- tsp_eval_dist_##name(eval, n2, n2_prev) \
+		- tsp_eval_dist_##name(eval, n2, n2_next) \
+		+ tsp_eval_dist_##name(eval, n2, n1_prev != n2 ? n1_prev : n1) \
+		+ tsp_eval_dist_##name(eval, n2, n1_next != n2 ? n1_next : n1) \
+		+ tsp_eval_dist_##name(eval, n1, n2_prev != n1 ? n2_prev : n2) \
+		+ tsp_eval_dist_##name(eval, n1, n2_next != n1 ? n2_next : n2); \
+} \
+\
+static inline delta_t tsp_eval_swap_edges_##name(const struct tsp_eval *eval, const struct tsp_tour *nodes, size_t idx1, size_t idx2) \
+{ \
+	if (idx1 > idx2) { \
+		const size_t tmp = idx1; \
+		idx1 = idx2; \
+		idx2 = tmp; \
+	} \
+	const size_t n1 = tsp_tour_get(nodes, idx1); \
+	const size_t n2 = tsp_tour_get(nodes, idx2); \
+	const size_t n1_prev = tsp_tour_get(nodes, (idx1 + nodes->size - 1) % nodes->size); \
+	const size_t n2_next = tsp_tour_get(nodes, (idx2 + 1) % nodes->size); \
+	return \
+		- tsp_eval_dist_##name(eval, n1, n1_prev) \
+		- tsp_eval_dist_##name(eval, n2, n2_next) \
+		+ tsp_eval_dist_##name(eval, n1, n2_next != n1 ? n2_next : n2) \
+		+ tsp_eval_dist_##name(eval, n2, n1_prev != n2 ? n1_prev : n1); \
+} \
+\
+static inline int64_t tsp_eval_inter_swap_##name(const struct tsp_eval *eval, const struct tsp_tour *active, const struct tsp_tour *vacant, size_t active_idx, size_t vacant_idx) \
+{ \
+	const size_t n1 = tsp_tour_get(vacant, vacant_idx); \
+	const size_t n2 = tsp_tour_get(active, active_idx); \
+	const size_t n2_prev = tsp_tour_get(active, (active_idx + active->size - 1) % active->size); \
+	const size_t n2_next = tsp_tour_get(active, (active_idx + 1) % active->size); \
+	const delta_t dist_delta = \
+		- tsp_eval_dist_##name(eval, n2, n2_prev) \
+		- tsp_eval_dist_##name(eval, n2, n2_next) \
+		+ tsp_eval_dist_##name(eval, n1, n2_prev) \
+		+ tsp_eval_dist_##name(eval, n1, n2_next); \
+	return (int64_t)dist_delta - eval->costs[n2] + eval->costs[n1]; \
+}
+
+TSP_EVAL_DEFINE(generic, unsigned, long, TSP_EVAL_GET_GENERIC)
+TSP_EVAL_DEFINE(dense, unsigned, int64_t, TSP_EVAL_GET_DENSE)
+TSP_EVAL_DEFINE(packed16, uint16_t, int32_t, TSP_EVAL_GET_PACKED)
+TSP_EVAL_DEFINE(packed32, uint32_t, int64_t, TSP_EVAL_GET_PACKED)
+
+
+/* Evaluators of any layout. The layout is the same on every call, so in a
+ * loop the branch on it is always predicted and the rest is inlined. */
+static inline long tsp_eval_swap_nodes(const struct tsp_eval *eval, const struct tsp_tour *nodes, size_t idx1, size_t idx2)
+{
+	switch (eval->layout) {
+		case TSP_EVAL_DENSE:
+			return tsp_eval_swap_nodes_dense(eval, nodes, idx1, idx2);
+		case TSP_EVAL_PACKED16:
+			return tsp_eval_swap_nodes_packed16(eval, nodes, idx1, idx2);
+		case TSP_EVAL_PACKED32:
+			return tsp_eval_swap_nodes_packed32(eval, nodes, idx1, idx2);
+		default:
+			return tsp_eval_swap_nodes_generic(eval, nodes, idx1, idx2);
+	}
+}
+
+static inline long tsp_eval_swap_edges(const struct tsp_eval *eval, const struct tsp_tour *nodes, size_t idx1, size_t idx2)
+{
+	switch (eval->layout) {
+		case TSP_EVAL_DENSE:
+			return tsp_eval_swap_edges_dense(eval, nodes, idx1, idx2);
+		case TSP_EVAL_PACKED16:
+			return tsp_eval_swap_edges_packed16(eval, nodes, idx1, idx2);
+		case TSP_EVAL_PACKED32:
+			return tsp_eval_swap_edges_packed32(eval, nodes, idx1, idx2);
+		default:
+			return tsp_eval_swap_edges_generic(eval, nodes, idx1, idx2);
+	}
+}
+
+static inline long tsp_eval_inter_swap(const struct tsp_eval *eval, const struct tsp_tour *active, const struct tsp_tour *vacant, size_t active_idx, size_t vacant_idx)
+{
+	switch (eval->layout) {
+		case TSP_EVAL_DENSE:
+			return tsp_eval_inter_swap_dense(eval, active, vacant, active_idx, vacant_idx);
+		case TSP_EVAL_PACKED16:
+			return tsp_eval_inter_swap_packed16(eval, active, vacant, active_idx, vacant_idx);
+		case TSP_EVAL_PACKED32:
+			return tsp_eval_inter_swap_packed32(eval, active, vacant, active_idx, vacant_idx);
+		default:
+			return tsp_eval_inter_swap_generic(eval, active, vacant, active_idx, vacant_idx);
+	}
+}
+
+#endif /* TSP_EVAL_H */
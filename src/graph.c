@@ -3,6 +3,9 @@
 #include "../libstaple/src/staple.h"
 #include "heap.h"
 #include "hashmap.h"
+#include "scanner.h"
+#include "simd.h"
+#include "eval.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -21,42 +24,48 @@ struct id_val_pair {
 	size_t val;
 };
 
-
 /* Forward declarations */
 int _print_node(const void *ptr);
+void _print_nodes(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix);
 size_t _pack_into_size_t(size_t num1, size_t num2);
+long _insert_delta(const struct tsp_graph *graph, unsigned id, size_t idx);
+long _remove_delta(const struct tsp_graph *graph, size_t idx);
+void _update_score(struct tsp_graph *graph, long delta);
+void _swap_active_vacant(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx);
+size_t _edge_key(size_t id1, size_t id2);
+size_t _edges_hash(const struct tsp_tour *nodes, const size_t *starts, size_t n_starts);
+size_t _insert_hash_delta(const struct tsp_graph *graph, unsigned id, size_t idx);
+size_t _remove_hash_delta(const struct tsp_graph *graph, size_t idx);
+void _update_hash(struct tsp_graph *graph, size_t delta);
+bool _nodes_eq_reversed(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2);
+void _intra_rows_try(const struct tsp_intra_rows *rows, size_t idx, size_t dest_idx, long *min, size_t *min_idx, bool *min_edges);
 
 
-inline unsigned long mdist(size_t id1, size_t id2, const struct tsp_dist_matrix *matrix)
-{
-	return matrix->dist[id1 * matrix->size + id2];
-}
-
 struct sp_stack *tsp_nodes_read(const char *fpath)
 {
-	FILE *f;
+	struct tsp_scanner scanner;
 	struct sp_stack *nodes;
 	unsigned next_id = 0;
 
-	nodes = sp_stack_create(sizeof(struct tsp_node), 200);
+	tsp_scanner_open(&scanner, fpath);
+	nodes = sp_stack_create(sizeof(struct tsp_node), MAX(1, tsp_scanner_count_lines(&scanner)));
 
-	f = fopen(fpath, "r");
-	if (f == NULL) {
-		error(("file not found: %s", fpath));
-	}
-
-	for (size_t lineno = 1;; ++lineno) {
+	for (;;) {
 		struct tsp_node node;
+		int fields[3];
 		int n;
 
 		/* Parse line */
-		n = fscanf(f, "%d;%d;%d\n", &node.x, &node.y, &node.cost);
+		n = tsp_scanner_read_ints(&scanner, fields, ARRLEN(fields), ';');
 		if (n == EOF) {
-			info(("successfully parsed %zu lines from %s", lineno - 1, fpath));
+			info(("successfully parsed %zu lines from %s", scanner.token_lineno, fpath));
 			break;
-		} else if (n != 3) {
-			error(("failed to parse line %zu in %s: fscanf returned %d", lineno, fpath, n));
+		} else if (n != ARRLEN(fields)) {
+			error(("failed to parse line %zu in %s: expected 3 fields, parsed %d", scanner.token_lineno, fpath, n));
 		}
+		node.x = fields[0];
+		node.y = fields[1];
+		node.cost = fields[2];
 
 		assert(next_id != UINT_MAX);  /* Overflow detection */
 		node.id = next_id++;
@@ -64,148 +73,186 @@ struct sp_stack *tsp_nodes_read(const char *fpath)
 		/* Append new node to stack */
 		sp_stack_push(nodes, &node);
 	}
-	fclose(f);
+	tsp_scanner_close(&scanner);
 	return nodes;
 }
 
-void tsp_dist_matrix_init(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes)
+struct tsp_graph *tsp_graph_create(const struct sp_stack *nodes)
 {
-	matrix->dist = malloc_or_die(nodes->size * nodes->size * sizeof(unsigned));
-	matrix->nodes = malloc_or_die(nodes->size * sizeof(struct tsp_node));
-	for (size_t i = 0; i < nodes->size; i++) {
-		const struct tsp_node node1 = *(struct tsp_node*)sp_stack_get(nodes, i);
-		for (size_t j = i + 1; j < nodes->size; j++) {
-			const struct tsp_node node2 = *(struct tsp_node*)sp_stack_get(nodes, j);
-			const unsigned dist = ROUND(euclidean_dist(node1.x, node1.y, node2.x, node2.y));
-			matrix->dist[node1.id * nodes->size + node2.id] = dist;
-			matrix->dist[node2.id * nodes->size + node1.id] = dist;
-		}
-		matrix->nodes[node1.id] = node1;
-	}
-	matrix->size = nodes->size;
+	struct tsp_graph *const graph = tsp_graph_empty();
+	tsp_dist_matrix_init(graph->dist_matrix, nodes);
+	/* The matrix may have renumbered the nodes (see tsp_dist_matrix_set_renumbering) */
+	tsp_tour_fill(graph->nodes_vacant, graph->dist_matrix->size);
+	return graph;
 }
 
-void tsp_dist_matrix_print(struct tsp_dist_matrix matrix)
+struct tsp_graph *tsp_graph_empty(void)
 {
-	printf("tsp_dist_matrix_print()\n");
-	printf("       ");
-	for (size_t j = 0; j < matrix.size; j++) {
-		printf("[%3zu]  ", j);
-	}
-	putchar('\n');
-	for (size_t i = 0; i < matrix.size; i++) {
-		printf("[%3zu]  ", i);
-		for (size_t j = 0; j < matrix.size; j++) {
-			const unsigned dist = matrix.dist[i * matrix.size + j];
-			printf("%5u  ", dist);
-		}
-		putchar('\n');
-	}
+	struct tsp_graph *graph;
+	graph = malloc_or_die(sizeof(struct tsp_graph));
+	graph->nodes_active = tsp_tour_create(200);
+	graph->nodes_vacant = tsp_tour_create(200);
+	graph->dist_matrix = tsp_dist_matrix_create();
+	graph->active = tsp_bitset_create(0);
+	graph->score = 0;
+	graph->hash = 0;
+	graph->scratch[0] = graph->scratch[1] = NULL;
+	return graph;
 }
 
-struct tsp_graph *tsp_graph_create(const struct sp_stack *nodes)
+/* Creates a graph with all nodes vacant, sharing the instance of another
+ * graph, so that nothing is read or computed. */
+struct tsp_graph *tsp_graph_create_shared(const struct tsp_graph *graph)
+{
+	struct tsp_graph *const ret = malloc_or_die(sizeof(struct tsp_graph));
+	ret->nodes_active = tsp_tour_create(graph->dist_matrix->size);
+	ret->nodes_vacant = tsp_tour_create(graph->dist_matrix->size);
+	ret->dist_matrix = tsp_dist_matrix_share(graph->dist_matrix);
+	ret->active = tsp_bitset_create(ret->dist_matrix->size);
+	ret->score = 0;
+	ret->hash = 0;
+	ret->scratch[0] = ret->scratch[1] = NULL;
+	tsp_tour_fill(ret->nodes_vacant, ret->dist_matrix->size);
+	return ret;
+}
+
+/* Creates a graph from a binary instance file (see tsp_dist_matrix_save).
+ * Unlike tsp_graph_create, nothing is parsed or computed at startup. */
+struct tsp_graph *tsp_graph_load(const char *fpath)
 {
 	struct tsp_graph *const graph = tsp_graph_empty();
-	sp_stack_copy(graph->nodes_vacant, nodes, NULL);
-	tsp_dist_matrix_init(&graph->dist_matrix, nodes);
+	tsp_dist_matrix_map(graph->dist_matrix, fpath);
+	tsp_tour_fill(graph->nodes_vacant, graph->dist_matrix->size);
+	info(("successfully mapped %zu nodes from %s", graph->dist_matrix->size, fpath));
 	return graph;
 }
 
-struct tsp_graph *tsp_graph_empty(void)
+/* Creates a graph from an instance given only by its distances and costs
+ * (see tsp_dist_matrix_read). */
+struct tsp_graph *tsp_graph_read_matrix(const char *matrix_fpath, const char *costs_fpath)
 {
-	struct tsp_graph *graph;
-	graph = malloc_or_die(sizeof(struct tsp_graph));
-	graph->nodes_active = sp_stack_create(sizeof(struct tsp_node), 200);
-	graph->nodes_vacant = sp_stack_create(sizeof(struct tsp_node), 200);
-	graph->dist_matrix.dist = NULL;
-	graph->dist_matrix.size = 0;
+	struct tsp_graph *const graph = tsp_graph_empty();
+	tsp_dist_matrix_read(graph->dist_matrix, matrix_fpath, costs_fpath);
+	tsp_tour_fill(graph->nodes_vacant, graph->dist_matrix->size);
 	return graph;
 }
 
 struct tsp_graph *tsp_graph_import(const char *fpath)
 {
-	FILE *f;
+	struct tsp_scanner scanner;
 	struct tsp_graph *const graph = malloc_or_die(sizeof(struct tsp_graph));
 	struct sp_stack *all_nodes;
-	int n_vacant, n_active, n_total, err;
+	size_t *new_ids;
+	int header[2];
+	size_t n_vacant, n_active, n_total;
 	unsigned next_id = 0;
 
-	f = fopen(fpath, "r");
-	if (f == NULL) {
-		error(("file not found: %s", fpath));
+	tsp_scanner_open(&scanner, fpath);
+	if (tsp_scanner_read_ints(&scanner, header, ARRLEN(header), ';') != ARRLEN(header) || header[0] < 0 || header[1] < 0) {
+		error(("failed to parse line %zu in %s: expected the numbers of vacant and active nodes", scanner.token_lineno, fpath));
 	}
-	err = fscanf(f, "%d;%d\n", &n_vacant, &n_active);
-	assert(err == 2);
+	n_vacant = header[0];
+	n_active = header[1];
 	n_total = n_vacant + n_active;
 
-	graph->nodes_vacant = sp_stack_create(sizeof(struct tsp_node), n_total);
-	graph->nodes_active = sp_stack_create(sizeof(struct tsp_node), n_total);
-	all_nodes = sp_stack_create(sizeof(struct tsp_node), n_total);
+	if (n_total > TSP_TOUR_MAX_NODES) {
+		error(("%s: %zu nodes do not fit in tours of at most %zu nodes", fpath, n_total, TSP_TOUR_MAX_NODES));
+	}
+	graph->nodes_vacant = tsp_tour_create(n_total);
+	graph->nodes_active = tsp_tour_create(n_total);
+	graph->active = tsp_bitset_create(n_total);
+	all_nodes = sp_stack_create(sizeof(struct tsp_node), MAX(1, n_total));
 
-	while (n_vacant-- > 0) {
+	for (size_t i = 0; i < n_total; i++) {
 		struct tsp_node node;
+		int fields[3];
 		int n;
 
 		/* Parse line */
-		n = fscanf(f, "%d;%d;%d\n", &node.x, &node.y, &node.cost);
+		n = tsp_scanner_read_ints(&scanner, fields, ARRLEN(fields), ';');
 		if (n == EOF)
 			error(("unexpected EOF while importing from %s", fpath));
-		else if (n != 3)
-			error(("failed to parse %s: fscanf returned %d", fpath, n));
+		else if (n != ARRLEN(fields))
+			error(("failed to parse line %zu in %s: expected 3 fields, parsed %d", scanner.token_lineno, fpath, n));
+		node.x = fields[0];
+		node.y = fields[1];
+		node.cost = fields[2];
 
 		assert(next_id != UINT_MAX);  /* Overflow detection */
 		node.id = next_id++;
 
 		/* Append new node to stack */
-		sp_stack_push(graph->nodes_vacant, &node);
 		sp_stack_push(all_nodes, &node);
 	}
 
-	while (n_active-- > 0) {
-		struct tsp_node node;
-		int n;
-
-		/* Parse line */
-		n = fscanf(f, "%d;%d;%d\n", &node.x, &node.y, &node.cost);
-		if (n == EOF)
-			error(("unexpected EOF while importing from %s", fpath));
-		else if (n != 3)
-			error(("failed to parse %s: fscanf returned %d", fpath, n));
-
-		assert(next_id != UINT_MAX);  /* Overflow detection */
-		node.id = next_id++;
+	graph->dist_matrix = tsp_dist_matrix_create();
+	tsp_dist_matrix_init(graph->dist_matrix, all_nodes);
 
-		/* Append new node to stack */
-		sp_stack_push(graph->nodes_active, &node);
-		sp_stack_push(all_nodes, &node);
+	/* Vacant nodes come first. The matrix may have renumbered the nodes,
+	 * so they are looked up by the ID they were given above. */
+	new_ids = malloc_or_die(MAX(1, n_total) * sizeof(size_t));
+	for (size_t i = 0; i < n_total; i++) {
+		new_ids[tsp_dist_matrix_orig_id(graph->dist_matrix, i)] = i;
 	}
-
-	tsp_dist_matrix_init(&graph->dist_matrix, all_nodes);
+	for (size_t i = 0; i < n_total; i++) {
+		tsp_tour_push(i < n_vacant ? graph->nodes_vacant : graph->nodes_active, new_ids[i]);
+		if (i >= n_vacant) {
+			tsp_bitset_set(graph->active, new_ids[i]);
+		}
+	}
+	free(new_ids);
+	graph->score = n_active != 0 ? tsp_nodes_evaluate(graph->nodes_active, graph->dist_matrix) : 0;
+	graph->hash = tsp_nodes_hash(graph->nodes_active);
+	graph->scratch[0] = graph->scratch[1] = NULL;
 
 	info(("successfully parsed %zu lines from %s", n_total, fpath));
-	fclose(f);
+	tsp_scanner_close(&scanner);
 	sp_stack_destroy(all_nodes, NULL);
 	return graph;
 }
 
 void tsp_graph_copy(struct tsp_graph *dest, const struct tsp_graph *src)
 {
-	sp_stack_copy(dest->nodes_active, src->nodes_active, NULL);
-	sp_stack_copy(dest->nodes_vacant, src->nodes_vacant, NULL);
+	tsp_tour_copy(dest->nodes_active, src->nodes_active);
+	tsp_bitset_copy(dest->active, src->active);
+	tsp_tour_copy(dest->nodes_vacant, src->nodes_vacant);
+	dest->score = src->score;
+	dest->hash = src->hash;
 
-	const size_t dist_matrix_nbytes = src->dist_matrix.size * src->dist_matrix.size * sizeof(unsigned);
-	if (dest->dist_matrix.size != src->dist_matrix.size)
-		dest->dist_matrix.dist = realloc(dest->dist_matrix.dist, dist_matrix_nbytes);
-	memcpy(dest->dist_matrix.dist, src->dist_matrix.dist, dist_matrix_nbytes);
-	dest->dist_matrix.size = src->dist_matrix.size;
+	/* The instance is read-only, so it is shared rather than copied */
+	if (dest->dist_matrix != src->dist_matrix) {
+		tsp_dist_matrix_release(dest->dist_matrix);
+		dest->dist_matrix = tsp_dist_matrix_share(src->dist_matrix);
+	}
+}
+
+/* Allocates everything a graph may need later, sized for the whole instance,
+ * so that moves and recombination on it make no allocations. */
+void tsp_graph_reserve(struct tsp_graph *graph)
+{
+	const size_t size = graph->dist_matrix->size;
+	for (int i = 0; i < 2; i++) {
+		if (graph->scratch[i] == NULL) {
+			graph->scratch[i] = tsp_tour_create(size);
+			tsp_tour_reserve_ids(graph->scratch[i], size);
+		}
+	}
+	tsp_tour_reserve_ids(graph->nodes_active, size);
+	tsp_tour_reserve_ids(graph->nodes_vacant, size);
+	tsp_bitset_resize(graph->active, size);
 }
 
 void tsp_graph_destroy(struct tsp_graph *graph)
 {
-	sp_stack_destroy(graph->nodes_active, NULL);
-	sp_stack_destroy(graph->nodes_vacant, NULL);
-	free(graph->dist_matrix.dist);
-	free(graph->dist_matrix.nodes);
+	tsp_tour_destroy(graph->nodes_active);
+	tsp_tour_destroy(graph->nodes_vacant);
+	tsp_bitset_destroy(graph->active);
+	for (int i = 0; i < 2; i++) {
+		if (graph->scratch[i] != NULL) {
+			tsp_tour_destroy(graph->scratch[i]);
+		}
+	}
+	tsp_dist_matrix_release(graph->dist_matrix);
 	free(graph);
 }
 
@@ -221,7 +268,7 @@ bool tsp_node_eq(struct tsp_node node1, struct tsp_node node2)
 
 /* This function assumes nodes1 and nodes2 represent the same problem instances.
  * i.e. two nodes are considered equal based on their IDs only, for efficiency. */
-bool tsp_nodes_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
+bool tsp_nodes_eq(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2)
 {
 	assert(nodes1 != NULL);
 	assert(nodes2 != NULL);
@@ -234,16 +281,8 @@ bool tsp_nodes_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
 
 	/* Align nodes2 index to the first element in nodes1 */
 	size_t nodes1_idx = 0;
-	size_t nodes2_idx;
-	for (nodes2_idx = 0; nodes2_idx < nodes2->size; nodes2_idx++) {
-		const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes1, nodes1_idx);
-		const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes2, nodes2_idx);
-
-		if (n1.id == n2.id) {
-			break;
-		}
-	}
-	if (nodes2_idx == nodes2->size) {
+	size_t nodes2_idx = tsp_tour_find(nodes2, tsp_tour_get(nodes1, nodes1_idx));
+	if (nodes2_idx == SIZE_MAX) {
 		/* The first node from nodes1 was not present in nodes2 */
 		return false;
 	}
@@ -253,10 +292,7 @@ bool tsp_nodes_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
 		nodes1_idx = (nodes1_idx + 1) % nodes1->size;
 		nodes2_idx = (nodes2_idx + 1) % nodes2->size;
 
-		const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes1, nodes1_idx);
-		const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes2, nodes2_idx);
-
-		if (n1.id != n2.id) {
+		if (tsp_tour_get(nodes1, nodes1_idx) != tsp_tour_get(nodes2, nodes2_idx)) {
 			return false;
 		}
 	}
@@ -264,30 +300,95 @@ bool tsp_nodes_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
 	return true;
 }
 
-void tsp_nodes_print(const struct sp_stack *nodes)
+/* Hash of the edges of a route: the sum of one key per edge. Keys ignore the
+ * direction of an edge and the sum ignores order, so a route hashes the same
+ * from any starting node and in either direction. */
+size_t tsp_nodes_hash(const struct tsp_tour *nodes)
+{
+	if (nodes->size == 0) {
+		return 0;
+	}
+	size_t hash = _edge_key(nodes->ids[0], nodes->ids[nodes->size - 1]);
+	for (size_t i = 0; i + 1 < nodes->size; i++) {
+		hash += _edge_key(nodes->ids[i], nodes->ids[i + 1]);
+	}
+	return hash;
+}
+
+/* Writes a route into ids in a canonical form, the same for every rotation
+ * and direction: it starts from the smallest ID and continues towards the
+ * smaller of its neighbours. */
+void tsp_nodes_canonical(const struct tsp_tour *nodes, tsp_id *ids)
+{
+	const size_t n = nodes->size;
+	if (n == 0) {
+		return;
+	}
+	size_t first = 0;
+	for (size_t i = 1; i < n; i++) {
+		if (tsp_tour_get(nodes, i) < tsp_tour_get(nodes, first)) {
+			first = i;
+		}
+	}
+	const size_t step = tsp_tour_get(nodes, (first + 1) % n) <= tsp_tour_get(nodes, (first + n - 1) % n) ? 1 : n - 1;
+	for (size_t i = 0, idx = first; i < n; i++, idx = (idx + step) % n) {
+		ids[i] = tsp_tour_get(nodes, idx);
+	}
+}
+
+/* Whether two graphs hold the same route, in any rotation or direction.
+ * Routes are compared in full only when their hashes match. */
+bool tsp_graph_eq(const struct tsp_graph *graph1, const struct tsp_graph *graph2)
+{
+	if (tsp_graph_hash(graph1) != tsp_graph_hash(graph2) || graph1->nodes_active->size != graph2->nodes_active->size) {
+		return false;
+	}
+	if (graph1->nodes_active->size == 0) {
+		return true;
+	}
+	return tsp_nodes_eq(graph1->nodes_active, graph2->nodes_active)
+		|| _nodes_eq_reversed(graph1->nodes_active, graph2->nodes_active);
+}
+
+size_t tsp_graph_hash(const struct tsp_graph *graph)
+{
+	#ifdef TSP_TEST_HASH
+	if (graph->hash != tsp_nodes_hash(graph->nodes_active)) {
+		error(("incorrect hash: got %zx, expected %zx", graph->hash, tsp_nodes_hash(graph->nodes_active)));
+	}
+	#endif /* TSP_TEST_HASH */
+	return graph->hash;
+}
+
+void tsp_nodes_print(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix)
 {
 	printf("%zu nodes:\n", nodes->size);
-	sp_stack_print(nodes, _print_node);
-	printf("score: %lu\n", tsp_nodes_evaluate(nodes, NULL));
+	_print_nodes(nodes, matrix);
+	if (nodes->size != 0)
+		printf("score: %lu\n", tsp_nodes_evaluate(nodes, matrix));
 }
 
-void tsp_nodes_print_oneline(const struct sp_stack *nodes)
+/* Prints the IDs the nodes have in the instance file, or the internal ones
+ * if matrix is NULL. */
+void tsp_nodes_print_oneline(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix)
 {
 	if (nodes->size == 0) {
 		printf("<empty>\n");
 		return;
 	}
 	for (size_t i = 0; i < nodes->size - 1; i++) {
-		const struct tsp_node *const node = sp_stack_get(nodes, i);
-		printf("%u → ", node->id);
+		const unsigned id = tsp_tour_get(nodes, i);
+		printf("%u → ", matrix != NULL ? tsp_dist_matrix_orig_id(matrix, id) : id);
 	}
-	printf("%u\n", ((struct tsp_node*)sp_stack_peek(nodes))->id);
+	const unsigned last = tsp_tour_peek(nodes);
+	printf("%u\n", matrix != NULL ? tsp_dist_matrix_orig_id(matrix, last) : last);
 }
 
 void tsp_graph_export(const struct tsp_graph *graph, const char *fpath)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_node *const nodes = graph->dist_matrix->nodes;
 	FILE *const f = fopen(fpath, "w");
 	if (f == NULL) {
 		warn(("tsp_nodes_export: failed to open file %s for writing\n"));
@@ -296,11 +397,11 @@ void tsp_graph_export(const struct tsp_graph *graph, const char *fpath)
 
 	fprintf(f, "%zu;%zu\n", vacant->size, active->size);
 	for (size_t i = vacant->size; i-- > 0;) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, i);
+		const struct tsp_node node = nodes[tsp_tour_get(vacant, i)];
 		fprintf(f, "%d;%d;%d\n", node.x, node.y, node.cost);
 	}
 	for (size_t i = active->size; i-- > 0;) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(active, i);
+		const struct tsp_node node = nodes[tsp_tour_get(active, i)];
 		fprintf(f, "%d;%d;%d\n", node.x, node.y, node.cost);
 	}
 	fclose(f);
@@ -349,19 +450,20 @@ void tsp_graph_to_pdf(const struct tsp_graph *graph, const char *fpath)
 	char tmp_fname[] = ".neato.XXXXXX";
 	const int fd = mkstemp(tmp_fname);
 
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_node *const nodes = graph->dist_matrix->nodes;
 
 	/* Find minimum and maximum node costs */
 	int cost_min = INT_MAX;
 	int cost_max = INT_MIN;
 	for (size_t i = 0; i < vacant->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, i);
+		const struct tsp_node node = nodes[tsp_tour_get(vacant, i)];
 		cost_min = MIN(cost_min, node.cost);
 		cost_max = MAX(cost_max, node.cost);
 	}
 	for (size_t i = 0; i < active->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(active, i);
+		const struct tsp_node node = nodes[tsp_tour_get(active, i)];
 		cost_min = MIN(cost_min, node.cost);
 		cost_max = MAX(cost_max, node.cost);
 	}
@@ -375,7 +477,7 @@ void tsp_graph_to_pdf(const struct tsp_graph *graph, const char *fpath)
 
 	/* Draw vacant nodes */
 	for (size_t i = 0; i < vacant->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, i);
+		const struct tsp_node node = nodes[tsp_tour_get(vacant, i)];
 		const double cost_norm = (double)(node.cost - cost_min) / (cost_max - cost_min);
 		const size_t nbytes = sprintf(
 			buf, graphviz_vacant_node_fmt,
@@ -388,7 +490,7 @@ void tsp_graph_to_pdf(const struct tsp_graph *graph, const char *fpath)
 
 	/* Draw active nodes */
 	for (size_t i = 0; i < active->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(active, i);
+		const struct tsp_node node = nodes[tsp_tour_get(active, i)];
 		const double cost_norm = (double)(node.cost - cost_min) / (cost_max - cost_min);
 		const size_t nbytes = sprintf(
 			buf, graphviz_active_node_fmt,
@@ -428,11 +530,11 @@ void tsp_graph_print(const struct tsp_graph *graph)
 		graph->nodes_active->size,
 		graph->nodes_vacant->size);
 	printf("vacant nodes:\n");
-	sp_stack_print(graph->nodes_vacant, _print_node);
+	_print_nodes(graph->nodes_vacant, graph->dist_matrix);
 	printf("active nodes:\n");
-	sp_stack_print(graph->nodes_active, _print_node);
+	_print_nodes(graph->nodes_active, graph->dist_matrix);
 	if (graph->nodes_active->size != 0)
-		printf("score: %lu\n", tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix));
+		printf("score: %lu\n", tsp_nodes_evaluate(graph->nodes_active, graph->dist_matrix));
 }
 
 int _print_node(const void *ptr)
@@ -442,101 +544,134 @@ int _print_node(const void *ptr)
 	return 0;
 }
 
-unsigned long tsp_nodes_evaluate(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix)
+void _print_nodes(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix)
+{
+	for (size_t i = 0; i < nodes->size; i++) {
+		_print_node(&matrix->nodes[tsp_tour_get(nodes, i)]);
+	}
+}
+
+unsigned long tsp_nodes_evaluate(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix)
 {
 	assert(nodes->size != 0);
-	struct tsp_node prev_node = *(struct tsp_node*)sp_stack_peek(nodes);
-	unsigned long score = prev_node.cost;
-	for (size_t i = 1; i < nodes->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes, i);
-		score += node.cost + mdist(node.id, prev_node.id, matrix);
-		prev_node = node;
+	const tsp_id *const ids = nodes->ids;
+	if (matrix->weights != NULL) {
+		unsigned long weight = mweight(ids[0], ids[nodes->size - 1], matrix);
+		for (size_t i = 0; i + 1 < nodes->size; i++) {
+			weight += mweight(ids[i], ids[i + 1], matrix);
+		}
+		return weight / 2;
+	}
+	/* Index i is at ids[size - 1 - i], so the route is walked backwards in memory */
+	unsigned prev_id = ids[nodes->size - 1];
+	unsigned long score = mcost(prev_id, matrix);
+	for (size_t i = nodes->size - 1; i-- > 0;) {
+		const unsigned id = ids[i];
+		score += mcost(id, matrix) + mdist(id, prev_id, matrix);
+		prev_id = id;
+	}
+	return score + mdist(ids[0], ids[nodes->size - 1], matrix);
+}
+
+/* Scores of many tours at once, each the same as tsp_nodes_evaluate of it.
+ * Matrices with plain rows are read for several tours at a time, so that
+ * their lookups overlap (see tsp_cycles_sum). */
+void tsp_tours_evaluate_batch(const struct tsp_tour *const *tours, size_t n_tours, const struct tsp_dist_matrix *matrix, unsigned long *scores)
+{
+	if (matrix->storage == TSP_DIST_DENSE) {
+		tsp_cycles_sum(tours, n_tours, matrix->dist, matrix->size, matrix->costs, scores);
+	} else {
+		for (size_t i = 0; i < n_tours; i++) {
+			scores[i] = tsp_nodes_evaluate(tours[i], matrix);
+		}
 	}
 
-	const struct tsp_node first_node = *(struct tsp_node*)sp_stack_peek(nodes);
-	const struct tsp_node last_node = *(struct tsp_node*)sp_stack_get(nodes, nodes->size - 1);
-	return score + mdist(last_node.id, first_node.id, matrix);
+	#ifdef TSP_TEST_EVAL
+	for (size_t i = 0; i < n_tours; i++) {
+		if (scores[i] != tsp_nodes_evaluate(tours[i], matrix)) {
+			error(("incorrect score of tour %zu: got %lu, expected %lu", i, scores[i], tsp_nodes_evaluate(tours[i], matrix)));
+		}
+	}
+	#endif /* TSP_TEST_EVAL */
 }
 
 /* Returns the difference in graph score, if a given move was made  */
 long tsp_graph_evaluate_move(const struct tsp_graph *graph, struct tsp_move move)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
 	assert(move.dest < active->size);
-	const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, move.src);
-	const struct tsp_node prev_node = *(struct tsp_node*)sp_stack_get(active, move.dest % active->size);
-	const struct tsp_node next_node = *(struct tsp_node*)sp_stack_get(active, (move.dest + active->size - 1) % active->size);
+	const unsigned id = tsp_tour_get(vacant, move.src);
+	const unsigned prev_id = tsp_tour_get(active, move.dest % active->size);
+	const unsigned next_id = tsp_tour_get(active, (move.dest + active->size - 1) % active->size);
+	if (graph->dist_matrix->weights != NULL) {
+		return (
+			- (long)mweight(prev_id, next_id, graph->dist_matrix)
+			+ (long)mweight(id, prev_id, graph->dist_matrix)
+			+ (long)mweight(id, next_id, graph->dist_matrix)
+		) / 2;
+	}
 	return
-		- mdist(prev_node.id, next_node.id, &graph->dist_matrix)
-		+ mdist(node.id, prev_node.id, &graph->dist_matrix)
-		+ mdist(node.id, next_node.id, &graph->dist_matrix)
-		+ node.cost;
+		- mdist(prev_id, next_id, graph->dist_matrix)
+		+ mdist(id, prev_id, graph->dist_matrix)
+		+ mdist(id, next_id, graph->dist_matrix)
+		+ mcost(id, graph->dist_matrix);
 }
 
 /* Deactivates all nodes in a graph. */
 void tsp_graph_deactivate_all(struct tsp_graph *graph)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_tour *const active = graph->nodes_active;
 
 	while (active->size != 0) {
-		struct tsp_node node;
-		node = *(struct tsp_node*)sp_stack_peek(active);
-		sp_stack_pop(active, NULL);
-		sp_stack_push(vacant, &node);
+		tsp_tour_push(vacant, tsp_tour_pop(active));
 	}
+	tsp_bitset_clear(graph->active);
+	graph->score = 0;
+	graph->hash = 0;
 }
 
 /* Activates a single node in a graph. */
 void tsp_graph_activate_node(struct tsp_graph *graph, size_t idx)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
-
-	const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, idx);
-	sp_stack_qremove(vacant, idx, NULL);
-	sp_stack_push(active, &node);
+	const unsigned id = tsp_tour_get(graph->nodes_vacant, idx);
+	const long delta = _insert_delta(graph, id, 0);
+	const size_t hash_delta = _insert_hash_delta(graph, id, 0);
+	tsp_tour_push(graph->nodes_active, tsp_tour_qremove(graph->nodes_vacant, idx));
+	tsp_bitset_set(graph->active, id);
+	_update_score(graph, delta);
+	_update_hash(graph, hash_delta);
 }
 
-/* Activates a single node in a graph, by node ID (requires linear search). */
+/* Activates a single node in a graph, by node ID. */
 void tsp_graph_activate_node_by_id(struct tsp_graph *graph, unsigned node_id)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
-
-	size_t idx = 0;
-	struct tsp_node node;
-	for (; idx < vacant->size; idx++) {
-		node = *(struct tsp_node*)sp_stack_get(vacant, idx);
-		if (node.id == node_id) {
-			break;
-		}
-	}
-	if (idx == vacant->size) {
+	const size_t idx = tsp_tour_find(graph->nodes_vacant, node_id);
+	if (idx == SIZE_MAX) {
 		warn(("No such vacant node in the graph: %u", node_id));
 		return;
 	}
 
-	sp_stack_qremove(vacant, idx, NULL);
-	sp_stack_push(active, &node);
+	tsp_graph_activate_node(graph, idx);
 }
 
 /* Deactivates a single node in a graph. */
 void tsp_graph_deactivate_node(struct tsp_graph *graph, size_t idx)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
-
-	const struct tsp_node node = *(struct tsp_node*)sp_stack_get(active, idx);
-	sp_stack_remove(active, idx, NULL);
-	sp_stack_push(vacant, &node);
+	const long delta = _remove_delta(graph, idx);
+	const size_t hash_delta = _remove_hash_delta(graph, idx);
+	const unsigned id = tsp_tour_remove(graph->nodes_active, idx);
+	tsp_tour_push(graph->nodes_vacant, id);
+	tsp_bitset_unset(graph->active, id);
+	_update_score(graph, delta);
+	_update_hash(graph, hash_delta);
 }
 
 /* Activates `n_nodes` random nodes in graph. */
 void tsp_graph_activate_random(struct tsp_graph *graph, size_t n_nodes)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
 
 	if (vacant->size < n_nodes) {
 		warn(("tsp_graph_activate_function: not enough vacant nodes, truncating"));
@@ -550,7 +685,7 @@ void tsp_graph_activate_random(struct tsp_graph *graph, size_t n_nodes)
 /* Deactivates `n_nodes` random nodes in graph. */
 void tsp_graph_deactivate_random(struct tsp_graph *graph, size_t n_nodes)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	if (active->size < n_nodes) {
 		warn(("tsp_graph_activate_function: not enough active nodes, truncating"));
@@ -561,13 +696,18 @@ void tsp_graph_deactivate_random(struct tsp_graph *graph, size_t n_nodes)
 	}
 }
 
-size_t tsp_nodes_find_nn(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, struct tsp_node node)
+size_t tsp_nodes_find_nn(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, unsigned id)
 {
 	size_t ret = 0;
 	double lowest_delta = DBL_MAX;
+	if (matrix->storage == TSP_DIST_DENSE && nodes->size != 0) {
+		const struct tsp_scan scan = { nodes->ids, nodes->size, matrix->dist + id * matrix->size, NULL, matrix->costs, 1 };
+		long lowest;
+		return nodes->size - 1 - tsp_scan_argmin(&scan, &lowest);
+	}
 	for (size_t i = 0; i < nodes->size; i++) {
-		const struct tsp_node node2 = *(struct tsp_node*)sp_stack_get(nodes, i);
-		const double delta = mdist(node.id, node2.id, matrix) + node2.cost;
+		const unsigned id2 = tsp_tour_get(nodes, i);
+		const double delta = mdist(id, id2, matrix) + mcost(id2, matrix);
 		if (delta < lowest_delta) {
 			ret = i;
 			lowest_delta = delta;
@@ -576,16 +716,24 @@ size_t tsp_nodes_find_nn(const struct sp_stack *nodes, const struct tsp_dist_mat
 	return ret;
 }
 
-size_t tsp_nodes_find_2nn(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, struct tsp_node node1, struct tsp_node node2)
+size_t tsp_nodes_find_2nn(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, unsigned id1, unsigned id2)
 {
 	size_t ret = 0;
 	double lowest_delta = DBL_MAX;
+	if (nodes->size != 0 && matrix->storage == TSP_DIST_DENSE) {
+		/* Scan the columns of id1 and id2, as the distances are from the scanned nodes */
+		const bool folded = matrix->weights != NULL;
+		const unsigned *const cols = folded ? matrix->weights : matrix->dist;
+		const struct tsp_scan scan = { nodes->ids, nodes->size, cols + id1, cols + id2, folded ? NULL : matrix->costs, matrix->size };
+		long lowest;
+		return nodes->size - 1 - tsp_scan_argmin(&scan, &lowest);
+	}
 	for (size_t i = 0; i < nodes->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes, i);
+		const unsigned id = tsp_tour_get(nodes, i);
 		const double delta =
-			+ mdist(node.id, node1.id, matrix)
-			+ mdist(node.id, node2.id, matrix)
-			+ node.cost;
+			+ mdist(id, id1, matrix)
+			+ mdist(id, id2, matrix)
+			+ mcost(id, matrix);
 		if (delta < lowest_delta) {
 			ret = i;
 			lowest_delta = delta;
@@ -598,53 +746,43 @@ size_t tsp_nodes_find_2nn(const struct sp_stack *nodes, const struct tsp_dist_ma
 struct tsp_move tsp_graph_find_nc(const struct tsp_graph *graph)
 {
 	struct tsp_move ret = { SIZE_MAX, SIZE_MAX };
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
 	assert(active->size >= 2);
-	struct tsp_node prev_node = *(struct tsp_node*)sp_stack_peek(active);
+	unsigned prev_id = tsp_tour_peek(active);
 
 	double lowest_delta = DBL_MAX;
 	for (size_t i = 1; i < active->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(active, i);
-		struct tsp_node nn_node;
+		const unsigned id = tsp_tour_get(active, i);
 		size_t nn_node_idx;
 
 		/* Find nearest neighbor to the two adjacent nodes in the cycle */
-		nn_node_idx = tsp_nodes_find_2nn(vacant, &graph->dist_matrix, prev_node, node);
-		nn_node = *(struct tsp_node*)sp_stack_get(vacant, nn_node_idx);
+		nn_node_idx = tsp_nodes_find_2nn(vacant, graph->dist_matrix, prev_id, id);
 
 		/* Calculate difference in score if the considered vacant node
 		 * was inserted between the 2 closest nodes */
-		const double delta =
-			- mdist(node.id, prev_node.id, &graph->dist_matrix)
-			+ mdist(nn_node.id, node.id, &graph->dist_matrix)
-			+ mdist(nn_node.id, prev_node.id, &graph->dist_matrix)
-			+ nn_node.cost;
+		const struct tsp_move move = { nn_node_idx, i };
+		const double delta = tsp_graph_evaluate_move(graph, move);
 		if (delta < lowest_delta) {
 			ret.src = nn_node_idx;
 			ret.dest = i;
 			lowest_delta = delta;
 		}
-		prev_node = node;
+		prev_id = id;
 	}
 
 	/* Consider the last edge from first to last node */
-	const struct tsp_node first_node = *(struct tsp_node*)sp_stack_peek(active);
-	const struct tsp_node last_node = *(struct tsp_node*)sp_stack_get(active, active->size - 1);
-	struct tsp_node nn_node;
+	const unsigned first_id = tsp_tour_peek(active);
+	const unsigned last_id = tsp_tour_get(active, active->size - 1);
 	size_t nn_node_idx;
 
 	/* Find nearest neighbor to the two adjacent nodes in the cycle */
-	nn_node_idx = tsp_nodes_find_2nn(vacant, &graph->dist_matrix, first_node, last_node);
-	nn_node = *(struct tsp_node*)sp_stack_get(vacant, nn_node_idx);
+	nn_node_idx = tsp_nodes_find_2nn(vacant, graph->dist_matrix, first_id, last_id);
 
 	/* Calculate difference in score if the considered vacant node
 	 * was inserted between the 2 closest nodes */
-	const double delta =
-		- mdist(first_node.id, last_node.id, &graph->dist_matrix)
-		+ mdist(nn_node.id, first_node.id, &graph->dist_matrix)
-		+ mdist(nn_node.id, last_node.id, &graph->dist_matrix)
-		+ nn_node.cost;
+	const struct tsp_move move = { nn_node_idx, 0 };
+	const double delta = tsp_graph_evaluate_move(graph, move);
 	if (delta < lowest_delta) {
 		ret.src = nn_node_idx;
 		ret.dest = 0;
@@ -659,16 +797,16 @@ struct tsp_move tsp_graph_find_nc(const struct tsp_graph *graph)
  * p    - proportional sample size (0.0 == random, 1.0 == greedy) */
 struct sp_stack *tsp_graph_find_rcl(const struct tsp_graph *graph, size_t size, double p)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
 	assert(size <= vacant->size);
 	assert(p >= 0.0 && p <= 1.0);
 
 	/* This function is a performance mess. It uses a copy of vacant nodes
 	 * for in-place shuffling, relies on node indices, but at the end the
 	 * indices are out-of-sync with the original vacant nodes, so we also
-	 * need to store copies of node IDs and find their "real" vacant indices
-	 * afterwards. Yikes. */
+	 * need to store copies of node IDs and look up their "real" vacant
+	 * indices afterwards. Yikes. */
 	struct node_move {
 		unsigned node_id;      /* ID of the node, for finding the "real" vacant indices after */
 		struct tsp_move move;  /* Move from vacant_copy to graph */
@@ -677,10 +815,14 @@ struct sp_stack *tsp_graph_find_rcl(const struct tsp_graph *graph, size_t size,
 	struct sp_stack *const rcl = sp_stack_create(sizeof(struct node_move), size);
 	struct tsp_graph graph_copy;
 	graph_copy.nodes_active = graph->nodes_active;
-	graph_copy.nodes_vacant = sp_stack_create(vacant->elem_size, vacant->size);
+	graph_copy.active = graph->active;
+	graph_copy.nodes_vacant = tsp_tour_create(vacant->size);
 	graph_copy.dist_matrix = graph->dist_matrix;
-	struct sp_stack *const vacant_copy = graph_copy.nodes_vacant;
-	sp_stack_copy(vacant_copy, vacant, NULL);
+	graph_copy.score = graph->score;
+	graph_copy.hash = graph->hash;
+	graph_copy.scratch[0] = graph_copy.scratch[1] = NULL;
+	struct tsp_tour *const vacant_copy = graph_copy.nodes_vacant;
+	tsp_tour_copy(vacant_copy, vacant);
 
 	while (rcl->size < size) {
 		struct node_move nm;
@@ -688,50 +830,43 @@ struct sp_stack *tsp_graph_find_rcl(const struct tsp_graph *graph, size_t size,
 		const size_t vacant_copy_true_size = vacant_copy->size;
 
 		/* Find the best node to add to graph from a pool_size random sample */
-		tail_shuffle(vacant_copy->data, vacant_copy->elem_size, vacant_copy->size, pool_size);
+		tsp_tour_shuffle_top(vacant_copy, pool_size);
 
-		/* Dirty hack - pretend the stack is smaller to only choose from the pool segment */
-		vacant_copy->data = ((char*)vacant_copy->data) + (vacant_copy->size - pool_size) * vacant_copy->elem_size;
+		/* Dirty hack - pretend the tour is smaller to only choose from the pool segment */
+		vacant_copy->ids += vacant_copy->size - pool_size;
 		vacant_copy->size = pool_size;
 
 		if (active->size == 0) {
 			nm.move.src = randint(0, vacant_copy->size - 1);
 			nm.move.dest = 0;
 		} else if (active->size == 1) {
-			const struct tsp_node node = *(struct tsp_node*)sp_stack_peek(active);
-			nm.move.src = tsp_nodes_find_nn(vacant_copy, &graph_copy.dist_matrix, node);
+			nm.move.src = tsp_nodes_find_nn(vacant_copy, graph_copy.dist_matrix, tsp_tour_peek(active));
 			nm.move.dest = 1;
 		} else {
 			const struct tsp_move best_move = tsp_graph_find_nc(&graph_copy);
 			nm.move = best_move;
 		}
-		nm.node_id = ((struct tsp_node*)sp_stack_get(vacant_copy, nm.move.src))->id;
+		nm.node_id = tsp_tour_get(vacant_copy, nm.move.src);
 
 		/* Revert the dirty hack */
 		vacant_copy->size = vacant_copy_true_size;
-		vacant_copy->data = ((char*)vacant_copy->data) - (vacant_copy->size - pool_size) * vacant_copy->elem_size;
+		vacant_copy->ids -= vacant_copy->size - pool_size;
 
 		/* Remove the best node from future candidates */
-		sp_stack_qremove(vacant_copy, nm.move.src, NULL);
+		tsp_tour_qremove(vacant_copy, nm.move.src);
 
 		/* Add the move that activates the best node to the RCL */
 		sp_stack_push(rcl, &nm);
 	}
-	sp_stack_destroy(vacant_copy, NULL);
+	tsp_tour_destroy(vacant_copy);
 
 	/* Map rcl elements back to original graph's vacant indices */
 	struct sp_stack *const moves = sp_stack_create(sizeof(struct tsp_move), rcl->size);
-	size_t *const map = malloc_or_die((TSP_MAX_NODE_ID + 1) * sizeof(size_t));
-	for (size_t i = 0; i < vacant->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(vacant, i);
-		map[node.id] = i;
-	}
 	for (size_t i = 0; i < rcl->size; i++) {
 		const struct node_move nm = *(struct node_move*)sp_stack_get(rcl, i);
-		const struct tsp_move move = { map[nm.node_id], nm.move.dest };
+		const struct tsp_move move = { tsp_tour_find(vacant, nm.node_id), nm.move.dest };
 		sp_stack_push(moves, &move);
 	}
-	free(map);
 
 	sp_stack_destroy(rcl, NULL);
 	return moves;
@@ -739,7 +874,7 @@ struct sp_stack *tsp_graph_find_rcl(const struct tsp_graph *graph, size_t size,
 
 unsigned long tsp_graph_compute_2regret(const struct tsp_graph *graph, size_t vacant_idx)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 	long max_deltas[2];
 	assert(active->size >= 2);
 
@@ -808,88 +943,119 @@ struct tsp_move tsp_graph_find_wsc(const struct tsp_graph *graph, const struct s
 	return best_move;
 }
 
-void tsp_graph_inter_swap(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx)
+/* Objective value of the route, in constant time. Every tsp_graph_* move
+ * updates it by its delta, but moves applied to the tours directly do not. */
+unsigned long tsp_graph_score(const struct tsp_graph *graph)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	#ifdef TSP_TEST_SCORE
+	if (graph->nodes_active->size != 0 && graph->score != tsp_nodes_evaluate(graph->nodes_active, graph->dist_matrix)) {
+		error(("incorrect score: got %lu, expected %lu", graph->score, tsp_nodes_evaluate(graph->nodes_active, graph->dist_matrix)));
+	}
+	#endif /* TSP_TEST_SCORE */
+	return graph->score;
+}
 
-	assert(active->elem_size <= 64);
-	assert(active->elem_size == vacant->elem_size);
-	assert(sizeof(size_t) <= 64);
-	static char tmp[64];  /* Aux buffer for swaps */
+/* Moves the vacant node at index move.src into the route, at index move.dest */
+void tsp_graph_insert(struct tsp_graph *graph, struct tsp_move move)
+{
+	const unsigned id = tsp_tour_get(graph->nodes_vacant, move.src);
+	const long delta = _insert_delta(graph, id, move.dest);
+	const size_t hash_delta = _insert_hash_delta(graph, id, move.dest);
+	tsp_tour_insert(graph->nodes_active, move.dest, tsp_tour_remove(graph->nodes_vacant, move.src));
+	tsp_bitset_set(graph->active, id);
+	_update_score(graph, delta);
+	_update_hash(graph, hash_delta);
+}
 
-	void *const n1 = sp_stack_get(vacant, vacant_idx);
-	void *const n2 = sp_stack_get(active, active_idx);
-	memcpy(tmp, n1, vacant->elem_size);
-	memcpy(n1, n2, vacant->elem_size);
-	memcpy(n2, tmp, vacant->elem_size);
+void tsp_graph_inter_swap(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx)
+{
+	const long delta = tsp_graph_evaluate_inter_swap(graph, active_idx, vacant_idx);
+	const size_t n = graph->nodes_active->size;
+	const size_t starts[] = { (active_idx + n - 1) % n, active_idx };
+	const size_t hash_before = _edges_hash(graph->nodes_active, starts, ARRLEN(starts));
+	_swap_active_vacant(graph, active_idx, vacant_idx);
+	_update_score(graph, delta);
+	_update_hash(graph, _edges_hash(graph->nodes_active, starts, ARRLEN(starts)) - hash_before);
 }
 
-void tsp_nodes_swap_nodes(struct sp_stack *nodes, size_t idx1, size_t idx2)
+void tsp_graph_swap_nodes(struct tsp_graph *graph, size_t idx1, size_t idx2)
 {
-	assert(nodes->elem_size <= 64);
-	assert(sizeof(size_t) <= 64);
-	static char tmp[64];  /* Aux buffer for swaps */
-	if (idx1 == idx2)
-		return;
+	const long delta = tsp_nodes_evaluate_swap_nodes(graph->nodes_active, graph->dist_matrix, idx1, idx2);
+	const size_t n = graph->nodes_active->size;
+	const size_t starts[] = { (idx1 + n - 1) % n, idx1, (idx2 + n - 1) % n, idx2 };
+	const size_t hash_before = _edges_hash(graph->nodes_active, starts, ARRLEN(starts));
+	tsp_nodes_swap_nodes(graph->nodes_active, idx1, idx2);
+	_update_score(graph, delta);
+	_update_hash(graph, _edges_hash(graph->nodes_active, starts, ARRLEN(starts)) - hash_before);
+}
 
-	void *const n1 = sp_stack_get(nodes, idx1);
-	void *const n2 = sp_stack_get(nodes, idx2);
-	memcpy(tmp, n1, nodes->elem_size);
-	memcpy(n1, n2, nodes->elem_size);
-	memcpy(n2, tmp, nodes->elem_size);
+void tsp_graph_swap_edges(struct tsp_graph *graph, size_t idx1, size_t idx2)
+{
+	const long delta = tsp_nodes_evaluate_swap_edges(graph->nodes_active, graph->dist_matrix, idx1, idx2);
+	/* Only the edges around the reversed range change, keys ignore direction */
+	const size_t n = graph->nodes_active->size;
+	const size_t starts[] = { (MIN(idx1, idx2) + n - 1) % n, MAX(idx1, idx2) };
+	const size_t hash_before = _edges_hash(graph->nodes_active, starts, ARRLEN(starts));
+	tsp_nodes_swap_edges(graph->nodes_active, idx1, idx2);
+	_update_score(graph, delta);
+	_update_hash(graph, _edges_hash(graph->nodes_active, starts, ARRLEN(starts)) - hash_before);
 }
 
-void tsp_nodes_swap_edges(struct sp_stack *nodes, size_t idx1, size_t idx2)
+void tsp_nodes_swap_nodes(struct tsp_tour *nodes, size_t idx1, size_t idx2)
 {
-	assert(nodes->elem_size <= 64);
-	assert(sizeof(size_t) <= 64);
-	static char tmp[64];  /* Aux buffer for swaps */
+	const unsigned id1 = tsp_tour_get(nodes, idx1);
+	tsp_tour_set(nodes, idx1, tsp_tour_get(nodes, idx2));
+	tsp_tour_set(nodes, idx2, id1);
+}
 
+void tsp_nodes_swap_edges(struct tsp_tour *nodes, size_t idx1, size_t idx2)
+{
 	/* Make sure idx1 < idx2 */
 	if (idx1 > idx2) {
-		*(size_t*)tmp = idx1;
+		const size_t tmp = idx1;
 		idx1 = idx2;
-		idx2 = *(size_t*)tmp;
+		idx2 = tmp;
 	}
 
-	for (size_t i = 0; i < (idx2 - idx1 + 1) / 2; i++) {
-		tsp_nodes_swap_nodes(
-			nodes,
-			(idx1 + i) % nodes->size,
-			(idx2 + nodes->size - i) % nodes->size
-		);
-	}
+	tsp_tour_reverse(nodes, idx1, idx2);
 }
 
 long tsp_graph_evaluate_inter_swap(const struct tsp_graph *graph, size_t active_idx, size_t vacant_idx)
 {
 	#ifdef TSP_TEST_EVAL
-	const unsigned long score_before = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+	const unsigned long score_before = tsp_nodes_evaluate(graph->nodes_active, graph->dist_matrix);
 	#endif /* TSP_TEST_EVAL */
 
-	const struct sp_stack *const vacant = graph->nodes_vacant;
-	const struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
 
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(vacant, vacant_idx);
-	const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(active, active_idx);
+	const unsigned n1 = tsp_tour_get(vacant, vacant_idx);
+	const unsigned n2 = tsp_tour_get(active, active_idx);
 	const size_t n2_prev_idx = (active_idx + active->size - 1) % active->size;
 	const size_t n2_next_idx = (active_idx + 1) % active->size;
-	const struct tsp_node n2_prev = *(struct tsp_node*)sp_stack_get(active, n2_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(active, n2_next_idx);
-	const long delta =
-		- mdist(n2.id, n2_prev.id, &graph->dist_matrix)
-		- mdist(n2.id, n2_next.id, &graph->dist_matrix)
-		- n2.cost
-		+ mdist(n1.id, n2_prev.id, &graph->dist_matrix)
-		+ mdist(n1.id, n2_next.id, &graph->dist_matrix)
-		+ n1.cost;
+	const unsigned n2_prev = tsp_tour_get(active, n2_prev_idx);
+	const unsigned n2_next = tsp_tour_get(active, n2_next_idx);
+	long delta;
+	if (matrix->weights != NULL) {
+		/* The costs of n2_prev and n2_next cancel out */
+		delta = (
+			- (long)mweight(n2, n2_prev, matrix)
+			- (long)mweight(n2, n2_next, matrix)
+			+ (long)mweight(n1, n2_prev, matrix)
+			+ (long)mweight(n1, n2_next, matrix)
+		) / 2;
+	} else {
+		struct tsp_eval eval;
+		tsp_eval_init(&eval, matrix);
+		delta = tsp_eval_inter_swap(&eval, active, vacant, active_idx, vacant_idx);
+	}
 
 	#ifdef TSP_TEST_EVAL
 	struct tsp_graph *const debug_graph = tsp_graph_empty();
 	tsp_graph_copy(debug_graph, graph);
-	tsp_graph_inter_swap(debug_graph, active_idx, vacant_idx);
-	const unsigned long score_after = tsp_nodes_evaluate(debug_graph->nodes_active, &debug_graph->dist_matrix);
+	_swap_active_vacant(debug_graph, active_idx, vacant_idx);
+	const unsigned long score_after = tsp_nodes_evaluate(debug_graph->nodes_active, debug_graph->dist_matrix);
 	const long target_delta = score_after - score_before;
 	if (delta != target_delta) {
 		error(("incorrect delta: got %ld, expected %ld", delta, target_delta));
@@ -900,87 +1066,213 @@ long tsp_graph_evaluate_inter_swap(const struct tsp_graph *graph, size_t active_
 	return delta;
 }
 
-long tsp_nodes_evaluate_swap_nodes(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
+/* Best swap of the active node at active_idx with any vacant node: returns its
+ * delta and stores the vacant index in *vacant_idx, the lowest one of equal
+ * deltas. Requires a vacant node. */
+long tsp_graph_find_best_inter_swap(const struct tsp_graph *graph, size_t active_idx, size_t *vacant_idx)
+{
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
+	assert(vacant->size != 0);
+
+	if (matrix->storage != TSP_DIST_DENSE) {
+		long ret = LONG_MAX;
+		for (size_t j = 0; j < vacant->size; j++) {
+			const long delta = tsp_graph_evaluate_inter_swap(graph, active_idx, j);
+			if (delta < ret) {
+				ret = delta;
+				*vacant_idx = j;
+			}
+		}
+		return ret;
+	}
+
+	/* The vacant node goes between n2_prev and n2_next, see tsp_graph_evaluate_inter_swap */
+	const unsigned n2 = tsp_tour_get(active, active_idx);
+	const unsigned n2_prev = tsp_tour_get(active, (active_idx + active->size - 1) % active->size);
+	const unsigned n2_next = tsp_tour_get(active, (active_idx + 1) % active->size);
+	const bool folded = matrix->weights != NULL;
+	const unsigned *const cols = folded ? matrix->weights : matrix->dist;
+	const struct tsp_scan scan = { vacant->ids, vacant->size, cols + n2_prev, cols + n2_next, folded ? NULL : matrix->costs, matrix->size };
+	long added;
+	*vacant_idx = vacant->size - 1 - tsp_scan_argmin(&scan, &added);
+
+	long ret;
+	if (folded) {
+		ret = (added - (long)mweight(n2, n2_prev, matrix) - (long)mweight(n2, n2_next, matrix)) / 2;
+	} else {
+		ret = added - (long)mdist(n2, n2_prev, matrix) - (long)mdist(n2, n2_next, matrix) - mcost(n2, matrix);
+	}
+
+	#ifdef TSP_TEST_EVAL
+	const long target_delta = tsp_graph_evaluate_inter_swap(graph, active_idx, *vacant_idx);
+	if (ret != target_delta) {
+		error(("incorrect delta: got %ld, expected %ld", ret, target_delta));
+	}
+	#endif /* TSP_TEST_EVAL */
+
+	return ret;
+}
+
+long tsp_nodes_evaluate_swap_nodes(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
 {
 	#ifdef TSP_TEST_EVAL
 	const unsigned long score_before = tsp_nodes_evaluate(nodes, matrix);
 	#endif /* TSP_TEST_EVAL */
 
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes, idx1);
-	const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes, idx2);
-	const size_t n1_prev_idx = (idx1 + nodes->size - 1) % nodes->size;
-	const size_t n1_next_idx = (idx1 + 1) % nodes->size;
-	const size_t n2_prev_idx = (idx2 + nodes->size - 1) % nodes->size;
-	const size_t n2_next_idx = (idx2 + 1) % nodes->size;
-	const struct tsp_node n1_prev = *(struct tsp_node*)sp_stack_get(nodes, n1_prev_idx);
-	const struct tsp_node n1_next = *(struct tsp_node*)sp_stack_get(nodes, n1_next_idx);
-	const struct tsp_node n2_prev = *(struct tsp_node*)sp_stack_get(nodes, n2_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(nodes, n2_next_idx);
-	const long delta =
-		- mdist(n1.id, n1_prev.id, matrix)
-		- mdist(n1.id, n1_next.id, matrix)
-		- mdist(n2.id, n2_prev.id, matrix)
-		- mdist(n2.id, n2_next.id, matrix)
-		+ mdist(n2.id, (n1_prev.id != n2.id ? n1_prev : n1).id, matrix)
-		+ mdist(n2.id, (n1_next.id != n2.id ? n1_next : n1).id, matrix)
-		+ mdist(n1.id, (n2_prev.id != n1.id ? n2_prev : n2).id, matrix)
-		+ mdist(n1.id, (n2_next.id != n1.id ? n2_next : n2).id, matrix);
+	struct tsp_eval eval;
+	tsp_eval_init(&eval, matrix);
+	const long delta = tsp_eval_swap_nodes(&eval, nodes, idx1, idx2);
 
 	#ifdef TSP_TEST_EVAL
-	struct sp_stack *const debug_nodes = sp_stack_create(sizeof(struct tsp_node), nodes->size);
-	sp_stack_copy(debug_nodes, nodes, NULL);
+	struct tsp_tour *const debug_nodes = tsp_tour_create(nodes->size);
+	tsp_tour_copy(debug_nodes, nodes);
 	tsp_nodes_swap_nodes(debug_nodes, idx1, idx2);
 	const unsigned long score_after = tsp_nodes_evaluate(debug_nodes, matrix);
 	const long target_delta = score_after - score_before;
 	if (delta != target_delta) {
 		error(("incorrect delta: got %ld, expected %ld", delta, target_delta));
 	}
-	sp_stack_destroy(debug_nodes, NULL);
+	tsp_tour_destroy(debug_nodes);
 	#endif /* TSP_TEST_EVAL */
 
 	return delta;
 }
 
-long tsp_nodes_evaluate_swap_edges(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
+long tsp_nodes_evaluate_swap_edges(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
 {
 	#ifdef TSP_TEST_EVAL
 	const unsigned long score_before = tsp_nodes_evaluate(nodes, matrix);
 	#endif /* TSP_TEST_EVAL */
 
-	/* Make sure idx1 < idx2 */
-	if (idx1 > idx2) {
-		const size_t tmp = idx1;
-		idx1 = idx2;
-		idx2 = tmp;
-	}
-
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes, idx1);
-	const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes, idx2);
-	const size_t n1_prev_idx = (idx1 + nodes->size - 1) % nodes->size;
-	const size_t n2_next_idx = (idx2 + 1) % nodes->size;
-	const struct tsp_node n1_prev = *(struct tsp_node*)sp_stack_get(nodes, n1_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(nodes, n2_next_idx);
-	const long delta =
-		- mdist(n1.id, n1_prev.id, matrix)
-		- mdist(n2.id, n2_next.id, matrix)
-		+ mdist(n1.id, (n2_next.id != n1.id ? n2_next : n2).id, matrix)
-		+ mdist(n2.id, (n1_prev.id != n2.id ? n1_prev : n1).id, matrix);
+	struct tsp_eval eval;
+	tsp_eval_init(&eval, matrix);
+	const long delta = tsp_eval_swap_edges(&eval, nodes, idx1, idx2);
 
 	#ifdef TSP_TEST_EVAL
-	struct sp_stack *const debug_nodes = sp_stack_create(sizeof(struct tsp_node), nodes->size);
-	sp_stack_copy(debug_nodes, nodes, NULL);
+	struct tsp_tour *const debug_nodes = tsp_tour_create(nodes->size);
+	tsp_tour_copy(debug_nodes, nodes);
 	tsp_nodes_swap_edges(debug_nodes, idx1, idx2);
 	const unsigned long score_after = tsp_nodes_evaluate(debug_nodes, matrix);
 	const long target_delta = score_after - score_before;
 	if (delta != target_delta) {
 		error(("incorrect delta: got %ld, expected %ld", delta, target_delta));
 	}
-	sp_stack_destroy(debug_nodes, NULL);
+	tsp_tour_destroy(debug_nodes);
 	#endif /* TSP_TEST_EVAL */
 
 	return delta;
 }
 
+struct tsp_intra_rows *tsp_intra_rows_create(size_t capacity)
+{
+	struct tsp_intra_rows *const ret = malloc_or_die(sizeof(struct tsp_intra_rows));
+	ret->ids = malloc_or_die((capacity + 1) * sizeof(uint32_t));
+	ret->succ = malloc_or_die((capacity + 1) * sizeof(int64_t));
+	ret->nodes = NULL;
+	ret->matrix = NULL;
+	ret->size = 0;
+	ret->capacity = capacity;
+	ret->vectorized = false;
+	return ret;
+}
+
+/* Lays out a route for tsp_intra_rows_find_best. Every move on the route
+ * invalidates the layout, so it has to be loaded again after each one. */
+void tsp_intra_rows_load(struct tsp_intra_rows *rows, const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix)
+{
+	assert(nodes->size <= rows->capacity);
+	rows->nodes = nodes;
+	rows->matrix = matrix;
+	rows->size = nodes->size;
+	rows->vectorized = matrix->storage == TSP_DIST_DENSE;
+	if (!rows->vectorized || nodes->size == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < nodes->size; i++) {
+		rows->ids[i] = tsp_tour_get(nodes, i);
+	}
+	rows->ids[nodes->size] = rows->ids[0];
+	for (size_t i = 0; i < nodes->size; i++) {
+		rows->succ[i] = mdist(rows->ids[i], rows->ids[i + 1], matrix);
+	}
+}
+
+/* Best intra-route move of the node at index idx with a node at the same or
+ * a higher index: returns its delta, stores the other index in *dest_idx and
+ * whether it swaps the edges (rather than the nodes) in *edges. This is the
+ * move a scan of tsp_nodes_evaluate_swap_nodes and then
+ * tsp_nodes_evaluate_swap_edges for every such index in turn would keep: of
+ * equal deltas the lowest index wins, and at the same index the node swap. */
+long tsp_intra_rows_find_best(const struct tsp_intra_rows *rows, size_t idx, size_t *dest_idx, bool *edges)
+{
+	const size_t size = rows->size;
+	assert(idx < size);
+	long ret = 0;
+	*dest_idx = idx;
+	*edges = false;
+
+	if (!rows->vectorized) {
+		for (size_t j = idx + 1; j < size; j++) {
+			_intra_rows_try(rows, idx, j, &ret, dest_idx, edges);
+		}
+		return ret;
+	}
+
+	/* Neighbours of the node at idx, including the last node for the first
+	 * one, share edges with it and are evaluated one by one */
+	if (idx + 1 < size) {
+		_intra_rows_try(rows, idx, idx + 1, &ret, dest_idx, edges);
+	}
+	const size_t begin = idx + 2;
+	const size_t end = idx == 0 ? size - 1 : size;
+	if (begin < end) {
+		const unsigned *const cols = rows->matrix->dist;
+		const size_t prev_idx = (idx + size - 1) % size;
+		struct tsp_intra_scan scan;
+		scan.ids = rows->ids;
+		scan.succ = rows->succ;
+		scan.row = cols + (size_t)rows->ids[idx] * rows->matrix->size;
+		scan.row_prev = cols + (size_t)rows->ids[prev_idx] * rows->matrix->size;
+		scan.row_next = cols + (size_t)rows->ids[idx + 1] * rows->matrix->size;
+		scan.base_nodes = -rows->succ[prev_idx] - rows->succ[idx];
+		scan.base_edges = -rows->succ[prev_idx];
+		scan.begin = begin;
+		scan.end = end;
+		long delta;
+		bool scan_edges;
+		const size_t j = tsp_intra_scan_argmin(&scan, &delta, &scan_edges);
+		if (delta < ret) {
+			ret = delta;
+			*dest_idx = j;
+			*edges = scan_edges;
+		}
+	}
+	if (idx == 0 && size > 2) {
+		_intra_rows_try(rows, idx, size - 1, &ret, dest_idx, edges);
+	}
+
+	#ifdef TSP_TEST_EVAL
+	const long target_delta = *edges
+		? tsp_nodes_evaluate_swap_edges(rows->nodes, rows->matrix, idx, *dest_idx)
+		: tsp_nodes_evaluate_swap_nodes(rows->nodes, rows->matrix, idx, *dest_idx);
+	if (ret != target_delta) {
+		error(("incorrect delta: got %ld, expected %ld", ret, target_delta));
+	}
+	#endif /* TSP_TEST_EVAL */
+
+	return ret;
+}
+
+void tsp_intra_rows_destroy(struct tsp_intra_rows *rows)
+{
+	free(rows->ids);
+	free(rows->succ);
+	free(rows);
+}
+
 bool id_val_pair_min_val_cmp(const void *a, const void *b)
 {
 	const struct id_val_pair *const p1 = a;
@@ -992,24 +1284,24 @@ bool id_val_pair_min_val_cmp(const void *a, const void *b)
 struct tsp_cand_matrix *tsp_graph_compute_candidates(const struct tsp_graph *graph, size_t n)
 {
 	assert(n > 0);
-	const struct sp_stack *const vacant = graph->nodes_vacant;
-	const struct sp_stack *const active = graph->nodes_active;
-	const struct tsp_dist_matrix *const matrix = &graph->dist_matrix;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
 	const size_t n_nodes = vacant->size + active->size;
 	assert(n_nodes == matrix->size);
 	struct tsp_cand_matrix *const ret = tsp_cand_matrix_create(n_nodes);
 	ret->size = n_nodes;
 
-	/* Create a helper stack of all nodes */
+	/* Create a helper tour of all nodes */
 	if (n >= n_nodes) {
 		/* Every node is a candidate */
 		memset(ret->cand, 0xff, n_nodes * n_nodes * sizeof(bool));
 		return ret;
 	}
-	struct sp_stack *const nodes = sp_stack_create(sizeof(struct tsp_node), n_nodes);
-	sp_stack_copy(nodes, vacant, NULL);
+	struct tsp_tour *const nodes = tsp_tour_create(n_nodes);
+	tsp_tour_copy(nodes, vacant);
 	for (size_t i = 0; i < active->size; i++) {
-		sp_stack_push(nodes, sp_stack_get(active, i));
+		tsp_tour_push(nodes, tsp_tour_get(active, i));
 	}
 	assert(nodes->size == n_nodes);
 
@@ -1017,7 +1309,7 @@ struct tsp_cand_matrix *tsp_graph_compute_candidates(const struct tsp_graph *gra
 
 	/* Consider each node in the graph */
 	for (size_t i = 0; i < n_nodes; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes, i);
+		const unsigned id = tsp_tour_get(nodes, i);
 
 		/* Insert all other nodes into a distance-based min-heap */
 		tsp_heap_clear(heap);
@@ -1025,10 +1317,10 @@ struct tsp_cand_matrix *tsp_graph_compute_candidates(const struct tsp_graph *gra
 			if (j == i) {
 				continue;
 			}
-			const struct tsp_node node_neighbor = *(struct tsp_node*)sp_stack_get(nodes, j);
+			const unsigned neighbor_id = tsp_tour_get(nodes, j);
 			const struct id_val_pair p = {
-				node_neighbor.id,
-				mdist(node.id, node_neighbor.id, matrix),
+				neighbor_id,
+				mdist(id, neighbor_id, matrix),
 			};
 			tsp_heap_push(heap, &p);
 		}
@@ -1037,15 +1329,15 @@ struct tsp_cand_matrix *tsp_graph_compute_candidates(const struct tsp_graph *gra
 		for (size_t k = 0; k < n; k++) {
 			const struct id_val_pair candidate = *(struct id_val_pair*)tsp_heap_get(heap);
 			tsp_heap_pop(heap);
-			assert(matrix->dist[node.id * n_nodes + candidate.id] == candidate.val);
-			assert(matrix->dist[candidate.id * n_nodes + node.id] == candidate.val);
-			ret->cand[node.id * n_nodes + candidate.id] = true;
-			ret->cand[candidate.id * n_nodes + node.id] = true;
+			assert(mdist(id, candidate.id, matrix) == candidate.val);
+			assert(mdist(candidate.id, id, matrix) == candidate.val);
+			ret->cand[id * n_nodes + candidate.id] = true;
+			ret->cand[candidate.id * n_nodes + id] = true;
 		}
 	}
 
 	tsp_heap_destroy(heap);
-	sp_stack_destroy(nodes, NULL);
+	tsp_tour_destroy(nodes);
 	return ret;
 }
 
@@ -1065,49 +1357,49 @@ void tsp_cand_matrix_destroy(struct tsp_cand_matrix *cand_matrix)
 
 bool tsp_graph_inter_swap_adds_candidate(const struct tsp_graph *graph, const struct tsp_cand_matrix *cand_matrix, size_t active_idx, size_t vacant_idx)
 {
-	const struct sp_stack *const vacant = graph->nodes_vacant;
-	const struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
 
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(vacant, vacant_idx);
+	const unsigned n1 = tsp_tour_get(vacant, vacant_idx);
 	const size_t n2_prev_idx = (active_idx + active->size - 1) % active->size;
 	const size_t n2_next_idx = (active_idx + 1) % active->size;
-	const struct tsp_node n2_prev = *(struct tsp_node*)sp_stack_get(active, n2_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(active, n2_next_idx);
+	const unsigned n2_prev = tsp_tour_get(active, n2_prev_idx);
+	const unsigned n2_next = tsp_tour_get(active, n2_next_idx);
 
 	if (
-		cand_matrix->cand[n1.id * cand_matrix->size + n2_prev.id] ||
-		cand_matrix->cand[n1.id * cand_matrix->size + n2_next.id]
+		cand_matrix->cand[n1 * cand_matrix->size + n2_prev] ||
+		cand_matrix->cand[n1 * cand_matrix->size + n2_next]
 	) {
 		return true;
 	}
 	return false;
 }
 
-bool tsp_nodes_swap_nodes_adds_candidate(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2)
+bool tsp_nodes_swap_nodes_adds_candidate(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2)
 {
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes, idx1);
-	const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes, idx2);
+	const unsigned n1 = tsp_tour_get(nodes, idx1);
+	const unsigned n2 = tsp_tour_get(nodes, idx2);
 	const size_t n1_prev_idx = (idx1 + nodes->size - 1) % nodes->size;
 	const size_t n1_next_idx = (idx1 + 1) % nodes->size;
 	const size_t n2_prev_idx = (idx2 + nodes->size - 1) % nodes->size;
 	const size_t n2_next_idx = (idx2 + 1) % nodes->size;
-	const struct tsp_node n1_prev = *(struct tsp_node*)sp_stack_get(nodes, n1_prev_idx);
-	const struct tsp_node n1_next = *(struct tsp_node*)sp_stack_get(nodes, n1_next_idx);
-	const struct tsp_node n2_prev = *(struct tsp_node*)sp_stack_get(nodes, n2_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(nodes, n2_next_idx);
+	const unsigned n1_prev = tsp_tour_get(nodes, n1_prev_idx);
+	const unsigned n1_next = tsp_tour_get(nodes, n1_next_idx);
+	const unsigned n2_prev = tsp_tour_get(nodes, n2_prev_idx);
+	const unsigned n2_next = tsp_tour_get(nodes, n2_next_idx);
 
 	if (
-		cand_matrix->cand[n2.id * cand_matrix->size + (n1_prev.id != n2.id ? n1_prev.id : n1.id)] ||
-		cand_matrix->cand[n2.id * cand_matrix->size + (n1_next.id != n2.id ? n1_next.id : n1.id)] ||
-		cand_matrix->cand[n1.id * cand_matrix->size + (n2_prev.id != n1.id ? n2_prev.id : n2.id)] ||
-		cand_matrix->cand[n1.id * cand_matrix->size + (n2_next.id != n1.id ? n2_next.id : n2.id)]
+		cand_matrix->cand[n2 * cand_matrix->size + (n1_prev != n2 ? n1_prev : n1)] ||
+		cand_matrix->cand[n2 * cand_matrix->size + (n1_next != n2 ? n1_next : n1)] ||
+		cand_matrix->cand[n1 * cand_matrix->size + (n2_prev != n1 ? n2_prev : n2)] ||
+		cand_matrix->cand[n1 * cand_matrix->size + (n2_next != n1 ? n2_next : n2)]
 	) {
 		return true;
 	}
 	return false;
 }
 
-bool tsp_nodes_swap_edges_adds_candidate(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2)
+bool tsp_nodes_swap_edges_adds_candidate(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2)
 {
 	/* Make sure idx1 < idx2 */
 	if (idx1 > idx2) {
@@ -1116,16 +1408,16 @@ bool tsp_nodes_swap_edges_adds_candidate(const struct sp_stack *nodes, const str
 		idx2 = tmp;
 	}
 
-	const struct tsp_node n1 = *(struct tsp_node*)sp_stack_get(nodes, idx1);
-	const struct tsp_node n2 = *(struct tsp_node*)sp_stack_get(nodes, idx2);
+	const unsigned n1 = tsp_tour_get(nodes, idx1);
+	const unsigned n2 = tsp_tour_get(nodes, idx2);
 	const size_t n1_prev_idx = (idx1 + nodes->size - 1) % nodes->size;
 	const size_t n2_next_idx = (idx2 + 1) % nodes->size;
-	const struct tsp_node n1_prev = *(struct tsp_node*)sp_stack_get(nodes, n1_prev_idx);
-	const struct tsp_node n2_next = *(struct tsp_node*)sp_stack_get(nodes, n2_next_idx);
+	const unsigned n1_prev = tsp_tour_get(nodes, n1_prev_idx);
+	const unsigned n2_next = tsp_tour_get(nodes, n2_next_idx);
 
 	if (
-		cand_matrix->cand[n1.id * cand_matrix->size + n2_next.id] ||
-		cand_matrix->cand[n2.id * cand_matrix->size + n1_prev.id]
+		cand_matrix->cand[n1 * cand_matrix->size + n2_next] ||
+		cand_matrix->cand[n2 * cand_matrix->size + n1_prev]
 	) {
 		return true;
 	}
@@ -1143,7 +1435,7 @@ bool *tsp_graph_cache_inter_swap_adds_candidates(const struct tsp_graph *graph,
 	return ret;
 }
 
-bool *tsp_nodes_cache_swap_nodes_adds_candidates(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix)
+bool *tsp_nodes_cache_swap_nodes_adds_candidates(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix)
 {
 	bool *const ret = malloc_or_die(cand_matrix->size * cand_matrix->size * sizeof(bool));
 	for (size_t i = 0; i < nodes->size; i++) {
@@ -1154,7 +1446,7 @@ bool *tsp_nodes_cache_swap_nodes_adds_candidates(const struct sp_stack *nodes, c
 	return ret;
 }
 
-bool *tsp_nodes_cache_swap_edges_adds_candidates(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix)
+bool *tsp_nodes_cache_swap_edges_adds_candidates(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix)
 {
 	bool *const ret = malloc_or_die(cand_matrix->size * cand_matrix->size * sizeof(bool));
 	for (size_t i = 0; i < nodes->size; i++) {
@@ -1215,8 +1507,8 @@ void tsp_delta_cache_destroy(struct tsp_delta_cache *delta_matrix)
 
 long tsp_graph_evaluate_inter_swap_with_delta_cache(const struct tsp_graph *graph, size_t active_idx, size_t vacant_idx, struct tsp_delta_cache *cache)
 {
-	const size_t active_id = ((struct tsp_node*)sp_stack_get(graph->nodes_active, active_idx))->id;
-	const size_t vacant_id = ((struct tsp_node*)sp_stack_get(graph->nodes_vacant, vacant_idx))->id;
+	const size_t active_id = tsp_tour_get(graph->nodes_active, active_idx);
+	const size_t vacant_id = tsp_tour_get(graph->nodes_vacant, vacant_idx);
 
 	if (cache->inter_swap[active_id * cache->size + vacant_id] != LONG_MIN) {
 		#ifdef TSP_TEST_DELTA_CACHE
@@ -1233,8 +1525,8 @@ long tsp_graph_evaluate_inter_swap_with_delta_cache(const struct tsp_graph *grap
 
 long tsp_graph_evaluate_swap_nodes_with_delta_cache(const struct tsp_graph *graph, size_t idx1, size_t idx2, struct tsp_delta_cache *cache)
 {
-	const size_t id1 = ((struct tsp_node*)sp_stack_get(graph->nodes_active, idx1))->id;
-	const size_t id2 = ((struct tsp_node*)sp_stack_get(graph->nodes_active, idx2))->id;
+	const size_t id1 = tsp_tour_get(graph->nodes_active, idx1);
+	const size_t id2 = tsp_tour_get(graph->nodes_active, idx2);
 
 	if (cache->swap_nodes[id1 * cache->size + id2] != LONG_MIN) {
 		#ifdef TSP_TEST_DELTA_CACHE
@@ -1244,7 +1536,7 @@ long tsp_graph_evaluate_swap_nodes_with_delta_cache(const struct tsp_graph *grap
 		#endif /* TSP_TEST_DELTA_CACHE */
 		return cache->swap_nodes[id1 * cache->size + id2];
 	}
-	const long delta = tsp_nodes_evaluate_swap_nodes(graph->nodes_active, &graph->dist_matrix, idx1, idx2);
+	const long delta = tsp_nodes_evaluate_swap_nodes(graph->nodes_active, graph->dist_matrix, idx1, idx2);
 	cache->swap_nodes[id1 * cache->size + id2] = delta;
 	cache->swap_nodes[id2 * cache->size + id1] = delta;
 	return delta;
@@ -1252,8 +1544,8 @@ long tsp_graph_evaluate_swap_nodes_with_delta_cache(const struct tsp_graph *grap
 
 long tsp_graph_evaluate_swap_edges_with_delta_cache(const struct tsp_graph *graph, size_t idx1, size_t idx2, struct tsp_delta_cache *cache)
 {
-	const size_t id1 = ((struct tsp_node*)sp_stack_get(graph->nodes_active, idx1))->id;
-	const size_t id2 = ((struct tsp_node*)sp_stack_get(graph->nodes_active, idx2))->id;
+	const size_t id1 = tsp_tour_get(graph->nodes_active, idx1);
+	const size_t id2 = tsp_tour_get(graph->nodes_active, idx2);
 
 	if (cache->swap_edges[id1 * cache->size + id2] != LONG_MIN) {
 		#ifdef TSP_TEST_DELTA_CACHE
@@ -1263,7 +1555,7 @@ long tsp_graph_evaluate_swap_edges_with_delta_cache(const struct tsp_graph *grap
 		#endif /* TSP_TEST_DELTA_CACHE */
 		return cache->swap_edges[id1 * cache->size + id2];
 	}
-	const long delta = tsp_nodes_evaluate_swap_edges(graph->nodes_active, &graph->dist_matrix, idx1, idx2);
+	const long delta = tsp_nodes_evaluate_swap_edges(graph->nodes_active, graph->dist_matrix, idx1, idx2);
 	cache->swap_edges[id1 * cache->size + id2] = delta;
 	cache->swap_edges[id2 * cache->size + id1] = delta;
 	return delta;
@@ -1271,7 +1563,7 @@ long tsp_graph_evaluate_swap_edges_with_delta_cache(const struct tsp_graph *grap
 
 void tsp_graph_inter_swap_with_delta_cache(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx, struct tsp_delta_cache *cache)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	const size_t n2_prev_idx = (active_idx + active->size - 1) % active->size;
 	const size_t n2_next_idx = (active_idx + 1) % active->size;
@@ -1287,13 +1579,13 @@ void tsp_graph_inter_swap_with_delta_cache(struct tsp_graph *graph, size_t activ
 
 void tsp_graph_swap_nodes_with_delta_cache(struct tsp_graph *graph, size_t idx1, size_t idx2, struct tsp_delta_cache *cache)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	const size_t n1_prev_idx = (idx1 + active->size - 1) % active->size;
 	const size_t n1_next_idx = (idx1 + 1) % active->size;
 	const size_t n2_prev_idx = (idx2 + active->size - 1) % active->size;
 	const size_t n2_next_idx = (idx2 + 1) % active->size;
-	tsp_nodes_swap_nodes(graph->nodes_active, idx1, idx2);
+	tsp_graph_swap_nodes(graph, idx1, idx2);
 	tsp_graph_update_delta_cache_for_node(graph, cache, idx1);
 	tsp_graph_update_delta_cache_for_node(graph, cache, idx2);
 	tsp_graph_update_delta_cache_for_node(graph, cache, n1_next_idx);
@@ -1308,7 +1600,7 @@ void tsp_graph_swap_nodes_with_delta_cache(struct tsp_graph *graph, size_t idx1,
 
 void tsp_graph_swap_edges_with_delta_cache(struct tsp_graph *graph, size_t idx1, size_t idx2, struct tsp_delta_cache *cache)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	/* Make sure idx1 < idx2 */
 	if (idx1 > idx2) {
@@ -1319,7 +1611,7 @@ void tsp_graph_swap_edges_with_delta_cache(struct tsp_graph *graph, size_t idx1,
 
 	const size_t n1_prev_idx = (idx1 + active->size - 1) % active->size;
 	const size_t n2_next_idx = (idx2 + 1) % active->size;
-	tsp_nodes_swap_edges(graph->nodes_active, idx1, idx2);
+	tsp_graph_swap_edges(graph, idx1, idx2);
 	if (idx1 == 0) {
 		tsp_graph_update_delta_cache_for_node(graph, cache, n1_prev_idx);
 		for (size_t i = 0; i <= n2_next_idx; i++) {
@@ -1338,13 +1630,13 @@ void tsp_graph_swap_edges_with_delta_cache(struct tsp_graph *graph, size_t idx1,
 
 void tsp_delta_cache_verify_inter_swap(const struct tsp_delta_cache *cache, const struct tsp_graph *graph)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	for (size_t active_idx = 0; active_idx < active->size; active_idx++) {
-		const size_t active_id = ((struct tsp_node*)sp_stack_get(active, active_idx))->id;
+		const size_t active_id = tsp_tour_get(active, active_idx);
 		for (size_t vacant_idx = 0; vacant_idx < vacant->size; vacant_idx++) {
-			const size_t vacant_id = ((struct tsp_node*)sp_stack_get(vacant, vacant_idx))->id;
+			const size_t vacant_id = tsp_tour_get(vacant, vacant_idx);
 			const long cached_inter_delta = cache->inter_swap[active_id * cache->size + vacant_id];
 			const long true_inter_delta = tsp_graph_evaluate_inter_swap(graph, active_idx, vacant_idx);
 			if (cached_inter_delta != LONG_MIN && cached_inter_delta != true_inter_delta) {
@@ -1357,15 +1649,15 @@ void tsp_delta_cache_verify_inter_swap(const struct tsp_delta_cache *cache, cons
 
 void tsp_delta_cache_verify_swap_nodes(const struct tsp_delta_cache *cache, const struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	for (size_t idx1 = 0; idx1 < active->size; idx1++) {
 		for (size_t idx2 = idx1; idx2 < active->size; idx2++) {
-			const size_t id1 = ((struct tsp_node*)sp_stack_get(active, idx1))->id;
-			const size_t id2 = ((struct tsp_node*)sp_stack_get(active, idx2))->id;
+			const size_t id1 = tsp_tour_get(active, idx1);
+			const size_t id2 = tsp_tour_get(active, idx2);
 			const long cached_edges_delta1 = cache->swap_edges[id1 * cache->size + id2];
 			const long cached_edges_delta2 = cache->swap_edges[id2 * cache->size + id1];
-			const long true_edges_delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, idx1, idx2);
+			const long true_edges_delta = tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, idx1, idx2);
 			if (cached_edges_delta1 != cached_edges_delta2) {
 				error(("diagonal delta mismatch: %ld != %ld", cached_edges_delta1, cached_edges_delta2));
 			}
@@ -1379,15 +1671,15 @@ void tsp_delta_cache_verify_swap_nodes(const struct tsp_delta_cache *cache, cons
 
 void tsp_delta_cache_verify_swap_edges(const struct tsp_delta_cache *cache, const struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	const struct tsp_tour *const active = graph->nodes_active;
 
 	for (size_t idx1 = 0; idx1 < active->size; idx1++) {
 		for (size_t idx2 = idx1; idx2 < active->size; idx2++) {
-			const size_t id1 = ((struct tsp_node*)sp_stack_get(active, idx1))->id;
-			const size_t id2 = ((struct tsp_node*)sp_stack_get(active, idx2))->id;
+			const size_t id1 = tsp_tour_get(active, idx1);
+			const size_t id2 = tsp_tour_get(active, idx2);
 			const long cached_edges_delta1 = cache->swap_edges[id1 * cache->size + id2];
 			const long cached_edges_delta2 = cache->swap_edges[id2 * cache->size + id1];
-			const long true_edges_delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, idx1, idx2);
+			const long true_edges_delta = tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, idx1, idx2);
 			if (cached_edges_delta1 != cached_edges_delta2) {
 				error(("diagonal delta mismatch: %ld != %ld", cached_edges_delta1, cached_edges_delta2));
 			}
@@ -1401,13 +1693,13 @@ void tsp_delta_cache_verify_swap_edges(const struct tsp_delta_cache *cache, cons
 
 void tsp_graph_update_delta_cache_for_node(const struct tsp_graph *graph, struct tsp_delta_cache *cache, size_t node_idx)
 {
-	const struct sp_stack *const vacant = graph->nodes_vacant;
-	const struct sp_stack *const active = graph->nodes_active;
-	const size_t node_id = ((struct tsp_node*)sp_stack_get(active, node_idx))->id;
+	const struct tsp_tour *const vacant = graph->nodes_vacant;
+	const struct tsp_tour *const active = graph->nodes_active;
+	const size_t node_id = tsp_tour_get(active, node_idx);
 
 	/* Update inter_swap deltas between the target node and all vacant nodes */
 	for (size_t vacant_idx = 0; vacant_idx < vacant->size; vacant_idx++) {
-		const size_t vacant_id = ((struct tsp_node*)sp_stack_get(vacant, vacant_idx))->id;
+		const size_t vacant_id = tsp_tour_get(vacant, vacant_idx);
 		if (cache->inter_swap[node_id * cache->size + vacant_id] == LONG_MIN) {
 			continue;
 		}
@@ -1417,31 +1709,31 @@ void tsp_graph_update_delta_cache_for_node(const struct tsp_graph *graph, struct
 	}
 	/* Delete stale deltas between the target node and all active nodes */
 	for (size_t active_idx = 0; active_idx < active->size; active_idx++) {
-		const size_t other_active_id = ((struct tsp_node*)sp_stack_get(active, active_idx))->id;
+		const size_t other_active_id = tsp_tour_get(active, active_idx);
 		cache->inter_swap[node_id * cache->size + other_active_id] = LONG_MIN;
 		cache->inter_swap[other_active_id * cache->size + node_id] = LONG_MIN;
 	}
 
 	/* Update swap_nodes deltas between the target node and all active nodes */
 	for (size_t active_idx = 0; active_idx < active->size; active_idx++) {
-		const size_t active_id = ((struct tsp_node*)sp_stack_get(active, active_idx))->id;
+		const size_t active_id = tsp_tour_get(active, active_idx);
 		assert(cache->swap_nodes[node_id * cache->size + active_id] == cache->swap_nodes[active_id * cache->size + node_id]);
 		if (cache->swap_nodes[node_id * cache->size + active_id] == LONG_MIN) {
 			continue;
 		}
-		const long swap_nodes_delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, active_idx, node_idx);
+		const long swap_nodes_delta = tsp_nodes_evaluate_swap_nodes(active, graph->dist_matrix, active_idx, node_idx);
 		cache->swap_nodes[node_id * cache->size + active_id] = swap_nodes_delta;
 		cache->swap_nodes[active_id * cache->size + node_id] = swap_nodes_delta;
 	}
 
 	/* Update swap_edges deltas between the target node and all active nodes */
 	for (size_t active_idx = 0; active_idx < active->size; active_idx++) {
-		const size_t active_id = ((struct tsp_node*)sp_stack_get(active, active_idx))->id;
+		const size_t active_id = tsp_tour_get(active, active_idx);
 		assert(cache->swap_edges[node_id * cache->size + active_id] == cache->swap_edges[active_id * cache->size + node_id]);
 		if (cache->swap_edges[node_id * cache->size + active_id] == LONG_MIN) {
 			continue;
 		}
-		const long swap_edges_delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, active_idx, node_idx);
+		const long swap_edges_delta = tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, active_idx, node_idx);
 		cache->swap_edges[node_id * cache->size + active_id] = swap_edges_delta;
 		cache->swap_edges[active_id * cache->size + node_id] = swap_edges_delta;
 	}
@@ -1449,36 +1741,34 @@ void tsp_graph_update_delta_cache_for_node(const struct tsp_graph *graph, struct
 
 void tsp_graph_large_scale_destroy_repair(struct tsp_graph *graph, size_t n_nodes)
 {
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct sp_stack *const active = graph->nodes_active;
-
 	tsp_graph_deactivate_random(graph, n_nodes);
 
 	for (size_t i = 0; i < n_nodes; i++) {
-		struct tsp_node node;
 		const struct tsp_move move = tsp_graph_find_nc(graph);
-		node = *(struct tsp_node*)sp_stack_get(vacant, move.src);
-		sp_stack_remove(vacant, move.src, NULL);
-		sp_stack_insert(active, move.dest, &node);
+		tsp_graph_insert(graph, move);
 	}
 }
 
-size_t tsp_nodes_compute_similarity_nodes(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
+size_t tsp_nodes_compute_similarity_nodes(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2)
 {
-	bool *const node_in_nodes1 = calloc_or_die((TSP_MAX_NODE_ID + 1) * sizeof(bool));
 	size_t sim = 0;
-	for (size_t i = 0; i < nodes1->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes1, i);
-		node_in_nodes1[node.id] = true;
-	}
 	for (size_t i = 0; i < nodes2->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes2, i);
-		sim += node_in_nodes1[node.id] ? 1 : 0;
+		sim += tsp_tour_contains(nodes1, nodes2->ids[i]) ? 1 : 0;
 	}
-	free(node_in_nodes1);
 	return sim;
 }
 
+/* Number of nodes in both routes, as a popcount of their active sets */
+size_t tsp_graph_compute_similarity_nodes(const struct tsp_graph *graph1, const struct tsp_graph *graph2)
+{
+	return tsp_bitset_count_and(graph1->active, graph2->active);
+}
+
+size_t tsp_graph_compute_similarity_edges(const struct tsp_graph *graph1, const struct tsp_graph *graph2)
+{
+	return tsp_nodes_compute_similarity_edges(graph1->nodes_active, graph2->nodes_active);
+}
+
 /* Packs 2 numbers into a `size_t` value. Both numbers must not exceed 1/2 of `size_t` width. */
 size_t _pack_into_size_t(size_t num1, size_t num2)
 {
@@ -1497,83 +1787,68 @@ void _unpack_from_size_t(size_t compound, size_t *num1, size_t *num2)
 	*num2 = (compound & (all_1s >> (size_t_width / 2)));
 }
 
-size_t tsp_nodes_compute_similarity_edges(const struct sp_stack *nodes1, const struct sp_stack *nodes2)
+size_t tsp_nodes_compute_similarity_edges(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2)
 {
-	struct hashmap *const hm = hashmap_create(256);
+	struct hashmap *const hm = hashmap_create(MAX(256, nodes1->size));
 	size_t sim = 0;
 
-	struct tsp_node prev_node = *(struct tsp_node*)sp_stack_get(nodes1, nodes1->size - 1);
-	for (size_t i = 0; i < nodes1->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes1, i);
-		const size_t edge = _pack_into_size_t(MIN(prev_node.id, node.id), MAX(prev_node.id, node.id));
+	unsigned prev_id = nodes1->ids[0];
+	for (size_t i = nodes1->size; i-- > 0;) {
+		const unsigned id = nodes1->ids[i];
+		const size_t edge = _pack_into_size_t(MIN(prev_id, id), MAX(prev_id, id));
 		hashmap_set(hm, edge, true);
-		prev_node = node;
+		prev_id = id;
 	}
 
-	prev_node = *(struct tsp_node*)sp_stack_get(nodes2, nodes2->size - 1);
-	for (size_t i = 0; i < nodes2->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(nodes2, i);
-		const size_t edge = _pack_into_size_t(MIN(prev_node.id, node.id), MAX(prev_node.id, node.id));
+	prev_id = nodes2->ids[0];
+	for (size_t i = nodes2->size; i-- > 0;) {
+		const unsigned id = nodes2->ids[i];
+		const size_t edge = _pack_into_size_t(MIN(prev_id, id), MAX(prev_id, id));
 		sim += hashmap_contains_key(hm, edge);
-		prev_node = node;
+		prev_id = id;
 	}
 
 	hashmap_destroy(hm);
 	return sim;
 }
 
-/* Finds random node from parent which does not exist in an external graph
- * represented by the node_in_graph lookup table.
+/* Draws random nodes from a parent until one is found that is not yet in
+ * graph_active.
  *
- * haystack is an auxiliary buffer for shuffling parent nodes. Since this
- * function might get called repeatedly a lot, it's more efficient to allocate
- * this stack externally and reuse it.
+ * haystack holds the parent's nodes shuffled once up front. Nodes drawn from
+ * it are either added to the graph or already in it, and graphs only grow
+ * during recombination, so no node needs to be drawn twice and all calls
+ * together take linear time.
  *
- * Returns address to the node (within parent_nodes), or NULL if not found. */
-struct tsp_node *_find_starting_node(const struct sp_stack *parent_nodes, const bool *node_in_graph, struct sp_stack *haystack)
+ * Returns ID of the node, or SIZE_MAX if not found. */
+size_t _find_starting_node(struct tsp_tour *haystack, const struct tsp_bitset *graph_active)
 {
-	struct tsp_node *ret = NULL;
-	sp_stack_copy(haystack, parent_nodes, NULL);
-
-	tail_shuffle(haystack->data, haystack->elem_size, haystack->size, haystack->size - 1);
+	size_t ret;
 	do {
 		if (haystack->size == 0) {
-			return NULL;
+			return SIZE_MAX;
 		}
-		ret = (struct tsp_node*)sp_stack_peek(haystack);
-		sp_stack_pop(haystack, NULL);
-	} while (node_in_graph[ret->id]);
+		ret = tsp_tour_pop(haystack);
+	} while (tsp_bitset_test(graph_active, ret));
 
 	return ret;
 }
 
-/* Finds the node that follows a given node in a solution.
- *
- * Returns index of the node or SIZE_MAX if not found. */
-size_t _find_node(const struct sp_stack *nodes, unsigned node_id)
-{
-	/* Locate node with ID equal to node_id */
-	for (size_t i = 0; i < nodes->size; i++) {
-		struct tsp_node *const node = sp_stack_get(nodes, i);
-		if (node->id == node_id) {
-			return i;
-		}
-	}
-	return SIZE_MAX;
-}
-
-void _push_neighboring_nodes_if_not_in_graph(struct sp_stack *dest, const struct sp_stack *parent_nodes, size_t node_idx, const bool *node_in_graph)
+/* Appends to dest the neighbours of a node which are not in graph_active.
+ * Returns the new size of dest. */
+size_t _push_neighboring_nodes_if_not_in_graph(unsigned *dest, size_t dest_size, const struct tsp_tour *parent_nodes, size_t node_idx, const struct tsp_bitset *graph_active)
 {
 	const size_t node_neighbor_next_idx = (node_idx + 1) % parent_nodes->size;
 	const size_t node_neighbor_prev_idx = (node_idx + parent_nodes->size - 1) % parent_nodes->size;
-	const unsigned node_neighbor_next_id = ((struct tsp_node*)sp_stack_get(parent_nodes, node_neighbor_next_idx))->id;
-	const unsigned node_neighbor_prev_id = ((struct tsp_node*)sp_stack_get(parent_nodes, node_neighbor_prev_idx))->id;
-	if (!node_in_graph[node_neighbor_next_id]) {
-		sp_stack_pushui(dest, node_neighbor_next_id);
+	const unsigned node_neighbor_next_id = tsp_tour_get(parent_nodes, node_neighbor_next_idx);
+	const unsigned node_neighbor_prev_id = tsp_tour_get(parent_nodes, node_neighbor_prev_idx);
+	if (!tsp_bitset_test(graph_active, node_neighbor_next_id)) {
+		dest[dest_size++] = node_neighbor_next_id;
 	}
-	if (!node_in_graph[node_neighbor_prev_id]) {
-		sp_stack_pushui(dest, node_neighbor_prev_id);
+	if (!tsp_bitset_test(graph_active, node_neighbor_prev_id)) {
+		dest[dest_size++] = node_neighbor_prev_id;
 	}
+	return dest_size;
 }
 
 /* Populate a child graph with common nodes and edges from 2 parent graphs.
@@ -1582,46 +1857,45 @@ void tsp_graph_activate_common_from_parents(struct tsp_graph *graph, const struc
 {
 	assert(parent1->nodes_active->size == parent2->nodes_active->size);
 
-	/* Keep a quick lookup table for nodes present in graph */
-	bool *const node_in_graph = calloc_or_die((TSP_MAX_NODE_ID + 1) * sizeof(bool));
-	for (size_t i = 0; i < graph->nodes_active->size; i++) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_get(graph->nodes_active, i);
-		node_in_graph[node.id] = true;
+	/* Shuffled parent nodes for drawing random starting nodes */
+	tsp_graph_reserve(graph);
+	struct tsp_tour *const *const haystacks = graph->scratch;
+	for (int i = 0; i < 2; i++) {
+		tsp_tour_copy(haystacks[i], (i == 0 ? parent1 : parent2)->nodes_active);
+		if (haystacks[i]->size > 1) {
+			tsp_tour_shuffle_top(haystacks[i], haystacks[i]->size - 1);
+		}
 	}
 
-	/* Auxiliary stack for shuffling and drawing random nodes */
-	struct sp_stack *const haystack = sp_stack_create(sizeof(struct tsp_node), parent1->nodes_active->size);
-
-	/* Auxiliary stack for picking a random out of up to 4 node IDs */
-	struct sp_stack *const next_candidates = sp_stack_create(sizeof(unsigned), 4);
+	/* Auxiliary array for picking a random out of up to 4 node IDs */
+	unsigned next_candidates[4];
+	size_t n_candidates;
 
 	while (graph->nodes_active->size < parent1->nodes_active->size) {
-		struct tsp_node *prev_node = NULL;
+		size_t start_id = SIZE_MAX;
 		int parent_choice;
 
 		/* Find a random starting node from either parent */
 		parent_choice = randint(1, 2);
 		if (parent_choice == 1) {
-			prev_node = _find_starting_node(parent1->nodes_active, node_in_graph, haystack);
-			if (prev_node == NULL) {
-				prev_node = _find_starting_node(parent2->nodes_active, node_in_graph, haystack);
+			start_id = _find_starting_node(haystacks[0], graph->active);
+			if (start_id == SIZE_MAX) {
+				start_id = _find_starting_node(haystacks[1], graph->active);
 			}
 		} else if (parent_choice == 2) {
-			prev_node = _find_starting_node(parent2->nodes_active, node_in_graph, haystack);
-			if (prev_node == NULL) {
-				prev_node = _find_starting_node(parent1->nodes_active, node_in_graph, haystack);
+			start_id = _find_starting_node(haystacks[1], graph->active);
+			if (start_id == SIZE_MAX) {
+				start_id = _find_starting_node(haystacks[0], graph->active);
 			}
 		}
-		if (prev_node == NULL) {
+		if (start_id == SIZE_MAX) {
 			/* No starting nodes left */
 			break;
 		}
 
 		/* Add starting node to graph */
-		unsigned prev_node_id = prev_node->id;
-		prev_node = NULL;  /* No longer needed */
+		unsigned prev_node_id = start_id;
 		tsp_graph_activate_node_by_id(graph, prev_node_id);
-		node_in_graph[prev_node_id] = true;
 
 		/* Append node which follows prev_node_id in a random parent */
 		while (graph->nodes_active->size < parent1->nodes_active->size) {
@@ -1629,31 +1903,170 @@ void tsp_graph_activate_common_from_parents(struct tsp_graph *graph, const struc
 
 			parent_order[0] = randint(1, 2);
 			parent_order[1] = parent_order[0] == 1 ? 2 : 1;
-			sp_stack_clear(next_candidates, NULL);
+			n_candidates = 0;
 			for (int i = 0; i < 2; i++) {
-				const struct sp_stack *const parent_nodes = (parent_order[i] == 1 ? parent1 : parent2)->nodes_active;
-				size_t node_idx = _find_node(parent_nodes, prev_node_id);
+				const struct tsp_tour *const parent_nodes = (parent_order[i] == 1 ? parent1 : parent2)->nodes_active;
+				const size_t node_idx = tsp_tour_find(parent_nodes, prev_node_id);
 				if (node_idx == SIZE_MAX) {
 					/* Previous node must have come from the other parent, and this parent doesn't contain it */
 					continue;
 				}
-				_push_neighboring_nodes_if_not_in_graph(next_candidates, parent_nodes, node_idx, node_in_graph);
+				n_candidates = _push_neighboring_nodes_if_not_in_graph(next_candidates, n_candidates, parent_nodes, node_idx, graph->active);
 			}
-			assert(next_candidates->size <= 4);
-			if (next_candidates->size == 0) {
+			assert(n_candidates <= 4);
+			if (n_candidates == 0) {
 				/* No continuing nodes left */
 				break;
 			}
 
 			/* Draw random next_node, add it to graph and update prev_node */
-			const unsigned next_node_id = sp_stack_getui(next_candidates, randint(0, next_candidates->size - 1));
+			const unsigned next_node_id = next_candidates[n_candidates - 1 - randint(0, n_candidates - 1)];
 			tsp_graph_activate_node_by_id(graph, next_node_id);
-			node_in_graph[next_node_id] = true;
 			prev_node_id = next_node_id;
 		}
 	}
 
-	sp_stack_destroy(haystack, NULL);
-	sp_stack_destroy(next_candidates, NULL);
-	free(node_in_graph);
+}
+
+/* Change of the objective when node id is inserted at index idx of the route */
+long _insert_delta(const struct tsp_graph *graph, unsigned id, size_t idx)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
+	if (active->size == 0) {
+		return mcost(id, matrix);
+	}
+	const unsigned prev_id = tsp_tour_get(active, (idx + active->size - 1) % active->size);
+	const unsigned next_id = tsp_tour_get(active, idx % active->size);
+	return
+		- mdist(prev_id, next_id, matrix)
+		+ mdist(id, prev_id, matrix)
+		+ mdist(id, next_id, matrix)
+		+ mcost(id, matrix);
+}
+
+/* Change of the objective when the node at index idx leaves the route */
+long _remove_delta(const struct tsp_graph *graph, size_t idx)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	const struct tsp_dist_matrix *const matrix = graph->dist_matrix;
+	const unsigned id = tsp_tour_get(active, idx);
+	const unsigned prev_id = tsp_tour_get(active, (idx + active->size - 1) % active->size);
+	const unsigned next_id = tsp_tour_get(active, (idx + 1) % active->size);
+	return
+		+ mdist(prev_id, next_id, matrix)
+		- mdist(id, prev_id, matrix)
+		- mdist(id, next_id, matrix)
+		- mcost(id, matrix);
+}
+
+/* Swaps an active and a vacant node, leaving the score to the caller */
+void _swap_active_vacant(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx)
+{
+	const unsigned vacant_id = tsp_tour_get(graph->nodes_vacant, vacant_idx);
+	const unsigned active_id = tsp_tour_get(graph->nodes_active, active_idx);
+	tsp_tour_set(graph->nodes_vacant, vacant_idx, active_id);
+	tsp_tour_set(graph->nodes_active, active_idx, vacant_id);
+	tsp_bitset_unset(graph->active, active_id);
+	tsp_bitset_set(graph->active, vacant_id);
+}
+
+void _update_score(struct tsp_graph *graph, long delta)
+{
+	graph->score += delta;
+	#ifdef TSP_TEST_SCORE
+	tsp_graph_score(graph);
+	#endif /* TSP_TEST_SCORE */
+}
+
+/* Zobrist-style key of an undirected edge. Keys are derived from the IDs with
+ * a 64-bit mixer (splitmix64) instead of being drawn into an n x n table. */
+size_t _edge_key(size_t id1, size_t id2)
+{
+	uint64_t x = ((uint64_t)MIN(id1, id2) << 32 | MAX(id1, id2)) + 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+/* Sum of the keys of the edges leaving the given indices, each counted once */
+size_t _edges_hash(const struct tsp_tour *nodes, const size_t *starts, size_t n_starts)
+{
+	size_t hash = 0;
+	for (size_t i = 0; i < n_starts; i++) {
+		bool seen = false;
+		for (size_t j = 0; j < i; j++) {
+			seen = seen || starts[j] == starts[i];
+		}
+		if (!seen) {
+			hash += _edge_key(tsp_tour_get(nodes, starts[i]), tsp_tour_get(nodes, (starts[i] + 1) % nodes->size));
+		}
+	}
+	return hash;
+}
+
+/* Change of the hash when node id is inserted at index idx of the route */
+size_t _insert_hash_delta(const struct tsp_graph *graph, unsigned id, size_t idx)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	if (active->size == 0) {
+		return _edge_key(id, id);
+	}
+	const unsigned prev_id = tsp_tour_get(active, (idx + active->size - 1) % active->size);
+	const unsigned next_id = tsp_tour_get(active, idx % active->size);
+	return _edge_key(prev_id, id) + _edge_key(id, next_id) - _edge_key(prev_id, next_id);
+}
+
+/* Change of the hash when the node at index idx leaves the route */
+size_t _remove_hash_delta(const struct tsp_graph *graph, size_t idx)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	const unsigned id = tsp_tour_get(active, idx);
+	const unsigned prev_id = tsp_tour_get(active, (idx + active->size - 1) % active->size);
+	const unsigned next_id = tsp_tour_get(active, (idx + 1) % active->size);
+	return _edge_key(prev_id, next_id) - _edge_key(prev_id, id) - _edge_key(id, next_id);
+}
+
+void _update_hash(struct tsp_graph *graph, size_t delta)
+{
+	graph->hash += delta;
+	#ifdef TSP_TEST_HASH
+	tsp_graph_hash(graph);
+	#endif /* TSP_TEST_HASH */
+}
+
+/* Whether nodes2 is nodes1 walked backwards, from any starting node */
+bool _nodes_eq_reversed(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2)
+{
+	const size_t n = nodes1->size;
+	if (n != nodes2->size || n == 0) {
+		return n == nodes2->size;
+	}
+	const size_t offset = tsp_tour_find(nodes2, tsp_tour_get(nodes1, 0));
+	if (offset == SIZE_MAX) {
+		return false;
+	}
+	for (size_t i = 1; i < n; i++) {
+		if (tsp_tour_get(nodes1, i) != tsp_tour_get(nodes2, (offset + n - i) % n)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Keeps the node swap, then the edge swap, of idx and dest_idx if they improve on *min */
+void _intra_rows_try(const struct tsp_intra_rows *rows, size_t idx, size_t dest_idx, long *min, size_t *min_idx, bool *min_edges)
+{
+	const long nodes_delta = tsp_nodes_evaluate_swap_nodes(rows->nodes, rows->matrix, idx, dest_idx);
+	if (nodes_delta < *min) {
+		*min = nodes_delta;
+		*min_idx = dest_idx;
+		*min_edges = false;
+	}
+	const long edges_delta = tsp_nodes_evaluate_swap_edges(rows->nodes, rows->matrix, idx, dest_idx);
+	if (edges_delta < *min) {
+		*min = edges_delta;
+		*min_idx = dest_idx;
+		*min_edges = true;
+	}
 }
@@ -4,23 +4,11 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "../libstaple/src/staple.h"
-
-#define TSP_MAX_NODE_ID 200
+#include "dist_matrix.h"
+#include "tour.h"
+#include "bitset.h"
 
 /* Structs */
-struct tsp_node {
-	unsigned id;  /* Unique ID used to access the distance matrix */
-	int x;
-	int y;
-	int cost;
-};
-
-struct tsp_dist_matrix {
-	unsigned *dist;          /* 2D size x size matrix of distances */
-	struct tsp_node *nodes;  /* 1D array of nodes, indexed by node ID */
-	size_t size;             /* Number of nodes */
-};
-
 struct tsp_cand_matrix {
 	bool *cand;
 	size_t size;  /* Number of nodes */
@@ -33,12 +21,28 @@ struct tsp_delta_cache {
 	size_t size;  /* Number of nodes */
 };
 
+/* A route laid out for scanning the intra-route moves of one of its nodes
+ * with all the others in a single pass (see tsp_intra_rows_find_best) */
+struct tsp_intra_rows {
+	const struct tsp_tour *nodes;
+	const struct tsp_dist_matrix *matrix;
+	uint32_t *ids;    /* Node IDs in index order, followed by the first one again */
+	int64_t *succ;    /* Length of the edge from each index to the next one */
+	size_t size;
+	size_t capacity;
+	bool vectorized;  /* Whether the matrix has plain rows to scan */
+};
+
 struct tsp_graph {
-	/* The structure I use for nodes is called a stack,
-	 * but it has the properties of a normal array. */
-	struct sp_stack *nodes_active;  /* Nodes chosen for the route */
-	struct sp_stack *nodes_vacant;  /* Remaining, unchosen nodes */
-	struct tsp_dist_matrix dist_matrix;  /* Distance cache */
+	/* Only node IDs are kept here, coordinates and costs
+	 * are looked up in the instance by ID. */
+	struct tsp_tour *nodes_active;  /* Nodes chosen for the route */
+	struct tsp_tour *nodes_vacant;  /* Remaining, unchosen nodes */
+	struct tsp_bitset *active;  /* IDs of nodes_active, updated by every tsp_graph_* move */
+	struct tsp_dist_matrix *dist_matrix;  /* Distance cache, shared by copies of the graph */
+	unsigned long score;  /* Objective value of nodes_active, updated by every tsp_graph_* move */
+	size_t hash;  /* Hash of the edges of nodes_active (see tsp_nodes_hash), updated likewise */
+	struct tsp_tour *scratch[2];  /* Work space of recombination, allocated by tsp_graph_reserve */
 };
 
 /* Represents a move operation from src index to dest index */
@@ -50,22 +54,29 @@ struct tsp_move {
 
 /* Functions */
 struct sp_stack *tsp_nodes_read(const char *fpath);
-void tsp_dist_matrix_init(struct tsp_dist_matrix *matrix, const struct sp_stack *nodes);
-void tsp_dist_matrix_print(struct tsp_dist_matrix matrix);
 struct tsp_graph *tsp_graph_create(const struct sp_stack *nodes);
+struct tsp_graph *tsp_graph_load(const char *fpath);
+struct tsp_graph *tsp_graph_read_matrix(const char *matrix_fpath, const char *costs_fpath);
 struct tsp_graph *tsp_graph_empty(void);
+struct tsp_graph *tsp_graph_create_shared(const struct tsp_graph *graph);
 struct tsp_graph *tsp_graph_import(const char *fpath);
 void tsp_graph_copy(struct tsp_graph *dest, const struct tsp_graph *src);
+void tsp_graph_reserve(struct tsp_graph *graph);
 void tsp_graph_destroy(struct tsp_graph *graph);
 void tsp_node_print(struct tsp_node node);
 bool tsp_node_eq(struct tsp_node node1, struct tsp_node node2);
-bool tsp_nodes_eq(const struct sp_stack *nodes1, const struct sp_stack *nodes2);
-void tsp_nodes_print(const struct sp_stack *nodes);
-void tsp_nodes_print_oneline(const struct sp_stack *nodes);
+bool tsp_nodes_eq(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2);
+size_t tsp_nodes_hash(const struct tsp_tour *nodes);
+void tsp_nodes_canonical(const struct tsp_tour *nodes, tsp_id *ids);
+bool tsp_graph_eq(const struct tsp_graph *graph1, const struct tsp_graph *graph2);
+size_t tsp_graph_hash(const struct tsp_graph *graph);
+void tsp_nodes_print(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix);
+void tsp_nodes_print_oneline(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix);
 void tsp_graph_export(const struct tsp_graph *graph, const char *fpath);
 void tsp_graph_to_pdf(const struct tsp_graph *graph, const char *fpath);
 void tsp_graph_print(const struct tsp_graph *graph);
-unsigned long tsp_nodes_evaluate(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix);
+unsigned long tsp_nodes_evaluate(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix);
+void tsp_tours_evaluate_batch(const struct tsp_tour *const *tours, size_t n_tours, const struct tsp_dist_matrix *matrix, unsigned long *scores);
 long tsp_graph_evaluate_move(const struct tsp_graph *graph, struct tsp_move move);
 
 void tsp_graph_deactivate_all(struct tsp_graph *graph);
@@ -74,8 +85,8 @@ void tsp_graph_activate_node_by_id(struct tsp_graph *graph, unsigned node_id);
 void tsp_graph_deactivate_random(struct tsp_graph *graph, size_t n_nodes);
 void tsp_graph_activate_random(struct tsp_graph *graph, size_t n_nodes);
 void tsp_graph_deactivate_node(struct tsp_graph *graph, size_t idx);
-size_t tsp_nodes_find_nn(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, struct tsp_node node);
-size_t tsp_nodes_find_2nn(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, struct tsp_node node1, struct tsp_node node2);
+size_t tsp_nodes_find_nn(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, unsigned id);
+size_t tsp_nodes_find_2nn(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, unsigned id1, unsigned id2);
 struct tsp_move tsp_graph_find_nc(const struct tsp_graph *graph);
 struct sp_stack *tsp_graph_find_rcl(const struct tsp_graph *graph, size_t size, double p);
 unsigned long tsp_graph_compute_2regret(const struct tsp_graph *graph, size_t vacant_idx);
@@ -83,23 +94,33 @@ struct tsp_move tsp_graph_find_2regret(const struct tsp_graph *graph, const stru
 struct tsp_move tsp_graph_find_wsc(const struct tsp_graph *graph, const struct sp_stack *rcl, double ratio);
 
 
+unsigned long tsp_graph_score(const struct tsp_graph *graph);
+void tsp_graph_insert(struct tsp_graph *graph, struct tsp_move move);
 void tsp_graph_inter_swap(struct tsp_graph *graph, size_t active_idx, size_t vacant_idx);
-void tsp_nodes_swap_nodes(struct sp_stack *nodes, size_t idx1, size_t idx2);
-void tsp_nodes_swap_edges(struct sp_stack *nodes, size_t idx1, size_t idx2);
+void tsp_graph_swap_nodes(struct tsp_graph *graph, size_t idx1, size_t idx2);
+void tsp_graph_swap_edges(struct tsp_graph *graph, size_t idx1, size_t idx2);
+void tsp_nodes_swap_nodes(struct tsp_tour *nodes, size_t idx1, size_t idx2);
+void tsp_nodes_swap_edges(struct tsp_tour *nodes, size_t idx1, size_t idx2);
 
 long tsp_graph_evaluate_inter_swap(const struct tsp_graph *graph, size_t active_idx, size_t vacant_idx);
-long tsp_nodes_evaluate_swap_nodes(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
-long tsp_nodes_evaluate_swap_edges(const struct sp_stack *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
+long tsp_graph_find_best_inter_swap(const struct tsp_graph *graph, size_t active_idx, size_t *vacant_idx);
+long tsp_nodes_evaluate_swap_nodes(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
+long tsp_nodes_evaluate_swap_edges(const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
+
+struct tsp_intra_rows *tsp_intra_rows_create(size_t capacity);
+void tsp_intra_rows_load(struct tsp_intra_rows *rows, const struct tsp_tour *nodes, const struct tsp_dist_matrix *matrix);
+long tsp_intra_rows_find_best(const struct tsp_intra_rows *rows, size_t idx, size_t *dest_idx, bool *edges);
+void tsp_intra_rows_destroy(struct tsp_intra_rows *rows);
 
 struct tsp_cand_matrix *tsp_cand_matrix_create(size_t size);
 struct tsp_cand_matrix *tsp_graph_compute_candidates(const struct tsp_graph *graph, size_t n);
 void tsp_cand_matrix_destroy(struct tsp_cand_matrix *cand_matrix);
 bool tsp_graph_inter_swap_adds_candidate(const struct tsp_graph *graph, const struct tsp_cand_matrix *cand_matrix, size_t active_idx, size_t vacant_idx);
-bool tsp_nodes_swap_nodes_adds_candidate(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2);
-bool tsp_nodes_swap_edges_adds_candidate(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2);
+bool tsp_nodes_swap_nodes_adds_candidate(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2);
+bool tsp_nodes_swap_edges_adds_candidate(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix, size_t idx1, size_t idx2);
 bool *tsp_graph_cache_inter_swap_adds_candidates(const struct tsp_graph *graph, const struct tsp_cand_matrix *cand_matrix);
-bool *tsp_nodes_cache_swap_nodes_adds_candidates(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix);
-bool *tsp_nodes_cache_swap_edges_adds_candidates(const struct sp_stack *nodes, const struct tsp_cand_matrix *cand_matrix);
+bool *tsp_nodes_cache_swap_nodes_adds_candidates(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix);
+bool *tsp_nodes_cache_swap_edges_adds_candidates(const struct tsp_tour *nodes, const struct tsp_cand_matrix *cand_matrix);
 
 struct tsp_delta_cache *tsp_delta_cache_create(size_t size);
 void tsp_delta_cache_print(const long *delta_matrix, size_t size);
@@ -120,8 +141,10 @@ void tsp_graph_update_delta_cache_for_node(const struct tsp_graph *graph, struct
 
 void tsp_graph_large_scale_destroy_repair(struct tsp_graph *graph, size_t n_nodes);
 
-size_t tsp_nodes_compute_similarity_nodes(const struct sp_stack *nodes1, const struct sp_stack *nodes2);
-size_t tsp_nodes_compute_similarity_edges(const struct sp_stack *nodes1, const struct sp_stack *nodes2);
+size_t tsp_nodes_compute_similarity_nodes(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2);
+size_t tsp_nodes_compute_similarity_edges(const struct tsp_tour *nodes1, const struct tsp_tour *nodes2);
+size_t tsp_graph_compute_similarity_nodes(const struct tsp_graph *graph1, const struct tsp_graph *graph2);
+size_t tsp_graph_compute_similarity_edges(const struct tsp_graph *graph1, const struct tsp_graph *graph2);
 
 void tsp_graph_activate_common_from_parents(struct tsp_graph *graph, const struct tsp_graph *parent1, const struct tsp_graph *parent2);
 
@@ -0,0 +1,186 @@
+#include "optstore.h"
+#include "graph.h"
+#include "helpers.h"
+#include <string.h>
+
+/* Longest varint of a 64-bit number */
+#define VARINT_MAX_BYTES 10
+
+/* Private functions */
+size_t _varint_encode(unsigned char *dest, uint64_t value);
+bool _varint_read(struct tsp_optstore_reader *reader, uint64_t *value);
+void _optstore_write(struct tsp_optstore *store, const unsigned char *bytes, size_t n_bytes);
+
+
+/* Creates an empty store, backed by the file at fpath (which is truncated),
+ * or kept in memory if fpath is NULL */
+struct tsp_optstore *tsp_optstore_create(const char *fpath)
+{
+	struct tsp_optstore *const store = malloc_or_die(sizeof(struct tsp_optstore));
+	store->fpath = NULL;
+	store->file = NULL;
+	store->buf = NULL;
+	store->capacity = 0;
+	if (fpath != NULL) {
+		store->fpath = malloc_or_die(strlen(fpath) + 1);
+		strcpy(store->fpath, fpath);
+		store->file = fopen(fpath, "wb");
+		if (store->file == NULL) {
+			error(("failed to open %s for writing", fpath));
+		}
+	}
+	store->size = 0;
+	store->n_records = 0;
+	store->ids = NULL;
+	store->ids_capacity = 0;
+	return store;
+}
+
+void tsp_optstore_append(struct tsp_optstore *store, const struct tsp_tour *nodes, unsigned long score)
+{
+	unsigned char bytes[3 * VARINT_MAX_BYTES];
+	size_t n_bytes = 0;
+
+	if (nodes->size > store->ids_capacity) {
+		store->ids_capacity = MAX(nodes->size, store->ids_capacity * 2);
+		free(store->ids);
+		store->ids = malloc_or_die(store->ids_capacity * sizeof(tsp_id));
+	}
+	tsp_nodes_canonical(nodes, store->ids);
+
+	n_bytes += _varint_encode(bytes + n_bytes, nodes->size);
+	n_bytes += _varint_encode(bytes + n_bytes, score);
+	if (nodes->size != 0) {
+		n_bytes += _varint_encode(bytes + n_bytes, store->ids[0]);
+	}
+	_optstore_write(store, bytes, n_bytes);
+	for (size_t i = 1; i < nodes->size; i++) {
+		const int64_t delta = (int64_t)store->ids[i] - store->ids[i - 1];
+		const uint64_t zigzag = delta < 0 ? ((uint64_t)-delta << 1) - 1 : (uint64_t)delta << 1;
+		n_bytes = _varint_encode(bytes, zigzag);
+		_optstore_write(store, bytes, n_bytes);
+	}
+	store->n_records++;
+}
+
+void tsp_optstore_destroy(struct tsp_optstore *store)
+{
+	if (store->file != NULL) {
+		fclose(store->file);
+	}
+	free(store->fpath);
+	free(store->buf);
+	free(store->ids);
+	free(store);
+}
+
+/* Starts a pass over all records written so far */
+void tsp_optstore_reader_open(struct tsp_optstore_reader *reader, const struct tsp_optstore *store)
+{
+	reader->store = store;
+	reader->file = NULL;
+	reader->offset = 0;
+	reader->index = 0;
+	if (store->file != NULL) {
+		if (fflush(store->file) != 0) {
+			error(("failed to write %s", store->fpath));
+		}
+		reader->file = fopen(store->fpath, "rb");
+		if (reader->file == NULL) {
+			error(("failed to open %s for reading", store->fpath));
+		}
+	}
+}
+
+/* Reads the next record into nodes, in canonical form, and its score.
+ * Returns false after the last record. */
+bool tsp_optstore_read(struct tsp_optstore_reader *reader, struct tsp_tour *nodes, unsigned long *score)
+{
+	uint64_t size, value, id = 0;
+
+	if (reader->index == reader->store->n_records) {
+		return false;
+	}
+	if (!_varint_read(reader, &size) || !_varint_read(reader, &value)) {
+		error(("record %zu of a solution store is truncated", reader->index));
+	}
+	*score = value;
+
+	tsp_tour_clear(nodes);
+	for (uint64_t i = 0; i < size; i++) {
+		if (!_varint_read(reader, &value)) {
+			error(("record %zu of a solution store is truncated", reader->index));
+		}
+		id = i == 0 ? value : id + ((value & 1) ? -((value + 1) >> 1) : value >> 1);
+		tsp_tour_push(nodes, id);
+	}
+	/* Pushing left the last ID read at index 0 */
+	if (nodes->size > 1) {
+		tsp_tour_reverse(nodes, 0, nodes->size - 1);
+	}
+	reader->index++;
+	return true;
+}
+
+void tsp_optstore_reader_close(struct tsp_optstore_reader *reader)
+{
+	if (reader->file != NULL) {
+		fclose(reader->file);
+	}
+}
+
+/* LEB128: 7 bits per byte, least significant first, high bit set on all bytes but the last */
+size_t _varint_encode(unsigned char *dest, uint64_t value)
+{
+	size_t n = 0;
+	while (value >= 0x80) {
+		dest[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	dest[n++] = value;
+	return n;
+}
+
+bool _varint_read(struct tsp_optstore_reader *reader, uint64_t *value)
+{
+	*value = 0;
+	for (unsigned shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7) {
+		int byte;
+		if (reader->file != NULL) {
+			byte = getc(reader->file);
+			if (byte == EOF) {
+				return false;
+			}
+		} else {
+			if (reader->offset == reader->store->size) {
+				return false;
+			}
+			byte = reader->store->buf[reader->offset];
+		}
+		reader->offset++;
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void _optstore_write(struct tsp_optstore *store, const unsigned char *bytes, size_t n_bytes)
+{
+	if (store->file != NULL) {
+		if (fwrite(bytes, 1, n_bytes, store->file) != n_bytes) {
+			error(("failed to write %s", store->fpath));
+		}
+	} else {
+		if (store->size + n_bytes > store->capacity) {
+			store->capacity = MAX(store->size + n_bytes, MAX(256, store->capacity * 2));
+			store->buf = realloc(store->buf, store->capacity);
+			if (store->buf == NULL) {
+				error(("failed to grow a solution store to %zu bytes", store->capacity));
+			}
+		}
+		memcpy(store->buf + store->size, bytes, n_bytes);
+	}
+	store->size += n_bytes;
+}
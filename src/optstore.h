@@ -0,0 +1,43 @@
+#ifndef TSP_OPTSTORE_H
+#define TSP_OPTSTORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "tour.h"
+
+/* Append-only store of solutions, e.g. local optima sampled for a fitness
+ * landscape study. Each record is a route and its score, encoded as varints:
+ * the number of nodes, the score, the first node ID of the route in canonical
+ * form (see tsp_nodes_canonical) and the zigzag-encoded differences between
+ * consecutive IDs. Records are kept in memory, or appended to a file as they
+ * are written when the store is created with a path. Either way they are read
+ * back in streaming passes (see struct tsp_optstore_reader). */
+struct tsp_optstore {
+	char *fpath;         /* Backing file, or NULL */
+	FILE *file;
+	unsigned char *buf;  /* Records, when kept in memory */
+	size_t size;         /* Bytes in all records */
+	size_t capacity;
+	size_t n_records;
+	tsp_id *ids;         /* Canonical form of the route being written */
+	size_t ids_capacity;
+};
+
+/* Position of one pass over the records of a store */
+struct tsp_optstore_reader {
+	const struct tsp_optstore *store;
+	FILE *file;      /* Own handle on the backing file, so passes can nest */
+	size_t offset;
+	size_t index;    /* Index of the next record */
+};
+
+struct tsp_optstore *tsp_optstore_create(const char *fpath);
+void tsp_optstore_append(struct tsp_optstore *store, const struct tsp_tour *nodes, unsigned long score);
+void tsp_optstore_destroy(struct tsp_optstore *store);
+
+void tsp_optstore_reader_open(struct tsp_optstore_reader *reader, const struct tsp_optstore *store);
+bool tsp_optstore_read(struct tsp_optstore_reader *reader, struct tsp_tour *nodes, unsigned long *score);
+void tsp_optstore_reader_close(struct tsp_optstore_reader *reader);
+
+#endif /* TSP_OPTSTORE_H */
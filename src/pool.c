@@ -0,0 +1,68 @@
+#include "pool.h"
+#include "helpers.h"
+
+/* Private functions */
+struct tsp_graph *_pool_new_graph(const struct tsp_graph_pool *pool);
+
+
+/* Creates a pool of n_graphs graphs of the same instance as graph */
+struct tsp_graph_pool *tsp_graph_pool_create(const struct tsp_graph *graph, size_t n_graphs)
+{
+	struct tsp_graph_pool *const pool = malloc_or_die(sizeof(struct tsp_graph_pool));
+	pool->origin = tsp_graph_create_shared(graph);
+	pool->capacity = MAX(1, n_graphs);
+	pool->free = malloc_or_die(pool->capacity * sizeof(struct tsp_graph *));
+	pool->n_free = 0;
+	for (size_t i = 0; i < n_graphs; i++) {
+		pool->free[pool->n_free++] = _pool_new_graph(pool);
+	}
+	return pool;
+}
+
+/* Returns a graph with all nodes vacant, as tsp_graph_create_shared would. Only allocates when more graphs are
+ * acquired at once than the pool was created with. */
+struct tsp_graph *tsp_graph_pool_acquire(struct tsp_graph_pool *pool)
+{
+	if (pool->n_free == 0) {
+		warn(("graph pool of %zu graphs exhausted", pool->capacity));
+		return _pool_new_graph(pool);
+	}
+	return pool->free[--pool->n_free];
+}
+
+void tsp_graph_pool_release(struct tsp_graph_pool *pool, struct tsp_graph *graph)
+{
+	assert(graph->dist_matrix == pool->origin->dist_matrix);
+	/* Same state as a graph fresh from tsp_graph_create_shared */
+	tsp_tour_clear(graph->nodes_active);
+	tsp_bitset_clear(graph->active);
+	tsp_tour_fill(graph->nodes_vacant, graph->dist_matrix->size);
+	graph->score = 0;
+	graph->hash = 0;
+	if (pool->n_free == pool->capacity) {
+		pool->capacity *= 2;
+		pool->free = realloc(pool->free, pool->capacity * sizeof(struct tsp_graph *));
+		if (pool->free == NULL) {
+			error(("failed to grow a graph pool to %zu graphs", pool->capacity));
+		}
+	}
+	pool->free[pool->n_free++] = graph;
+}
+
+/* Destroys the pool and the graphs released into it */
+void tsp_graph_pool_destroy(struct tsp_graph_pool *pool)
+{
+	for (size_t i = 0; i < pool->n_free; i++) {
+		tsp_graph_destroy(pool->free[i]);
+	}
+	free(pool->free);
+	tsp_graph_destroy(pool->origin);
+	free(pool);
+}
+
+struct tsp_graph *_pool_new_graph(const struct tsp_graph_pool *pool)
+{
+	struct tsp_graph *const graph = tsp_graph_create_shared(pool->origin);
+	tsp_graph_reserve(graph);
+	return graph;
+}
@@ -0,0 +1,22 @@
+#ifndef TSP_POOL_H
+#define TSP_POOL_H
+
+#include <stdlib.h>
+#include "graph.h"
+
+/* Recycles graphs of one instance. All of them are created and reserved
+ * (see tsp_graph_reserve) up front, so a metaheuristic that acquires and
+ * releases its graphs from a pool makes no allocations while it runs. */
+struct tsp_graph_pool {
+	struct tsp_graph *origin;  /* Shares the instance with the pooled graphs */
+	struct tsp_graph **free;
+	size_t n_free;
+	size_t capacity;
+};
+
+struct tsp_graph_pool *tsp_graph_pool_create(const struct tsp_graph *graph, size_t n_graphs);
+struct tsp_graph *tsp_graph_pool_acquire(struct tsp_graph_pool *pool);
+void tsp_graph_pool_release(struct tsp_graph_pool *pool, struct tsp_graph *graph);
+void tsp_graph_pool_destroy(struct tsp_graph_pool *pool);
+
+#endif /* TSP_POOL_H */
@@ -0,0 +1,340 @@
+#include "scanner.h"
+#include "helpers.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* Size of the buffer of a tsp_stream */
+#define TSP_STREAM_CHUNK (1 << 16)
+
+
+/* Private functions */
+bool _skip_blanks(struct tsp_scanner *scanner);
+bool _parse_int(struct tsp_scanner *scanner, int *out);
+int _read_token(struct tsp_scanner *scanner, char *buf, size_t buf_size);
+bool _stream_fill(struct tsp_stream *stream);
+
+
+void tsp_scanner_open(struct tsp_scanner *scanner, const char *fpath)
+{
+	struct stat st;
+	const int fd = open(fpath, O_RDONLY);
+	if (fd == -1) {
+		error(("file not found: %s", fpath));
+	}
+	if (fstat(fd, &st) == -1) {
+		error(("failed to stat %s", fpath));
+	}
+
+	scanner->fpath = fpath;
+	scanner->lineno = 1;
+	scanner->token_lineno = 0;
+	scanner->map = NULL;
+	scanner->map_size = st.st_size;
+	scanner->pos = scanner->end = "";
+	if (st.st_size > 0) {
+		/* Mapping an empty file fails, so it is simply left unmapped */
+		scanner->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (scanner->map == MAP_FAILED) {
+			error(("failed to map %s", fpath));
+		}
+		madvise(scanner->map, st.st_size, MADV_SEQUENTIAL);
+		scanner->pos = scanner->map;
+		scanner->end = scanner->pos + st.st_size;
+	}
+	close(fd);
+}
+
+void tsp_scanner_close(struct tsp_scanner *scanner)
+{
+	if (scanner->map != NULL) {
+		munmap(scanner->map, scanner->map_size);
+	}
+	scanner->map = NULL;
+	scanner->pos = scanner->end = "";
+}
+
+/* Returns the number of lines left to read, counting a last line without a
+ * trailing newline. Used to size containers before parsing. */
+size_t tsp_scanner_count_lines(const struct tsp_scanner *scanner)
+{
+	size_t n_lines = 0;
+	const char *pos = scanner->pos;
+	while (pos < scanner->end) {
+		const char *const newline = memchr(pos, '\n', scanner->end - pos);
+		n_lines++;
+		if (newline == NULL) {
+			break;
+		}
+		pos = newline + 1;
+	}
+	return n_lines;
+}
+
+/* Skips spaces, tabs and carriage returns. Returns whether the rest of the
+ * line is non-empty. */
+bool _skip_blanks(struct tsp_scanner *scanner)
+{
+	while (scanner->pos < scanner->end && (*scanner->pos == ' ' || *scanner->pos == '\t' || *scanner->pos == '\r')) {
+		scanner->pos++;
+	}
+	return scanner->pos < scanner->end && *scanner->pos != '\n';
+}
+
+bool _parse_int(struct tsp_scanner *scanner, int *out)
+{
+	const char *pos = scanner->pos;
+	bool negative = false;
+	long val = 0;
+
+	if (pos < scanner->end && (*pos == '-' || *pos == '+')) {
+		negative = *pos++ == '-';
+	}
+	if (pos == scanner->end || *pos < '0' || *pos > '9') {
+		return false;
+	}
+	for (; pos < scanner->end && *pos >= '0' && *pos <= '9'; pos++) {
+		val = val * 10 + (*pos - '0');
+		if (val > (long)INT_MAX + 1) {
+			error(("integer out of range on line %zu in %s", scanner->token_lineno, scanner->fpath));
+		}
+	}
+	if (negative) {
+		val = -val;
+	}
+	if (val > INT_MAX) {
+		error(("integer out of range on line %zu in %s", scanner->token_lineno, scanner->fpath));
+	}
+	*out = val;
+	scanner->pos = pos;
+	return true;
+}
+
+/* Reads a record of n_ints integers separated by sep from the next non-empty
+ * line, like fscanf with "%d;%d;...\n". Returns EOF if there are no more
+ * records, n_ints on success, or the index of the first malformed field
+ * (trailing garbage counts as a malformed last field). */
+int tsp_scanner_read_ints(struct tsp_scanner *scanner, int *ints, int n_ints, char sep)
+{
+	/* Skip empty lines */
+	for (;;) {
+		if (scanner->pos == scanner->end) {
+			return EOF;
+		}
+		if (_skip_blanks(scanner)) {
+			break;
+		}
+		if (scanner->pos < scanner->end) {
+			scanner->pos++;  /* Newline */
+			scanner->lineno++;
+		}
+	}
+	scanner->token_lineno = scanner->lineno;
+
+	for (int i = 0; i < n_ints; i++) {
+		if (i != 0) {
+			_skip_blanks(scanner);
+			if (scanner->pos == scanner->end || *scanner->pos != sep) {
+				return i;
+			}
+			scanner->pos++;
+			_skip_blanks(scanner);
+		}
+		if (!_parse_int(scanner, &ints[i])) {
+			return i;
+		}
+	}
+	if (_skip_blanks(scanner)) {
+		return n_ints - 1;  /* Trailing garbage */
+	}
+	if (scanner->pos < scanner->end) {
+		scanner->pos++;  /* Newline */
+		scanner->lineno++;
+	}
+	return n_ints;
+}
+
+/* Reads the next line, without its line terminator. Returns false at the
+ * end of the file. The line points into the mapping. */
+bool tsp_scanner_read_line(struct tsp_scanner *scanner, const char **line, size_t *len)
+{
+	if (scanner->pos == scanner->end) {
+		return false;
+	}
+	const char *const newline = memchr(scanner->pos, '\n', scanner->end - scanner->pos);
+	const char *const line_end = newline != NULL ? newline : scanner->end;
+	*line = scanner->pos;
+	*len = line_end - scanner->pos;
+	if (*len > 0 && line_end[-1] == '\r') {
+		--*len;
+	}
+	scanner->token_lineno = scanner->lineno;
+	scanner->pos = line_end;
+	if (newline != NULL) {
+		scanner->pos++;
+		scanner->lineno++;
+	}
+	return true;
+}
+
+/* Copies the next whitespace-separated token, which may be on a later line,
+ * into buf. Returns EOF at the end of the file, 0 if the token does not fit,
+ * and 1 otherwise. */
+int _read_token(struct tsp_scanner *scanner, char *buf, size_t buf_size)
+{
+	while (!_skip_blanks(scanner)) {
+		if (scanner->pos == scanner->end) {
+			return EOF;
+		}
+		scanner->pos++;  /* Newline */
+		scanner->lineno++;
+	}
+	scanner->token_lineno = scanner->lineno;
+	size_t len = 0;
+	while (scanner->pos < scanner->end && *scanner->pos != ' ' && *scanner->pos != '\t' && *scanner->pos != '\r' && *scanner->pos != '\n') {
+		if (len + 1 == buf_size) {
+			return 0;
+		}
+		buf[len++] = *scanner->pos++;
+	}
+	buf[len] = '\0';
+	return 1;
+}
+
+/* Reads the next whitespace-separated non-negative integer. Returns EOF at
+ * the end of the file, 0 if the token is not a number or exceeds max, and 1
+ * otherwise. */
+int tsp_scanner_read_ulong(struct tsp_scanner *scanner, unsigned long *out, unsigned long max)
+{
+	char buf[32];
+	char *end;
+	const int ret = _read_token(scanner, buf, sizeof(buf));
+	if (ret != 1) {
+		return ret;
+	}
+	if (buf[0] < '0' || buf[0] > '9') {
+		return 0;
+	}
+	errno = 0;
+	*out = strtoul(buf, &end, 10);
+	return *end == '\0' && errno == 0 && *out <= max;
+}
+
+/* Reads the next whitespace-separated real number, with the same return
+ * values as tsp_scanner_read_ulong. */
+int tsp_scanner_read_double(struct tsp_scanner *scanner, double *out)
+{
+	char buf[64];
+	char *end;
+	const int ret = _read_token(scanner, buf, sizeof(buf));
+	if (ret != 1) {
+		return ret;
+	}
+	errno = 0;
+	*out = strtod(buf, &end);
+	return end != buf && *end == '\0' && errno == 0;
+}
+
+void tsp_stream_open(struct tsp_stream *stream, const char *fpath)
+{
+	stream->fd = open(fpath, O_RDONLY);
+	if (stream->fd == -1) {
+		error(("file not found: %s", fpath));
+	}
+	posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	stream->buf = malloc_or_die(TSP_STREAM_CHUNK);
+	stream->pos = 0;
+	stream->len = 0;
+	stream->lineno = 1;
+	stream->token_lineno = 0;
+	stream->fpath = fpath;
+}
+
+void tsp_stream_close(struct tsp_stream *stream)
+{
+	close(stream->fd);
+	free(stream->buf);
+	stream->buf = NULL;
+}
+
+/* Reads the next chunk if the buffer is used up. Returns false at the end of the file. */
+bool _stream_fill(struct tsp_stream *stream)
+{
+	if (stream->pos < stream->len) {
+		return true;
+	}
+	ssize_t n;
+	do {
+		n = read(stream->fd, stream->buf, TSP_STREAM_CHUNK);
+	} while (n == -1 && errno == EINTR);
+	if (n == -1) {
+		error(("failed to read %s", stream->fpath));
+	}
+	stream->pos = 0;
+	stream->len = n;
+	return n != 0;
+}
+
+/* Reads the next non-negative integer, which may span chunks. Returns EOF
+ * at the end of the file, 0 if the next token is not a number or exceeds
+ * max, and 1 otherwise. */
+int tsp_stream_read_ulong(struct tsp_stream *stream, unsigned long *out, unsigned long max)
+{
+	const unsigned long max_div = max / 10;
+	const unsigned max_mod = max % 10;
+	unsigned long val = 0;
+	size_t n_digits = 0;
+
+	/* Skip whitespace */
+	for (;;) {
+		if (!_stream_fill(stream)) {
+			return EOF;
+		}
+		/* Local copies, because stores through char pointers alias everything */
+		const char *pos = stream->buf + stream->pos;
+		const char *const end = stream->buf + stream->len;
+		size_t lineno = stream->lineno;
+		for (; pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\t' || *pos == '\r'); pos++) {
+			lineno += *pos == '\n';
+		}
+		stream->lineno = lineno;
+		stream->pos = pos - stream->buf;
+		if (pos < end) {
+			break;
+		}
+	}
+
+	stream->token_lineno = stream->lineno;
+	while (_stream_fill(stream)) {
+		const char *pos = stream->buf + stream->pos;
+		const char *const end = stream->buf + stream->len;
+		for (; pos < end && *pos >= '0' && *pos <= '9'; pos++, n_digits++) {
+			const unsigned digit = *pos - '0';
+			if (val > max_div || (val == max_div && digit > max_mod)) {
+				return 0;
+			}
+			val = val * 10 + digit;
+		}
+		stream->pos = pos - stream->buf;
+		if (pos < end) {
+			break;
+		}
+	}
+	if (n_digits == 0) {
+		return 0;
+	}
+	if (stream->pos < stream->len) {
+		const char c = stream->buf[stream->pos];
+		if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+			return 0;  /* Glued to garbage */
+		}
+	}
+	*out = val;
+	return 1;
+}
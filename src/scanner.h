@@ -0,0 +1,45 @@
+#ifndef TSP_SCANNER_H
+#define TSP_SCANNER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Reads text files in place from a read-only mapping, without copying them
+ * and without going through stdio. */
+struct tsp_scanner {
+	const char *pos;      /* Next unread character */
+	const char *end;      /* One past the last character */
+	size_t lineno;        /* Current line, counting from 1 */
+	size_t token_lineno;  /* Line of the record, token or line read last */
+	const char *fpath;
+	void *map;            /* Mapping of the whole file, or NULL for an empty file */
+	size_t map_size;
+};
+
+/* Reads whitespace-separated numbers from a file through a small fixed
+ * buffer, for files too large to be worth keeping around, even mapped. */
+struct tsp_stream {
+	int fd;
+	char *buf;            /* TSP_STREAM_CHUNK bytes */
+	size_t pos;           /* Next unread byte of buf */
+	size_t len;           /* Number of valid bytes in buf */
+	size_t lineno;        /* Current line, counting from 1 */
+	size_t token_lineno;  /* Line of the number read last */
+	const char *fpath;
+};
+
+
+/* Functions */
+void tsp_scanner_open(struct tsp_scanner *scanner, const char *fpath);
+void tsp_scanner_close(struct tsp_scanner *scanner);
+size_t tsp_scanner_count_lines(const struct tsp_scanner *scanner);
+int tsp_scanner_read_ints(struct tsp_scanner *scanner, int *ints, int n_ints, char sep);
+bool tsp_scanner_read_line(struct tsp_scanner *scanner, const char **line, size_t *len);
+int tsp_scanner_read_ulong(struct tsp_scanner *scanner, unsigned long *out, unsigned long max);
+int tsp_scanner_read_double(struct tsp_scanner *scanner, double *out);
+void tsp_stream_open(struct tsp_stream *stream, const char *fpath);
+void tsp_stream_close(struct tsp_stream *stream);
+int tsp_stream_read_ulong(struct tsp_stream *stream, unsigned long *out, unsigned long max);
+
+
+#endif /* TSP_SCANNER_H */
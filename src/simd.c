@@ -0,0 +1,662 @@
+#include "simd.h"
+#include "helpers.h"
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TSP_SIMD_X86
+#endif
+
+/* Versions of the kernels for one instruction set */
+struct simd_kernels {
+	size_t (*scan_argmin)(const struct tsp_scan *scan, long *min);
+	size_t (*intra_scan_argmin)(const struct tsp_intra_scan *scan, long *min, bool *edges);
+	void (*cycles_sum)(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums);
+	uint32_t (*dist_row)(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+};
+
+/* Private functions */
+void _simd_select(void);
+size_t _scan_argmin_scalar(const struct tsp_scan *scan, long *min);
+size_t _intra_scan_argmin_scalar(const struct tsp_intra_scan *scan, long *min, bool *edges);
+void _cycles_sum_scalar(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums);
+unsigned long _cycle_sum_scalar(const struct tsp_tour *tour, size_t begin, const unsigned *matrix, size_t size, const int *costs);
+uint32_t _dist_row_scalar(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+#ifdef TSP_SIMD_X86
+uint32_t _dist_row_sse42(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+size_t _scan_argmin_avx2(const struct tsp_scan *scan, long *min);
+size_t _intra_scan_argmin_avx2(const struct tsp_intra_scan *scan, long *min, bool *edges);
+void _cycles_sum_avx2(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums);
+void _cycles_sum8_avx2(const struct tsp_tour *const *tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums);
+uint32_t _dist_row_avx2(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+size_t _scan_argmin_avx512(const struct tsp_scan *scan, long *min);
+size_t _intra_scan_argmin_avx512(const struct tsp_intra_scan *scan, long *min, bool *edges);
+uint32_t _dist_row_avx512(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+#endif
+
+
+/* Kernels of each instruction set, indexed by enum tsp_isa. Gathers came with
+ * AVX2, so SSE4.2 only has its own distance rows. Batches of tours are bound
+ * by loading the IDs of each step, which 16 tours wide does not speed up, so
+ * AVX-512 walks them 8 wide. */
+static const struct simd_kernels kernels[TSP_ISA_COUNT] = {
+	{ _scan_argmin_scalar, _intra_scan_argmin_scalar, _cycles_sum_scalar, _dist_row_scalar },
+	#ifdef TSP_SIMD_X86
+	{ _scan_argmin_scalar, _intra_scan_argmin_scalar, _cycles_sum_scalar, _dist_row_sse42 },
+	{ _scan_argmin_avx2, _intra_scan_argmin_avx2, _cycles_sum_avx2, _dist_row_avx2 },
+	{ _scan_argmin_avx512, _intra_scan_argmin_avx512, _cycles_sum_avx2, _dist_row_avx512 },
+	#endif
+};
+
+static const char *const isa_names[TSP_ISA_COUNT] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+/* Instruction set in use, picked at startup by _simd_select */
+static enum tsp_isa active_isa = TSP_ISA_SCALAR;
+static const struct simd_kernels *active = &kernels[TSP_ISA_SCALAR];
+
+/* Best instruction set the CPU (and the OS, for the wider registers)
+ * supports, as reported by cpuid */
+enum tsp_isa tsp_simd_cpu_isa(void)
+{
+	#ifdef TSP_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return TSP_ISA_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return TSP_ISA_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		return TSP_ISA_SSE42;
+	}
+	#endif
+	return TSP_ISA_SCALAR;
+}
+
+/* Switches every kernel to the versions of an instruction set, or of the best
+ * one the CPU supports if it does not support that one. Not thread-safe: meant
+ * for startup and benchmarks. */
+void tsp_simd_set_isa(enum tsp_isa isa)
+{
+	assert(isa < TSP_ISA_COUNT);
+	active_isa = MIN(isa, tsp_simd_cpu_isa());
+	active = &kernels[active_isa];
+}
+
+enum tsp_isa tsp_simd_isa(void)
+{
+	return active_isa;
+}
+
+const char *tsp_simd_isa_name(enum tsp_isa isa)
+{
+	return isa < TSP_ISA_COUNT ? isa_names[isa] : "unknown";
+}
+
+/* Picks the best instruction set of the CPU before main runs, unless
+ * TSP_SIMD_ISA_ENV names another one */
+__attribute__((constructor))
+void _simd_select(void)
+{
+	const enum tsp_isa cpu_isa = tsp_simd_cpu_isa();
+	enum tsp_isa isa = cpu_isa;
+	const char *const env = getenv(TSP_SIMD_ISA_ENV);
+	if (env != NULL && env[0] != '\0') {
+		size_t i = 0;
+		while (i < TSP_ISA_COUNT && strcmp(env, isa_names[i]) != 0) {
+			i++;
+		}
+		if (i == TSP_ISA_COUNT) {
+			warn(("unknown %s=%s, using %s", TSP_SIMD_ISA_ENV, env, isa_names[cpu_isa]));
+		} else if (i > cpu_isa) {
+			warn(("%s=%s is not supported by this CPU, using %s", TSP_SIMD_ISA_ENV, env, isa_names[cpu_isa]));
+		} else {
+			isa = i;
+		}
+	}
+	tsp_simd_set_isa(isa);
+}
+
+/* Position in scan->ids of the ID with the lowest score, which goes to *min.
+ * Of equal scores, the one stored last wins, which is the one with the lowest
+ * index in a tsp_tour. Requires at least one ID. */
+size_t tsp_scan_argmin(const struct tsp_scan *scan, long *min)
+{
+	assert(scan->n_ids != 0);
+	if (scan->stride > TSP_SIMD_MAX_STRIDE) {
+		return _scan_argmin_scalar(scan, min);
+	}
+	return active->scan_argmin(scan, min);
+}
+
+/* Index j of the move with the lowest score, which goes to *min, with *edges
+ * telling whether it is an edge swap. Of equal scores, the lowest j wins, and
+ * at the same j the node swap. Requires begin < end. */
+size_t tsp_intra_scan_argmin(const struct tsp_intra_scan *scan, long *min, bool *edges)
+{
+	assert(scan->begin != 0 && scan->begin < scan->end);
+	return active->intra_scan_argmin(scan, min, edges);
+}
+
+/* Sums of the edges of the cycles formed by each tour, looked up in a
+ * size x size matrix, plus the costs of their nodes if costs is not NULL.
+ * Vector versions walk 8 tours side by side, so that their lookups overlap.
+ * Requires tours of at least one node. */
+void tsp_cycles_sum(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums)
+{
+	if (size > TSP_SIMD_MAX_STRIDE) {
+		_cycles_sum_scalar(tours, n_tours, matrix, size, costs, sums);
+		return;
+	}
+	active->cycles_sum(tours, n_tours, matrix, size, costs, sums);
+}
+
+/* Rounded distances from (x, y) to the n points (xs[i], ys[i]) into out, and
+ * the largest of them. Every version performs exactly the same IEEE
+ * operations as ROUND(euclidean_dist(...)), so the results are identical.
+ * Requires every distance to fit in an int32_t. */
+uint32_t tsp_dist_row(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out)
+{
+	return active->dist_row(x, y, xs, ys, n, out);
+}
+
+size_t _scan_argmin_scalar(const struct tsp_scan *scan, long *min)
+{
+	size_t ret = 0;
+	long lowest = LONG_MAX;
+	for (size_t i = 0; i < scan->n_ids; i++) {
+		const size_t id = scan->ids[i];
+		long score = scan->col1[id * scan->stride];
+		if (scan->col2 != NULL) {
+			score += scan->col2[id * scan->stride];
+		}
+		if (scan->costs != NULL) {
+			score += scan->costs[id];
+		}
+		if (score <= lowest) {
+			ret = i;
+			lowest = score;
+		}
+	}
+	*min = lowest;
+	return ret;
+}
+
+size_t _intra_scan_argmin_scalar(const struct tsp_intra_scan *scan, long *min, bool *edges)
+{
+	size_t ret = scan->begin;
+	long lowest = LONG_MAX;
+	bool lowest_edges = false;
+	for (size_t j = scan->begin; j < scan->end; j++) {
+		const uint32_t id = scan->ids[j];
+		const long shared = (long)scan->row_prev[id] + (long)scan->row[scan->ids[j + 1]] - scan->succ[j];
+		const long edges_score = scan->base_edges + shared;
+		const long nodes_score = scan->base_nodes + shared - scan->succ[j - 1]
+			+ (long)scan->row_next[id] + (long)scan->row[scan->ids[j - 1]];
+		const long score = MIN(nodes_score, edges_score);
+		if (score < lowest) {
+			ret = j;
+			lowest = score;
+			lowest_edges = edges_score < nodes_score;
+		}
+	}
+	*min = lowest;
+	*edges = lowest_edges;
+	return ret;
+}
+
+void _cycles_sum_scalar(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums)
+{
+	for (size_t i = 0; i < n_tours; i++) {
+		sums[i] = _cycle_sum_scalar(tours[i], 0, matrix, size, costs);
+	}
+}
+
+/* Sum of the edges from ids[begin] onwards in memory, the closing edge and
+ * the costs of those nodes */
+unsigned long _cycle_sum_scalar(const struct tsp_tour *tour, size_t begin, const unsigned *matrix, size_t size, const int *costs)
+{
+	assert(tour->size != 0 && begin < tour->size);
+	const tsp_id *const ids = tour->ids;
+	unsigned long ret = 0;
+	for (size_t i = begin; i + 1 < tour->size; i++) {
+		ret += matrix[(size_t)ids[i] * size + ids[i + 1]];
+		if (costs != NULL) {
+			ret += costs[ids[i]];
+		}
+	}
+	if (costs != NULL) {
+		ret += costs[ids[tour->size - 1]];
+	}
+	return ret + matrix[(size_t)ids[tour->size - 1] * size + ids[0]];
+}
+
+uint32_t _dist_row_scalar(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out)
+{
+	uint32_t dist_max = 0;
+	for (size_t i = 0; i < n; i++) {
+		out[i] = ROUND(euclidean_dist(x, y, xs[i], ys[i]));
+		dist_max = MAX(dist_max, out[i]);
+	}
+	return dist_max;
+}
+
+#ifdef TSP_SIMD_X86
+/* 2 distances at a time */
+__attribute__((target("sse4.2")))
+uint32_t _dist_row_sse42(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out)
+{
+	const __m128d vx = _mm_set1_pd(x);
+	const __m128d vy = _mm_set1_pd(y);
+	const __m128d half = _mm_set1_pd(0.5);
+	__m128d vmax = _mm_setzero_pd();
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const __m128d dx = _mm_sub_pd(vx, _mm_loadu_pd(&xs[i]));
+		const __m128d dy = _mm_sub_pd(vy, _mm_loadu_pd(&ys[i]));
+		const __m128d dist = _mm_add_pd(_mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy))), half);
+		_mm_storel_epi64((__m128i*)&out[i], _mm_cvttpd_epi32(dist));
+		vmax = _mm_max_pd(vmax, dist);
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, vmax);
+	const uint32_t dist_max = MAX(lanes[0], lanes[1]);
+	return MAX(dist_max, _dist_row_scalar(x, y, &xs[i], &ys[i], n - i, &out[i]));
+}
+
+/* Gathers 8 IDs at a time. Scores are summed in 64-bit lanes, so that
+ * distances of any size add up without overflow. */
+__attribute__((target("avx2")))
+size_t _scan_argmin_avx2(const struct tsp_scan *scan, long *min)
+{
+	const size_t n_vec = scan->n_ids / 8 * 8;
+	const __m256i stride = _mm256_set1_epi32(scan->stride);
+	const __m256i step = _mm256_set1_epi64x(8);
+	__m256i lowest_lo = _mm256_set1_epi64x(LONG_MAX);
+	__m256i lowest_hi = lowest_lo;
+	__m256i pos_lo = _mm256_setr_epi64x(0, 1, 2, 3);
+	__m256i pos_hi = _mm256_setr_epi64x(4, 5, 6, 7);
+	__m256i best_lo = pos_lo;
+	__m256i best_hi = pos_hi;
+
+	for (size_t i = 0; i < n_vec; i += 8) {
+		#ifdef TSP_TOUR_ID16
+		const __m256i ids = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&scan->ids[i]));
+		#else
+		const __m256i ids = _mm256_loadu_si256((const __m256i*)&scan->ids[i]);
+		#endif
+		const __m256i idx = scan->stride == 1 ? ids : _mm256_mullo_epi32(ids, stride);
+		const __m256i terms1 = _mm256_i32gather_epi32((const int*)scan->col1, idx, 4);
+		__m256i score_lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(terms1));
+		__m256i score_hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(terms1, 1));
+		if (scan->col2 != NULL) {
+			const __m256i terms2 = _mm256_i32gather_epi32((const int*)scan->col2, idx, 4);
+			score_lo = _mm256_add_epi64(score_lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(terms2)));
+			score_hi = _mm256_add_epi64(score_hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(terms2, 1)));
+		}
+		if (scan->costs != NULL) {
+			const __m256i costs = _mm256_i32gather_epi32(scan->costs, ids, 4);
+			score_lo = _mm256_add_epi64(score_lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(costs)));
+			score_hi = _mm256_add_epi64(score_hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(costs, 1)));
+		}
+
+		/* Later positions win ties, as in the scalar version */
+		const __m256i keep_lo = _mm256_cmpgt_epi64(score_lo, lowest_lo);
+		const __m256i keep_hi = _mm256_cmpgt_epi64(score_hi, lowest_hi);
+		lowest_lo = _mm256_blendv_epi8(score_lo, lowest_lo, keep_lo);
+		lowest_hi = _mm256_blendv_epi8(score_hi, lowest_hi, keep_hi);
+		best_lo = _mm256_blendv_epi8(pos_lo, best_lo, keep_lo);
+		best_hi = _mm256_blendv_epi8(pos_hi, best_hi, keep_hi);
+		pos_lo = _mm256_add_epi64(pos_lo, step);
+		pos_hi = _mm256_add_epi64(pos_hi, step);
+	}
+
+	/* Reduce the lanes, then finish the remaining IDs */
+	long lowest = LONG_MAX;
+	size_t ret = 0;
+	if (n_vec != 0) {
+		int64_t lanes[8], lane_pos[8];
+		_mm256_storeu_si256((__m256i*)&lanes[0], lowest_lo);
+		_mm256_storeu_si256((__m256i*)&lanes[4], lowest_hi);
+		_mm256_storeu_si256((__m256i*)&lane_pos[0], best_lo);
+		_mm256_storeu_si256((__m256i*)&lane_pos[4], best_hi);
+		for (int i = 0; i < 8; i++) {
+			if (lanes[i] < lowest || (lanes[i] == lowest && (size_t)lane_pos[i] > ret)) {
+				lowest = lanes[i];
+				ret = lane_pos[i];
+			}
+		}
+	}
+	if (n_vec != scan->n_ids) {
+		struct tsp_scan tail = *scan;
+		long tail_lowest;
+		tail.ids += n_vec;
+		tail.n_ids -= n_vec;
+		const size_t tail_ret = _scan_argmin_scalar(&tail, &tail_lowest);
+		if (tail_lowest <= lowest) {
+			lowest = tail_lowest;
+			ret = n_vec + tail_ret;
+		}
+	}
+	*min = lowest;
+	return ret;
+}
+
+/* Scores 4 indices at a time in 64-bit lanes. The gathers share their
+ * offsets: ids[j - 1], ids[j] and ids[j + 1] are three overlapping loads. */
+__attribute__((target("avx2")))
+size_t _intra_scan_argmin_avx2(const struct tsp_intra_scan *scan, long *min, bool *edges)
+{
+	const __m256i base_nodes = _mm256_set1_epi64x(scan->base_nodes);
+	const __m256i base_edges = _mm256_set1_epi64x(scan->base_edges);
+	const __m256i step = _mm256_set1_epi64x(4);
+	__m256i lowest = _mm256_set1_epi64x(LONG_MAX);
+	__m256i pos = _mm256_setr_epi64x(scan->begin, scan->begin + 1, scan->begin + 2, scan->begin + 3);
+	__m256i best = pos;
+	__m256i best_edges = _mm256_setzero_si256();
+
+	size_t j = scan->begin;
+	for (; j + 4 <= scan->end; j += 4) {
+		const __m128i ids = _mm_loadu_si128((const __m128i*)&scan->ids[j]);
+		const __m128i ids_before = _mm_loadu_si128((const __m128i*)&scan->ids[j - 1]);
+		const __m128i ids_after = _mm_loadu_si128((const __m128i*)&scan->ids[j + 1]);
+		const __m256i to_prev = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)scan->row_prev, ids, 4));
+		const __m256i to_next = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)scan->row_next, ids, 4));
+		const __m256i before = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)scan->row, ids_before, 4));
+		const __m256i after = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)scan->row, ids_after, 4));
+		const __m256i succ_before = _mm256_loadu_si256((const __m256i*)&scan->succ[j - 1]);
+		const __m256i succ = _mm256_loadu_si256((const __m256i*)&scan->succ[j]);
+
+		const __m256i shared = _mm256_sub_epi64(_mm256_add_epi64(to_prev, after), succ);
+		const __m256i edges_score = _mm256_add_epi64(base_edges, shared);
+		const __m256i nodes_score = _mm256_add_epi64(_mm256_add_epi64(base_nodes, shared),
+			_mm256_sub_epi64(_mm256_add_epi64(to_next, before), succ_before));
+		const __m256i is_edges = _mm256_cmpgt_epi64(nodes_score, edges_score);
+		const __m256i score = _mm256_blendv_epi8(nodes_score, edges_score, is_edges);
+
+		/* Earlier indices win ties, as in the scalar version */
+		const __m256i better = _mm256_cmpgt_epi64(lowest, score);
+		lowest = _mm256_blendv_epi8(lowest, score, better);
+		best = _mm256_blendv_epi8(best, pos, better);
+		best_edges = _mm256_blendv_epi8(best_edges, is_edges, better);
+		pos = _mm256_add_epi64(pos, step);
+	}
+
+	/* Reduce the lanes, then finish the remaining indices */
+	long ret_lowest = LONG_MAX;
+	size_t ret = scan->begin;
+	bool ret_edges = false;
+	if (j != scan->begin) {
+		int64_t lanes[4], lane_pos[4], lane_edges[4];
+		_mm256_storeu_si256((__m256i*)lanes, lowest);
+		_mm256_storeu_si256((__m256i*)lane_pos, best);
+		_mm256_storeu_si256((__m256i*)lane_edges, best_edges);
+		for (int i = 0; i < 4; i++) {
+			if (lanes[i] < ret_lowest || (lanes[i] == ret_lowest && (size_t)lane_pos[i] < ret)) {
+				ret_lowest = lanes[i];
+				ret = lane_pos[i];
+				ret_edges = lane_edges[i] != 0;
+			}
+		}
+	}
+	if (j != scan->end) {
+		struct tsp_intra_scan tail = *scan;
+		long tail_lowest;
+		bool tail_edges;
+		tail.begin = j;
+		const size_t tail_ret = _intra_scan_argmin_scalar(&tail, &tail_lowest, &tail_edges);
+		if (tail_lowest < ret_lowest) {
+			ret_lowest = tail_lowest;
+			ret = tail_ret;
+			ret_edges = tail_edges;
+		}
+	}
+	*min = ret_lowest;
+	*edges = ret_edges;
+	return ret;
+}
+
+__attribute__((target("avx2")))
+void _cycles_sum_avx2(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_tours; i += 8) {
+		_cycles_sum8_avx2(&tours[i], matrix, size, costs, &sums[i]);
+	}
+	_cycles_sum_scalar(&tours[i], n_tours - i, matrix, size, costs, &sums[i]);
+}
+
+/* Walks 8 tours side by side for as long as the shortest of them, then
+ * finishes each one on its own */
+__attribute__((target("avx2")))
+void _cycles_sum8_avx2(const struct tsp_tour *const *tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums)
+{
+	const tsp_id *ids[8];
+	size_t n_steps = SIZE_MAX;
+	for (int k = 0; k < 8; k++) {
+		ids[k] = tours[k]->ids;
+		n_steps = MIN(n_steps, tours[k]->size - 1);
+	}
+	const __m256i stride = _mm256_set1_epi32(size);
+	__m256i sum_lo = _mm256_setzero_si256();
+	__m256i sum_hi = _mm256_setzero_si256();
+	__m256i prev = _mm256_setr_epi32(ids[0][0], ids[1][0], ids[2][0], ids[3][0],
+		ids[4][0], ids[5][0], ids[6][0], ids[7][0]);
+
+	for (size_t i = 1; i <= n_steps; i++) {
+		const __m256i cur = _mm256_setr_epi32(ids[0][i], ids[1][i], ids[2][i], ids[3][i],
+			ids[4][i], ids[5][i], ids[6][i], ids[7][i]);
+		const __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(prev, stride), cur);
+		const __m256i dists = _mm256_i32gather_epi32((const int*)matrix, idx, 4);
+		sum_lo = _mm256_add_epi64(sum_lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(dists)));
+		sum_hi = _mm256_add_epi64(sum_hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(dists, 1)));
+		if (costs != NULL) {
+			const __m256i prev_costs = _mm256_i32gather_epi32(costs, prev, 4);
+			sum_lo = _mm256_add_epi64(sum_lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(prev_costs)));
+			sum_hi = _mm256_add_epi64(sum_hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(prev_costs, 1)));
+		}
+		prev = cur;
+	}
+
+	int64_t lanes[8];
+	_mm256_storeu_si256((__m256i*)&lanes[0], sum_lo);
+	_mm256_storeu_si256((__m256i*)&lanes[4], sum_hi);
+	for (int k = 0; k < 8; k++) {
+		sums[k] = lanes[k] + _cycle_sum_scalar(tours[k], n_steps, matrix, size, costs);
+	}
+}
+
+/* 4 distances at a time */
+__attribute__((target("avx2")))
+uint32_t _dist_row_avx2(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out)
+{
+	const __m256d vx = _mm256_set1_pd(x);
+	const __m256d vy = _mm256_set1_pd(y);
+	const __m256d half = _mm256_set1_pd(0.5);
+	__m256d vmax = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d dx = _mm256_sub_pd(vx, _mm256_loadu_pd(&xs[i]));
+		const __m256d dy = _mm256_sub_pd(vy, _mm256_loadu_pd(&ys[i]));
+		const __m256d dist = _mm256_add_pd(_mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))), half);
+		_mm_storeu_si128((__m128i*)&out[i], _mm256_cvttpd_epi32(dist));
+		vmax = _mm256_max_pd(vmax, dist);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, vmax);
+	const uint32_t dist_max = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+	return MAX(dist_max, _dist_row_scalar(x, y, &xs[i], &ys[i], n - i, &out[i]));
+}
+
+/* Gathers 16 IDs at a time, see _scan_argmin_avx2 */
+__attribute__((target("avx512f")))
+size_t _scan_argmin_avx512(const struct tsp_scan *scan, long *min)
+{
+	const size_t n_vec = scan->n_ids / 16 * 16;
+	const __m512i stride = _mm512_set1_epi32(scan->stride);
+	const __m512i step = _mm512_set1_epi64(16);
+	__m512i lowest_lo = _mm512_set1_epi64(LONG_MAX);
+	__m512i lowest_hi = lowest_lo;
+	__m512i pos_lo = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+	__m512i pos_hi = _mm512_setr_epi64(8, 9, 10, 11, 12, 13, 14, 15);
+	__m512i best_lo = pos_lo;
+	__m512i best_hi = pos_hi;
+
+	for (size_t i = 0; i < n_vec; i += 16) {
+		#ifdef TSP_TOUR_ID16
+		const __m512i ids = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)&scan->ids[i]));
+		#else
+		const __m512i ids = _mm512_loadu_si512(&scan->ids[i]);
+		#endif
+		const __m512i idx = scan->stride == 1 ? ids : _mm512_mullo_epi32(ids, stride);
+		const __m512i terms1 = _mm512_i32gather_epi32(idx, scan->col1, 4);
+		__m512i score_lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(terms1));
+		__m512i score_hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(terms1, 1));
+		if (scan->col2 != NULL) {
+			const __m512i terms2 = _mm512_i32gather_epi32(idx, scan->col2, 4);
+			score_lo = _mm512_add_epi64(score_lo, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(terms2)));
+			score_hi = _mm512_add_epi64(score_hi, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(terms2, 1)));
+		}
+		if (scan->costs != NULL) {
+			const __m512i costs = _mm512_i32gather_epi32(ids, scan->costs, 4);
+			score_lo = _mm512_add_epi64(score_lo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(costs)));
+			score_hi = _mm512_add_epi64(score_hi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(costs, 1)));
+		}
+
+		/* Later positions win ties, as in the scalar version */
+		const __mmask8 keep_lo = _mm512_cmpgt_epi64_mask(score_lo, lowest_lo);
+		const __mmask8 keep_hi = _mm512_cmpgt_epi64_mask(score_hi, lowest_hi);
+		lowest_lo = _mm512_mask_blend_epi64(keep_lo, score_lo, lowest_lo);
+		lowest_hi = _mm512_mask_blend_epi64(keep_hi, score_hi, lowest_hi);
+		best_lo = _mm512_mask_blend_epi64(keep_lo, pos_lo, best_lo);
+		best_hi = _mm512_mask_blend_epi64(keep_hi, pos_hi, best_hi);
+		pos_lo = _mm512_add_epi64(pos_lo, step);
+		pos_hi = _mm512_add_epi64(pos_hi, step);
+	}
+
+	/* Reduce the lanes, then finish the remaining IDs */
+	long lowest = LONG_MAX;
+	size_t ret = 0;
+	if (n_vec != 0) {
+		int64_t lanes[16], lane_pos[16];
+		_mm512_storeu_si512(&lanes[0], lowest_lo);
+		_mm512_storeu_si512(&lanes[8], lowest_hi);
+		_mm512_storeu_si512(&lane_pos[0], best_lo);
+		_mm512_storeu_si512(&lane_pos[8], best_hi);
+		for (int i = 0; i < 16; i++) {
+			if (lanes[i] < lowest || (lanes[i] == lowest && (size_t)lane_pos[i] > ret)) {
+				lowest = lanes[i];
+				ret = lane_pos[i];
+			}
+		}
+	}
+	if (n_vec != scan->n_ids) {
+		struct tsp_scan tail = *scan;
+		long tail_lowest;
+		tail.ids += n_vec;
+		tail.n_ids -= n_vec;
+		const size_t tail_ret = _scan_argmin_scalar(&tail, &tail_lowest);
+		if (tail_lowest <= lowest) {
+			lowest = tail_lowest;
+			ret = n_vec + tail_ret;
+		}
+	}
+	*min = lowest;
+	return ret;
+}
+
+/* Scores 8 indices at a time, see _intra_scan_argmin_avx2 */
+__attribute__((target("avx512f")))
+size_t _intra_scan_argmin_avx512(const struct tsp_intra_scan *scan, long *min, bool *edges)
+{
+	const __m512i base_nodes = _mm512_set1_epi64(scan->base_nodes);
+	const __m512i base_edges = _mm512_set1_epi64(scan->base_edges);
+	const __m512i step = _mm512_set1_epi64(8);
+	const __m512i ones = _mm512_set1_epi64(1);
+	__m512i lowest = _mm512_set1_epi64(LONG_MAX);
+	__m512i pos = _mm512_add_epi64(_mm512_set1_epi64(scan->begin), _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7));
+	__m512i best = pos;
+	__m512i best_edges = _mm512_setzero_si512();
+
+	size_t j = scan->begin;
+	for (; j + 8 <= scan->end; j += 8) {
+		const __m256i ids = _mm256_loadu_si256((const __m256i*)&scan->ids[j]);
+		const __m256i ids_before = _mm256_loadu_si256((const __m256i*)&scan->ids[j - 1]);
+		const __m256i ids_after = _mm256_loadu_si256((const __m256i*)&scan->ids[j + 1]);
+		const __m512i to_prev = _mm512_cvtepu32_epi64(_mm256_i32gather_epi32((const int*)scan->row_prev, ids, 4));
+		const __m512i to_next = _mm512_cvtepu32_epi64(_mm256_i32gather_epi32((const int*)scan->row_next, ids, 4));
+		const __m512i before = _mm512_cvtepu32_epi64(_mm256_i32gather_epi32((const int*)scan->row, ids_before, 4));
+		const __m512i after = _mm512_cvtepu32_epi64(_mm256_i32gather_epi32((const int*)scan->row, ids_after, 4));
+		const __m512i succ_before = _mm512_loadu_si512(&scan->succ[j - 1]);
+		const __m512i succ = _mm512_loadu_si512(&scan->succ[j]);
+
+		const __m512i shared = _mm512_sub_epi64(_mm512_add_epi64(to_prev, after), succ);
+		const __m512i edges_score = _mm512_add_epi64(base_edges, shared);
+		const __m512i nodes_score = _mm512_add_epi64(_mm512_add_epi64(base_nodes, shared),
+			_mm512_sub_epi64(_mm512_add_epi64(to_next, before), succ_before));
+		const __mmask8 is_edges = _mm512_cmpgt_epi64_mask(nodes_score, edges_score);
+		const __m512i score = _mm512_mask_blend_epi64(is_edges, nodes_score, edges_score);
+
+		/* Earlier indices win ties, as in the scalar version */
+		const __mmask8 better = _mm512_cmpgt_epi64_mask(lowest, score);
+		lowest = _mm512_mask_blend_epi64(better, lowest, score);
+		best = _mm512_mask_blend_epi64(better, best, pos);
+		best_edges = _mm512_mask_blend_epi64(better, best_edges, _mm512_maskz_mov_epi64(is_edges, ones));
+		pos = _mm512_add_epi64(pos, step);
+	}
+
+	/* Reduce the lanes, then finish the remaining indices */
+	long ret_lowest = LONG_MAX;
+	size_t ret = scan->begin;
+	bool ret_edges = false;
+	if (j != scan->begin) {
+		int64_t lanes[8], lane_pos[8], lane_edges[8];
+		_mm512_storeu_si512(lanes, lowest);
+		_mm512_storeu_si512(lane_pos, best);
+		_mm512_storeu_si512(lane_edges, best_edges);
+		for (int i = 0; i < 8; i++) {
+			if (lanes[i] < ret_lowest || (lanes[i] == ret_lowest && (size_t)lane_pos[i] < ret)) {
+				ret_lowest = lanes[i];
+				ret = lane_pos[i];
+				ret_edges = lane_edges[i] != 0;
+			}
+		}
+	}
+	if (j != scan->end) {
+		struct tsp_intra_scan tail = *scan;
+		long tail_lowest;
+		bool tail_edges;
+		tail.begin = j;
+		const size_t tail_ret = _intra_scan_argmin_scalar(&tail, &tail_lowest, &tail_edges);
+		if (tail_lowest < ret_lowest) {
+			ret_lowest = tail_lowest;
+			ret = tail_ret;
+			ret_edges = tail_edges;
+		}
+	}
+	*min = ret_lowest;
+	*edges = ret_edges;
+	return ret;
+}
+
+/* 8 distances at a time */
+__attribute__((target("avx512f")))
+uint32_t _dist_row_avx512(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out)
+{
+	const __m512d vx = _mm512_set1_pd(x);
+	const __m512d vy = _mm512_set1_pd(y);
+	const __m512d half = _mm512_set1_pd(0.5);
+	__m512d vmax = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d dx = _mm512_sub_pd(vx, _mm512_loadu_pd(&xs[i]));
+		const __m512d dy = _mm512_sub_pd(vy, _mm512_loadu_pd(&ys[i]));
+		const __m512d dist = _mm512_add_pd(_mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy))), half);
+		_mm256_storeu_si256((__m256i*)&out[i], _mm512_cvttpd_epi32(dist));
+		vmax = _mm512_max_pd(vmax, dist);
+	}
+	const uint32_t dist_max = _mm512_reduce_max_pd(vmax);
+	return MAX(dist_max, _dist_row_scalar(x, y, &xs[i], &ys[i], n - i, &out[i]));
+}
+#endif /* TSP_SIMD_X86 */
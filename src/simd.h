@@ -0,0 +1,72 @@
+#ifndef TSP_SIMD_H
+#define TSP_SIMD_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "tour.h"
+
+/* Environment variable that overrides the instruction set picked at startup,
+ * set to one of the names of tsp_simd_isa_name (e.g. TSP_ISA=scalar) */
+#define TSP_SIMD_ISA_ENV "TSP_ISA"
+
+/* Instruction sets the kernels are compiled for, each a superset of the
+ * previous one */
+enum tsp_isa {
+	TSP_ISA_SCALAR,
+	TSP_ISA_SSE42,
+	TSP_ISA_AVX2,
+	TSP_ISA_AVX512,
+	TSP_ISA_COUNT,
+};
+
+/* Gathers at indices id * stride must fit in 32 bits, so strided scans of
+ * larger matrices take the scalar path */
+#define TSP_SIMD_MAX_STRIDE 46340
+
+/* Scan of an array of node IDs, scoring each ID as
+ *     col1[id * stride] + col2[id * stride] + costs[id]
+ * where col2 and costs may be NULL. With col1 pointing at a row of a dense
+ * matrix and a stride of 1, the terms are distances from a fixed node; with
+ * col1 pointing at a column and a stride of the matrix size, distances to it. */
+struct tsp_scan {
+	const tsp_id *ids;
+	size_t n_ids;
+	const unsigned *col1;
+	const unsigned *col2;
+	const int *costs;
+	size_t stride;
+};
+
+/* Row of intra-route moves of the node at index i of a route, over indices j
+ * in [begin, end) that are not adjacent to i. Swapping the nodes at i and j
+ * scores
+ *     base_nodes - succ[j - 1] - succ[j] + row_prev[ids[j]] + row_next[ids[j]]
+ *         + row[ids[j - 1]] + row[ids[j + 1]]
+ * and reversing the route between them (an edge swap) scores
+ *     base_edges - succ[j] + row[ids[j + 1]] + row_prev[ids[j]]
+ * where ids lists the route in index order, followed by ids[0], succ[k] is
+ * the length of the edge from index k to k + 1, and row, row_prev and
+ * row_next are the rows of the matrix of the nodes at i, i - 1 and i + 1. */
+struct tsp_intra_scan {
+	const uint32_t *ids;
+	const int64_t *succ;
+	const unsigned *row;
+	const unsigned *row_prev;
+	const unsigned *row_next;
+	long base_nodes;
+	long base_edges;
+	size_t begin;
+	size_t end;
+};
+
+enum tsp_isa tsp_simd_cpu_isa(void);
+void tsp_simd_set_isa(enum tsp_isa isa);
+enum tsp_isa tsp_simd_isa(void);
+const char *tsp_simd_isa_name(enum tsp_isa isa);
+size_t tsp_scan_argmin(const struct tsp_scan *scan, long *min);
+size_t tsp_intra_scan_argmin(const struct tsp_intra_scan *scan, long *min, bool *edges);
+void tsp_cycles_sum(const struct tsp_tour *const *tours, size_t n_tours, const unsigned *matrix, size_t size, const int *costs, unsigned long *sums);
+uint32_t tsp_dist_row(double x, double y, const double *xs, const double *ys, size_t n, unsigned *out);
+
+#endif /* TSP_SIMD_H */
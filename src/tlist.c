@@ -0,0 +1,347 @@
+#include "tlist.h"
+#include "helpers.h"
+#include <math.h>
+#include <string.h>
+
+/* Private functions */
+void _tlist_build(struct tsp_tlist *list, const tsp_id *ids);
+void _tlist_rebuild(struct tsp_tlist *list);
+size_t _tlist_find_rank(const struct tsp_tlist *list, size_t idx);
+void _tlist_split(struct tsp_tlist *list, size_t rank, size_t k);
+void _tlist_split_before(struct tsp_tlist *list, size_t idx);
+size_t _tlist_raw(const struct tsp_tlist *list, size_t idx, size_t *segment);
+
+
+/* Creates a two-level list holding the same route as a tour */
+struct tsp_tlist *tsp_tlist_create(const struct tsp_tour *tour)
+{
+	assert(tour->size != 0);
+	struct tsp_tlist *const list = malloc_or_die(sizeof(struct tsp_tlist));
+	const size_t n = tour->size;
+	list->size = n;
+	list->seg_capacity = MAX(1, (size_t)ceil(sqrt((double)n)));
+	/* Splits add at most 2 segments per move, the list is rebuilt when full */
+	list->max_segments = 2 * ((n + list->seg_capacity - 1) / list->seg_capacity) + 4;
+	list->segments = malloc_or_die(list->max_segments * sizeof(struct tsp_tlist_segment));
+	list->buf = malloc_or_die(list->max_segments * list->seg_capacity * sizeof(tsp_id));
+	list->order = malloc_or_die(list->max_segments * sizeof(size_t));
+	list->start = malloc_or_die((list->max_segments + 1) * sizeof(size_t));
+	list->rank = malloc_or_die(list->max_segments * sizeof(size_t));
+	list->n_ids = 0;
+	for (size_t i = 0; i < n; i++) {
+		list->n_ids = MAX(list->n_ids, (size_t)tour->ids[i] + 1);
+	}
+	list->parent = malloc_or_die(list->n_ids * sizeof(uint32_t));
+	list->offset = malloc_or_die(list->n_ids * sizeof(uint32_t));
+
+	tsp_id *const ids = malloc_or_die(n * sizeof(tsp_id));
+	for (size_t i = 0; i < n; i++) {
+		ids[i] = tsp_tour_get(tour, i);
+	}
+	_tlist_build(list, ids);
+	free(ids);
+	return list;
+}
+
+/* Replaces the contents of a tour with the route of a list */
+void tsp_tlist_to_tour(const struct tsp_tlist *list, struct tsp_tour *tour)
+{
+	tsp_tour_clear(tour);
+	for (size_t i = list->size; i-- > 0;) {
+		tsp_tour_push(tour, tsp_tlist_get(list, i));
+	}
+}
+
+void tsp_tlist_destroy(struct tsp_tlist *list)
+{
+	free(list->segments);
+	free(list->buf);
+	free(list->order);
+	free(list->start);
+	free(list->rank);
+	free(list->parent);
+	free(list->offset);
+	free(list);
+}
+
+/* Whether a route of n_nodes should be kept as a two-level list. None of the
+ * tasks switches on it: their routes stay far below TSP_TLIST_MIN_NODES. */
+bool tsp_tlist_preferred(size_t n_nodes)
+{
+	return n_nodes >= TSP_TLIST_MIN_NODES;
+}
+
+tsp_id tsp_tlist_get(const struct tsp_tlist *list, size_t idx)
+{
+	size_t segment;
+	const size_t raw = _tlist_raw(list, idx, &segment);
+	return list->segments[segment].ids[raw];
+}
+
+size_t tsp_tlist_index_of(const struct tsp_tlist *list, unsigned id)
+{
+	assert(id < list->n_ids);
+	const size_t s = list->parent[id];
+	const struct tsp_tlist_segment *const seg = &list->segments[s];
+	const size_t k = seg->reversed ? seg->size - 1 - list->offset[id] : list->offset[id];
+	return list->start[list->rank[s]] + k;
+}
+
+tsp_id tsp_tlist_next(const struct tsp_tlist *list, unsigned id)
+{
+	const struct tsp_tlist_segment *seg = &list->segments[list->parent[id]];
+	const size_t raw = list->offset[id];
+	if (!seg->reversed && raw + 1 < seg->size) {
+		return seg->ids[raw + 1];
+	}
+	if (seg->reversed && raw > 0) {
+		return seg->ids[raw - 1];
+	}
+	/* First node of the following segment */
+	const size_t rank = (list->rank[list->parent[id]] + 1) % list->n_segments;
+	seg = &list->segments[list->order[rank]];
+	return seg->reversed ? seg->ids[seg->size - 1] : seg->ids[0];
+}
+
+tsp_id tsp_tlist_prev(const struct tsp_tlist *list, unsigned id)
+{
+	const struct tsp_tlist_segment *seg = &list->segments[list->parent[id]];
+	const size_t raw = list->offset[id];
+	if (!seg->reversed && raw > 0) {
+		return seg->ids[raw - 1];
+	}
+	if (seg->reversed && raw + 1 < seg->size) {
+		return seg->ids[raw + 1];
+	}
+	/* Last node of the preceding segment */
+	const size_t rank = (list->rank[list->parent[id]] + list->n_segments - 1) % list->n_segments;
+	seg = &list->segments[list->order[rank]];
+	return seg->reversed ? seg->ids[0] : seg->ids[seg->size - 1];
+}
+
+/* Whether b is visited on the way from a to c, following the route */
+bool tsp_tlist_between(const struct tsp_tlist *list, unsigned a, unsigned b, unsigned c)
+{
+	const size_t n = list->size;
+	const size_t ia = tsp_tlist_index_of(list, a);
+	const size_t ib = tsp_tlist_index_of(list, b);
+	const size_t ic = tsp_tlist_index_of(list, c);
+	return (ib + n - ia) % n <= (ic + n - ia) % n;
+}
+
+void tsp_tlist_swap_nodes(struct tsp_tlist *list, size_t idx1, size_t idx2)
+{
+	size_t s1, s2;
+	const size_t raw1 = _tlist_raw(list, idx1, &s1);
+	const size_t raw2 = _tlist_raw(list, idx2, &s2);
+	const tsp_id id1 = list->segments[s1].ids[raw1];
+	const tsp_id id2 = list->segments[s2].ids[raw2];
+	list->segments[s1].ids[raw1] = id2;
+	list->segments[s2].ids[raw2] = id1;
+	list->parent[id1] = s2;
+	list->offset[id1] = raw2;
+	list->parent[id2] = s1;
+	list->offset[id2] = raw1;
+}
+
+/* Reverses the nodes at indices idx1..idx2, like tsp_nodes_swap_edges */
+void tsp_tlist_swap_edges(struct tsp_tlist *list, size_t idx1, size_t idx2)
+{
+	/* Make sure idx1 < idx2 */
+	if (idx1 > idx2) {
+		const size_t tmp = idx1;
+		idx1 = idx2;
+		idx2 = tmp;
+	}
+	if (idx1 == idx2) {
+		return;
+	}
+	if (list->n_segments + 2 > list->max_segments) {
+		_tlist_rebuild(list);
+	}
+
+	/* Cut the range out into whole segments */
+	_tlist_split_before(list, idx1);
+	if (idx2 + 1 < list->size) {
+		_tlist_split_before(list, idx2 + 1);
+	}
+	const size_t first = _tlist_find_rank(list, idx1);
+	const size_t last = _tlist_find_rank(list, idx2);
+
+	/* Reverse their order and flip each of them */
+	for (size_t lo = first, hi = last; lo < hi; lo++, hi--) {
+		const size_t tmp = list->order[lo];
+		list->order[lo] = list->order[hi];
+		list->order[hi] = tmp;
+	}
+	for (size_t r = first; r <= last; r++) {
+		struct tsp_tlist_segment *const seg = &list->segments[list->order[r]];
+		seg->reversed = !seg->reversed;
+		list->rank[list->order[r]] = r;
+		list->start[r + 1] = list->start[r] + seg->size;
+	}
+}
+
+unsigned long tsp_tlist_evaluate(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix)
+{
+	unsigned long score = 0;
+	unsigned id = tsp_tlist_get(list, 0);
+	for (size_t i = 0; i < list->size; i++) {
+		const unsigned next_id = tsp_tlist_next(list, id);
+		if (matrix->weights != NULL) {
+			score += mweight(id, next_id, matrix);
+		} else {
+			score += mcost(id, matrix) + mdist(id, next_id, matrix);
+		}
+		id = next_id;
+	}
+	return matrix->weights != NULL ? score / 2 : score;
+}
+
+long tsp_tlist_evaluate_swap_nodes(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
+{
+	const unsigned n1 = tsp_tlist_get(list, idx1);
+	const unsigned n2 = tsp_tlist_get(list, idx2);
+	const unsigned n1_prev = tsp_tlist_prev(list, n1);
+	const unsigned n1_next = tsp_tlist_next(list, n1);
+	const unsigned n2_prev = tsp_tlist_prev(list, n2);
+	const unsigned n2_next = tsp_tlist_next(list, n2);
+	return
+		- mdist(n1, n1_prev, matrix)
+		- mdist(n1, n1_next, matrix)
+		- mdist(n2, n2_prev, matrix)
+		- mdist(n2, n2_next, matrix)
+		+ mdist(n2, n1_prev != n2 ? n1_prev : n1, matrix)
+		+ mdist(n2, n1_next != n2 ? n1_next : n1, matrix)
+		+ mdist(n1, n2_prev != n1 ? n2_prev : n2, matrix)
+		+ mdist(n1, n2_next != n1 ? n2_next : n2, matrix);
+}
+
+long tsp_tlist_evaluate_swap_edges(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2)
+{
+	/* Make sure idx1 < idx2 */
+	if (idx1 > idx2) {
+		const size_t tmp = idx1;
+		idx1 = idx2;
+		idx2 = tmp;
+	}
+
+	const unsigned n1 = tsp_tlist_get(list, idx1);
+	const unsigned n2 = tsp_tlist_get(list, idx2);
+	const unsigned n1_prev = tsp_tlist_prev(list, n1);
+	const unsigned n2_next = tsp_tlist_next(list, n2);
+	return
+		- mdist(n1, n1_prev, matrix)
+		- mdist(n2, n2_next, matrix)
+		+ mdist(n1, n2_next != n1 ? n2_next : n2, matrix)
+		+ mdist(n2, n1_prev != n2 ? n1_prev : n1, matrix);
+}
+
+/* Lays out a route given in index order into full segments */
+void _tlist_build(struct tsp_tlist *list, const tsp_id *ids)
+{
+	const size_t cap = list->seg_capacity;
+	list->n_segments = (list->size + cap - 1) / cap;
+	for (size_t s = 0; s < list->n_segments; s++) {
+		struct tsp_tlist_segment *const seg = &list->segments[s];
+		seg->ids = list->buf + s * cap;
+		seg->size = MIN(cap, list->size - s * cap);
+		seg->reversed = false;
+		memcpy(seg->ids, ids + s * cap, seg->size * sizeof(tsp_id));
+		for (size_t i = 0; i < seg->size; i++) {
+			list->parent[seg->ids[i]] = s;
+			list->offset[seg->ids[i]] = i;
+		}
+		list->order[s] = s;
+		list->rank[s] = s;
+		list->start[s] = s * cap;
+	}
+	list->start[list->n_segments] = list->size;
+}
+
+/* Merges the segments left over by splits back into full ones. Called once
+ * every max_segments/2 moves or so, which keeps its O(n) cost amortized to
+ * O(sqrt(n)) per move. */
+void _tlist_rebuild(struct tsp_tlist *list)
+{
+	tsp_id *const ids = malloc_or_die(list->size * sizeof(tsp_id));
+	size_t n = 0;
+	for (size_t r = 0; r < list->n_segments; r++) {
+		const struct tsp_tlist_segment *const seg = &list->segments[list->order[r]];
+		for (size_t k = 0; k < seg->size; k++) {
+			ids[n++] = seg->ids[seg->reversed ? seg->size - 1 - k : k];
+		}
+	}
+	assert(n == list->size);
+	_tlist_build(list, ids);
+	free(ids);
+}
+
+/* Position in order of the segment holding index idx */
+size_t _tlist_find_rank(const struct tsp_tlist *list, size_t idx)
+{
+	assert(idx < list->size);
+	size_t lo = 0;
+	size_t hi = list->n_segments;
+	while (hi - lo > 1) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (list->start[mid] <= idx) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/* Splits the segment at position rank in order after its first k nodes.
+ * The nodes stored last move to a new segment, which goes after the old one,
+ * or before it if the old one is reversed. */
+void _tlist_split(struct tsp_tlist *list, size_t rank, size_t k)
+{
+	assert(list->n_segments < list->max_segments);
+	const size_t s = list->order[rank];
+	struct tsp_tlist_segment *const seg = &list->segments[s];
+	assert(k > 0 && k < seg->size);
+
+	const size_t t = list->n_segments++;
+	struct tsp_tlist_segment *const new_seg = &list->segments[t];
+	const size_t n_moved = seg->reversed ? k : seg->size - k;
+	new_seg->ids = list->buf + t * list->seg_capacity;
+	new_seg->size = n_moved;
+	new_seg->reversed = seg->reversed;
+	seg->size -= n_moved;
+	memcpy(new_seg->ids, seg->ids + seg->size, n_moved * sizeof(tsp_id));
+	for (size_t i = 0; i < n_moved; i++) {
+		list->parent[new_seg->ids[i]] = t;
+		list->offset[new_seg->ids[i]] = i;
+	}
+
+	const size_t new_rank = seg->reversed ? rank : rank + 1;
+	memmove(&list->order[new_rank + 1], &list->order[new_rank], (list->n_segments - 1 - new_rank) * sizeof(size_t));
+	memmove(&list->start[new_rank + 1], &list->start[new_rank], (list->n_segments - new_rank) * sizeof(size_t));
+	list->order[new_rank] = t;
+	list->start[rank + 1] = list->start[rank] + list->segments[list->order[rank]].size;
+	for (size_t r = rank; r < list->n_segments; r++) {
+		list->rank[list->order[r]] = r;
+	}
+}
+
+/* Makes index idx the first of its segment */
+void _tlist_split_before(struct tsp_tlist *list, size_t idx)
+{
+	const size_t rank = _tlist_find_rank(list, idx);
+	if (list->start[rank] != idx) {
+		_tlist_split(list, rank, idx - list->start[rank]);
+	}
+}
+
+/* Position of index idx in the ids of its segment */
+size_t _tlist_raw(const struct tsp_tlist *list, size_t idx, size_t *segment)
+{
+	const size_t rank = _tlist_find_rank(list, idx);
+	const struct tsp_tlist_segment *const seg = &list->segments[list->order[rank]];
+	const size_t k = idx - list->start[rank];
+	*segment = list->order[rank];
+	return seg->reversed ? seg->size - 1 - k : k;
+}
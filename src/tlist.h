@@ -0,0 +1,61 @@
+#ifndef TSP_TLIST_H
+#define TSP_TLIST_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "dist_matrix.h"
+#include "tour.h"
+
+/* Routes of at least this many nodes apply 2-opt moves faster as a two-level
+ * list than as a flat tour (see bench/bench twolevel) */
+#define TSP_TLIST_MIN_NODES 2000
+
+/* Two-level list: a route split into about sqrt(n) segments, each with a
+ * reversal bit. Segments are kept in route order, so a node is found by index
+ * with a binary search over segment starts, and reversing a range of indices
+ * (tsp_tlist_swap_edges) splits at most 2 segments and flips the bits of the
+ * ones in between, in O(sqrt(n)) instead of O(n).
+ *
+ * Indices mean exactly what they mean in a tsp_tour, so a local search can
+ * switch between the two with the same move API. */
+struct tsp_tlist_segment {
+	tsp_id *ids;    /* Nodes of the segment, in reverse route order if reversed */
+	size_t size;
+	bool reversed;
+};
+
+struct tsp_tlist {
+	struct tsp_tlist_segment *segments;
+	tsp_id *buf;         /* Storage of all segments, seg_capacity IDs each */
+	size_t *order;       /* Segments in route order */
+	size_t *start;       /* Index of the first node of each segment in order, and size */
+	size_t *rank;        /* Position of each segment in order */
+	uint32_t *parent;    /* Segment of each node ID */
+	uint32_t *offset;    /* Position of each node ID in the ids of its segment */
+	size_t size;
+	size_t n_ids;
+	size_t n_segments;
+	size_t max_segments;
+	size_t seg_capacity;
+};
+
+struct tsp_tlist *tsp_tlist_create(const struct tsp_tour *tour);
+void tsp_tlist_to_tour(const struct tsp_tlist *list, struct tsp_tour *tour);
+void tsp_tlist_destroy(struct tsp_tlist *list);
+bool tsp_tlist_preferred(size_t n_nodes);
+
+tsp_id tsp_tlist_get(const struct tsp_tlist *list, size_t idx);
+size_t tsp_tlist_index_of(const struct tsp_tlist *list, unsigned id);
+tsp_id tsp_tlist_next(const struct tsp_tlist *list, unsigned id);
+tsp_id tsp_tlist_prev(const struct tsp_tlist *list, unsigned id);
+bool tsp_tlist_between(const struct tsp_tlist *list, unsigned a, unsigned b, unsigned c);
+
+void tsp_tlist_swap_nodes(struct tsp_tlist *list, size_t idx1, size_t idx2);
+void tsp_tlist_swap_edges(struct tsp_tlist *list, size_t idx1, size_t idx2);
+
+unsigned long tsp_tlist_evaluate(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix);
+long tsp_tlist_evaluate_swap_nodes(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
+long tsp_tlist_evaluate_swap_edges(const struct tsp_tlist *list, const struct tsp_dist_matrix *matrix, size_t idx1, size_t idx2);
+
+#endif /* TSP_TLIST_H */
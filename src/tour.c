@@ -0,0 +1,204 @@
+#include "tour.h"
+#include "helpers.h"
+#include <string.h>
+
+/* Private functions */
+void _tour_grow(struct tsp_tour *tour, size_t capacity);
+void _tour_reindex(struct tsp_tour *tour, size_t begin, size_t end);
+
+
+struct tsp_tour *tsp_tour_create(size_t capacity)
+{
+	struct tsp_tour *const ret = malloc_or_die(sizeof(struct tsp_tour));
+	ret->capacity = MAX(1, capacity);
+	ret->ids = malloc_or_die(ret->capacity * sizeof(tsp_id));
+	ret->pos = NULL;
+	ret->size = 0;
+	ret->n_ids = 0;
+	return ret;
+}
+
+void tsp_tour_copy(struct tsp_tour *dest, const struct tsp_tour *src)
+{
+	if (dest == src) {
+		return;
+	}
+	_tour_grow(dest, src->size);
+	/* Empty tours may have no arrays, which memcpy must not be given */
+	if (src->size != 0) {
+		memcpy(dest->ids, src->ids, src->size * sizeof(tsp_id));
+	}
+	dest->size = src->size;
+	tsp_tour_reserve_ids(dest, src->n_ids);
+	if (src->n_ids != 0) {
+		memcpy(dest->pos, src->pos, src->n_ids * sizeof(uint32_t));
+	}
+	for (size_t i = src->n_ids; i < dest->n_ids; i++) {
+		dest->pos[i] = TSP_TOUR_NONE;
+	}
+}
+
+/* Replaces the contents of a tour with node IDs 0..n_nodes-1, so that index i
+ * holds ID n_nodes-1-i. */
+void tsp_tour_fill(struct tsp_tour *tour, size_t n_nodes)
+{
+	if (n_nodes > TSP_TOUR_MAX_NODES) {
+		error(("%zu nodes do not fit in tours of at most %zu nodes", n_nodes, TSP_TOUR_MAX_NODES));
+	}
+	tsp_tour_clear(tour);
+	_tour_grow(tour, n_nodes);
+	tsp_tour_reserve_ids(tour, n_nodes);
+	for (size_t i = 0; i < n_nodes; i++) {
+		tour->ids[i] = i;
+		tour->pos[i] = i;
+	}
+	tour->size = n_nodes;
+}
+
+void tsp_tour_push(struct tsp_tour *tour, size_t id)
+{
+	assert(id < TSP_TOUR_MAX_NODES);
+	if (tour->size == tour->capacity) {
+		_tour_grow(tour, tour->capacity * 2);
+	}
+	if (id >= tour->n_ids) {
+		tsp_tour_reserve_ids(tour, id + 1);
+	}
+	tour->pos[id] = tour->size;
+	tour->ids[tour->size++] = id;
+}
+
+tsp_id tsp_tour_pop(struct tsp_tour *tour)
+{
+	assert(tour->size != 0);
+	const tsp_id ret = tour->ids[--tour->size];
+	tour->pos[ret] = TSP_TOUR_NONE;
+	return ret;
+}
+
+/* Inserts an ID, so that it ends up at index idx */
+void tsp_tour_insert(struct tsp_tour *tour, size_t idx, size_t id)
+{
+	assert(idx <= tour->size);
+	assert(id < TSP_TOUR_MAX_NODES);
+	if (tour->size == tour->capacity) {
+		_tour_grow(tour, tour->capacity * 2);
+	}
+	if (id >= tour->n_ids) {
+		tsp_tour_reserve_ids(tour, id + 1);
+	}
+	const size_t pos = tour->size - idx;
+	memmove(&tour->ids[pos + 1], &tour->ids[pos], idx * sizeof(tsp_id));
+	tour->ids[pos] = id;
+	tour->size++;
+	_tour_reindex(tour, pos, tour->size);
+}
+
+/* Removes the ID at index idx, preserving the order of the others */
+tsp_id tsp_tour_remove(struct tsp_tour *tour, size_t idx)
+{
+	assert(idx < tour->size);
+	const size_t pos = tour->size - 1 - idx;
+	const tsp_id ret = tour->ids[pos];
+	memmove(&tour->ids[pos], &tour->ids[pos + 1], idx * sizeof(tsp_id));
+	tour->size--;
+	tour->pos[ret] = TSP_TOUR_NONE;
+	_tour_reindex(tour, pos, tour->size);
+	return ret;
+}
+
+/* Removes the ID at index idx in constant time, by moving the ID at index 0
+ * into its place */
+tsp_id tsp_tour_qremove(struct tsp_tour *tour, size_t idx)
+{
+	assert(idx < tour->size);
+	const size_t pos = tour->size - 1 - idx;
+	const tsp_id ret = tour->ids[pos];
+	tour->ids[pos] = tour->ids[tour->size - 1];
+	tour->pos[tour->ids[pos]] = pos;
+	tour->pos[ret] = TSP_TOUR_NONE;
+	tour->size--;
+	return ret;
+}
+
+/* Reverses the IDs at indices idx1..idx2, which are contiguous in memory */
+void tsp_tour_reverse(struct tsp_tour *tour, size_t idx1, size_t idx2)
+{
+	assert(idx1 <= idx2 && idx2 < tour->size);
+	const size_t begin = tour->size - 1 - idx2;
+	const size_t end = tour->size - idx1;
+	for (size_t lo = begin, hi = end - 1; lo < hi; lo++, hi--) {
+		const tsp_id tmp = tour->ids[lo];
+		tour->ids[lo] = tour->ids[hi];
+		tour->ids[hi] = tmp;
+	}
+	_tour_reindex(tour, begin, end);
+}
+
+/* Moves a uniform random sample of n IDs to indices 0..n-1, drawing the same
+ * random numbers as tail_shuffle on the IDs */
+void tsp_tour_shuffle_top(struct tsp_tour *tour, size_t n)
+{
+	assert(n <= tour->size);
+	for (size_t i = 0; i < n; i++) {
+		const size_t src = randint(0, tour->size - 1 - i);
+		const size_t dest = tour->size - 1 - i;
+		const tsp_id tmp = tour->ids[dest];
+		tour->ids[dest] = tour->ids[src];
+		tour->ids[src] = tmp;
+		tour->pos[tour->ids[dest]] = dest;
+		tour->pos[tmp] = src;
+	}
+}
+
+void tsp_tour_clear(struct tsp_tour *tour)
+{
+	for (size_t i = 0; i < tour->size; i++) {
+		tour->pos[tour->ids[i]] = TSP_TOUR_NONE;
+	}
+	tour->size = 0;
+}
+
+/* Makes room in the position index for at least IDs 0..n_ids-1 */
+void tsp_tour_reserve_ids(struct tsp_tour *tour, size_t n_ids)
+{
+	if (n_ids <= tour->n_ids) {
+		return;
+	}
+	n_ids = MAX(n_ids, tour->n_ids * 2);
+	tour->pos = realloc(tour->pos, n_ids * sizeof(uint32_t));
+	if (tour->pos == NULL) {
+		error(("failed to grow the index of a tour to %zu nodes", n_ids));
+	}
+	for (size_t i = tour->n_ids; i < n_ids; i++) {
+		tour->pos[i] = TSP_TOUR_NONE;
+	}
+	tour->n_ids = n_ids;
+}
+
+void tsp_tour_destroy(struct tsp_tour *tour)
+{
+	free(tour->ids);
+	free(tour->pos);
+	free(tour);
+}
+
+void _tour_grow(struct tsp_tour *tour, size_t capacity)
+{
+	if (capacity <= tour->capacity) {
+		return;
+	}
+	tour->ids = realloc(tour->ids, capacity * sizeof(tsp_id));
+	if (tour->ids == NULL) {
+		error(("failed to grow a tour to %zu nodes", capacity));
+	}
+	tour->capacity = capacity;
+}
+
+/* Updates the positions of the IDs stored in ids[begin..end) */
+void _tour_reindex(struct tsp_tour *tour, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++) {
+		tour->pos[tour->ids[i]] = i;
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef TSP_TOUR_H
+#define TSP_TOUR_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* Node IDs are stored as uint32_t, or as uint16_t when built with
+ * -DTSP_TOUR_ID16, which halves the memory traffic of every scan but limits
+ * instances to 65536 nodes. */
+#ifdef TSP_TOUR_ID16
+typedef uint16_t tsp_id;
+#define TSP_TOUR_MAX_NODES ((size_t)UINT16_MAX + 1)
+#else
+typedef uint32_t tsp_id;
+#define TSP_TOUR_MAX_NODES ((size_t)UINT32_MAX)
+#endif
+
+/* Position of a node ID that is not in a tour */
+#define TSP_TOUR_NONE UINT32_MAX
+
+/* Contiguous array of node IDs, used both for routes and for sets of nodes.
+ * Indexing follows the sp_stack it replaced: index 0 is the most recently
+ * pushed ID, which is stored last. Every mutator keeps pos up to date, so
+ * that a node is found by ID in constant time (see tsp_tour_find). */
+struct tsp_tour {
+	tsp_id *ids;
+	uint32_t *pos;    /* Position in ids of each node ID, or TSP_TOUR_NONE */
+	size_t size;
+	size_t capacity;
+	size_t n_ids;     /* Length of pos, grown to fit the largest ID seen */
+};
+
+struct tsp_tour *tsp_tour_create(size_t capacity);
+void tsp_tour_copy(struct tsp_tour *dest, const struct tsp_tour *src);
+void tsp_tour_fill(struct tsp_tour *tour, size_t n_nodes);
+void tsp_tour_push(struct tsp_tour *tour, size_t id);
+tsp_id tsp_tour_pop(struct tsp_tour *tour);
+void tsp_tour_insert(struct tsp_tour *tour, size_t idx, size_t id);
+tsp_id tsp_tour_remove(struct tsp_tour *tour, size_t idx);
+tsp_id tsp_tour_qremove(struct tsp_tour *tour, size_t idx);
+void tsp_tour_reverse(struct tsp_tour *tour, size_t idx1, size_t idx2);
+void tsp_tour_shuffle_top(struct tsp_tour *tour, size_t n);
+void tsp_tour_clear(struct tsp_tour *tour);
+void tsp_tour_reserve_ids(struct tsp_tour *tour, size_t n_ids);
+void tsp_tour_destroy(struct tsp_tour *tour);
+
+
+static inline tsp_id tsp_tour_get(const struct tsp_tour *tour, size_t idx)
+{
+	assert(idx < tour->size);
+	return tour->ids[tour->size - 1 - idx];
+}
+
+/* Overwrites the ID at index idx. The ID it replaces is no longer found,
+ * unless it was moved elsewhere first (as in a swap). */
+static inline void tsp_tour_set(struct tsp_tour *tour, size_t idx, size_t id)
+{
+	assert(idx < tour->size);
+	const size_t pos = tour->size - 1 - idx;
+	if (id >= tour->n_ids) {
+		tsp_tour_reserve_ids(tour, id + 1);
+	}
+	if (tour->pos[tour->ids[pos]] == pos) {
+		tour->pos[tour->ids[pos]] = TSP_TOUR_NONE;
+	}
+	tour->ids[pos] = id;
+	tour->pos[id] = pos;
+}
+
+/* ID at index 0 */
+static inline tsp_id tsp_tour_peek(const struct tsp_tour *tour)
+{
+	assert(tour->size != 0);
+	return tour->ids[tour->size - 1];
+}
+
+/* Index of a node ID, or SIZE_MAX if it is not in the tour */
+static inline size_t tsp_tour_find(const struct tsp_tour *tour, size_t id)
+{
+	if (id >= tour->n_ids || tour->pos[id] == TSP_TOUR_NONE) {
+		return SIZE_MAX;
+	}
+	return tour->size - 1 - tour->pos[id];
+}
+
+static inline bool tsp_tour_contains(const struct tsp_tour *tour, size_t id)
+{
+	return id < tour->n_ids && tour->pos[id] != TSP_TOUR_NONE;
+}
+
+#endif /* TSP_TOUR_H */
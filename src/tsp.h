@@ -3,6 +3,13 @@
 
 #include "../libstaple/src/staple.h"
 #include "graph.h"
+#include "tlist.h"
+#include "pool.h"
+#include "cowtour.h"
+#include "optstore.h"
+#include "simd.h"
+#include "eval.h"
 #include "helpers.h"
+#include "tsplib.h"
 
 #endif /* TSP_H */
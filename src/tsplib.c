@@ -0,0 +1,341 @@
+#include "tsplib.h"
+#include "helpers.h"
+#include "scanner.h"
+#include "../libstaple/src/staple.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+/* Layouts of EDGE_WEIGHT_SECTION */
+enum tsplib_format {
+	TSPLIB_FULL_MATRIX,
+	TSPLIB_UPPER_ROW,
+	TSPLIB_LOWER_ROW,
+	TSPLIB_UPPER_DIAG_ROW,
+	TSPLIB_LOWER_DIAG_ROW,
+	TSPLIB_NO_FORMAT,
+};
+
+static const char *const tsplib_format_names[] = {
+	"FULL_MATRIX",
+	"UPPER_ROW",
+	"LOWER_ROW",
+	"UPPER_DIAG_ROW",
+	"LOWER_DIAG_ROW",
+};
+
+/* Specification part of a TSPLIB file */
+struct tsplib_spec {
+	size_t dimension;
+	bool explicit;            /* EDGE_WEIGHT_TYPE: EXPLICIT rather than EUC_2D */
+	enum tsplib_format format;
+};
+
+
+/* Private functions */
+bool _line_eq(const char *line, size_t len, const char *str);
+void _parse_spec_line(struct tsp_scanner *scanner, struct tsplib_spec *spec, const char *line, size_t len);
+struct tsp_node *_read_coords(struct tsp_scanner *scanner, const struct tsplib_spec *spec, struct tsp_node *nodes);
+void _skip_node_lines(struct tsp_scanner *scanner, const struct tsplib_spec *spec);
+void _read_edge_weights(struct tsp_scanner *scanner, const struct tsplib_spec *spec, struct tsp_dist_matrix *matrix);
+bool _format_has(enum tsplib_format format, size_t i, size_t j);
+
+
+bool _line_eq(const char *line, size_t len, const char *str)
+{
+	return strlen(str) == len && memcmp(line, str, len) == 0;
+}
+
+/* Parses a "KEY : VALUE" line of the specification part */
+void _parse_spec_line(struct tsp_scanner *scanner, struct tsplib_spec *spec, const char *line, size_t len)
+{
+	const char *const colon = memchr(line, ':', len);
+	if (colon == NULL) {
+		error(("failed to parse line %zu in %s: expected KEY : VALUE", scanner->token_lineno, scanner->fpath));
+	}
+	size_t key_len = colon - line;
+	while (key_len > 0 && (line[key_len - 1] == ' ' || line[key_len - 1] == '\t')) {
+		key_len--;
+	}
+	const char *value = colon + 1;
+	size_t value_len = len - (value - line);
+	while (value_len > 0 && (*value == ' ' || *value == '\t')) {
+		value++;
+		value_len--;
+	}
+	while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t')) {
+		value_len--;
+	}
+
+	if (_line_eq(line, key_len, "DIMENSION")) {
+		char buf[32];
+		char *end;
+		if (value_len == 0 || value_len >= sizeof(buf)) {
+			error(("failed to parse line %zu in %s: invalid DIMENSION", scanner->token_lineno, scanner->fpath));
+		}
+		memcpy(buf, value, value_len);
+		buf[value_len] = '\0';
+		spec->dimension = strtoul(buf, &end, 10);
+		if (*end != '\0' || spec->dimension == 0 || spec->dimension > UINT_MAX) {
+			error(("failed to parse line %zu in %s: invalid DIMENSION", scanner->token_lineno, scanner->fpath));
+		}
+	} else if (_line_eq(line, key_len, "TYPE")) {
+		if (!_line_eq(value, value_len, "TSP")) {
+			error(("%s: only instances of TYPE TSP are supported, not %.*s", scanner->fpath, (int)value_len, value));
+		}
+	} else if (_line_eq(line, key_len, "EDGE_WEIGHT_TYPE")) {
+		if (_line_eq(value, value_len, "EUC_2D")) {
+			spec->explicit = false;
+		} else if (_line_eq(value, value_len, "EXPLICIT")) {
+			spec->explicit = true;
+		} else {
+			error(("%s: only EUC_2D and EXPLICIT edge weights are supported, not %.*s", scanner->fpath, (int)value_len, value));
+		}
+	} else if (_line_eq(line, key_len, "EDGE_WEIGHT_FORMAT")) {
+		spec->format = TSPLIB_NO_FORMAT;
+		for (size_t i = 0; i < ARRLEN(tsplib_format_names); i++) {
+			if (_line_eq(value, value_len, tsplib_format_names[i])) {
+				spec->format = i;
+			}
+		}
+		if (spec->format == TSPLIB_NO_FORMAT) {
+			error(("%s: unsupported EDGE_WEIGHT_FORMAT %.*s", scanner->fpath, (int)value_len, value));
+		}
+	}
+	/* NAME, COMMENT, NODE_COORD_TYPE, DISPLAY_DATA_TYPE and the like are ignored */
+}
+
+/* Reads NODE_COORD_SECTION or DISPLAY_DATA_SECTION into nodes, allocating it
+ * if NULL. Coordinates are rounded to integers. */
+struct tsp_node *_read_coords(struct tsp_scanner *scanner, const struct tsplib_spec *spec, struct tsp_node *nodes)
+{
+	const size_t size = spec->dimension;
+	bool *const seen = calloc_or_die(size * sizeof(bool));
+	bool rounded = false;
+
+	if (nodes == NULL) {
+		nodes = calloc_or_die(size * sizeof(struct tsp_node));
+	}
+	for (size_t i = 0; i < size; i++) {
+		unsigned long number;
+		double x, y;
+		if (
+			tsp_scanner_read_ulong(scanner, &number, size) != 1 ||
+			tsp_scanner_read_double(scanner, &x) != 1 ||
+			tsp_scanner_read_double(scanner, &y) != 1
+		) {
+			error(("failed to parse line %zu in %s: expected a node number and two coordinates", scanner->token_lineno, scanner->fpath));
+		}
+		if (number == 0 || seen[number - 1]) {
+			error(("line %zu in %s: invalid or repeated node number %lu", scanner->token_lineno, scanner->fpath, number));
+		}
+		if (fabs(x) > INT_MAX || fabs(y) > INT_MAX) {
+			error(("line %zu in %s: coordinates out of range", scanner->token_lineno, scanner->fpath));
+		}
+		seen[number - 1] = true;
+		nodes[number - 1].id = number - 1;
+		nodes[number - 1].x = floor(x + 0.5);
+		nodes[number - 1].y = floor(y + 0.5);
+		rounded |= nodes[number - 1].x != x || nodes[number - 1].y != y;
+	}
+	if (rounded) {
+		warn(("%s: coordinates rounded to integers, so distances may differ from the TSPLIB ones", scanner->fpath));
+	}
+	free(seen);
+	return nodes;
+}
+
+/* Skips a section of one line per node, not counting blank lines */
+void _skip_node_lines(struct tsp_scanner *scanner, const struct tsplib_spec *spec)
+{
+	const char *line;
+	size_t len;
+	size_t n_lines = 0;
+	while (n_lines < spec->dimension) {
+		if (!tsp_scanner_read_line(scanner, &line, &len)) {
+			error(("unexpected EOF in a section of %s", scanner->fpath));
+		}
+		while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+			len--;
+		}
+		n_lines += len != 0;
+	}
+}
+
+/* Whether the pair (i, j) is listed in EDGE_WEIGHT_SECTION */
+bool _format_has(enum tsplib_format format, size_t i, size_t j)
+{
+	switch (format) {
+		case TSPLIB_FULL_MATRIX: return true;
+		case TSPLIB_UPPER_ROW: return j > i;
+		case TSPLIB_LOWER_ROW: return j < i;
+		case TSPLIB_UPPER_DIAG_ROW: return j >= i;
+		case TSPLIB_LOWER_DIAG_ROW: return j <= i;
+		default: return false;
+	}
+}
+
+void _read_edge_weights(struct tsp_scanner *scanner, const struct tsplib_spec *spec, struct tsp_dist_matrix *matrix)
+{
+	struct tsp_dist_builder builder;
+	const size_t size = spec->dimension;
+	size_t bad_node;
+
+	if (spec->format == TSPLIB_NO_FORMAT) {
+		error(("%s: EDGE_WEIGHT_SECTION without a supported EDGE_WEIGHT_FORMAT", scanner->fpath));
+	}
+	tsp_dist_builder_begin(&builder, matrix, size, tsp_dist_matrix_get_default_storage());
+	for (size_t i = 0; i < size; i++) {
+		for (size_t j = 0; j < size; j++) {
+			unsigned long dist;
+			if (!_format_has(spec->format, i, j)) {
+				if (i == j) {
+					tsp_dist_builder_set(&builder, i, j, 0);
+				}
+				continue;
+			}
+			if (tsp_scanner_read_ulong(scanner, &dist, UINT32_MAX) != 1) {
+				error(("failed to parse line %zu in %s: expected a distance", scanner->token_lineno, scanner->fpath));
+			}
+			/* Triangular formats list each pair once */
+			if (
+				!tsp_dist_builder_set(&builder, i, j, dist) ||
+				(spec->format != TSPLIB_FULL_MATRIX && !tsp_dist_builder_set(&builder, j, i, dist))
+			) {
+				error(("line %zu in %s: distance from node %zu to itself is not 0", scanner->token_lineno, scanner->fpath, i + 1));
+			}
+		}
+	}
+	if (!tsp_dist_builder_end(&builder, &bad_node)) {
+		error(("%s: distances from node %zu differ from the distances to it", scanner->fpath, bad_node + 1));
+	}
+}
+
+/* Reads a symmetric TSPLIB instance, with EUC_2D coordinates or EXPLICIT
+ * distances. Costs are read from costs_fpath, one per node, or drawn with
+ * randint if it is NULL. Coordinate instances go through tsp_graph_create,
+ * so the distances are computed exactly as for CSV instances. */
+struct tsp_graph *tsp_graph_read_tsplib(const char *fpath, const char *costs_fpath)
+{
+	struct tsp_scanner scanner;
+	struct tsplib_spec spec = { 0, false, TSPLIB_NO_FORMAT };
+	struct tsp_dist_matrix *const matrix = tsp_dist_matrix_create();
+	struct tsp_node *nodes = NULL;
+	bool have_matrix = false;
+	const char *line;
+	size_t len;
+
+	tsp_scanner_open(&scanner, fpath);
+	while (tsp_scanner_read_line(&scanner, &line, &len)) {
+		while (len > 0 && (*line == ' ' || *line == '\t')) {
+			line++;
+			len--;
+		}
+		while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+			len--;
+		}
+		if (len == 0) {
+			continue;
+		}
+		if (_line_eq(line, len, "EOF")) {
+			break;
+		}
+		if (memchr(line, ':', len) != NULL) {
+			_parse_spec_line(&scanner, &spec, line, len);
+			continue;
+		}
+		if (spec.dimension == 0) {
+			error(("line %zu in %s: section before DIMENSION", scanner.token_lineno, fpath));
+		}
+		if (_line_eq(line, len, "NODE_COORD_SECTION")) {
+			if (spec.explicit) {
+				error(("%s: NODE_COORD_SECTION in an EXPLICIT instance", fpath));
+			}
+			nodes = _read_coords(&scanner, &spec, nodes);
+		} else if (_line_eq(line, len, "DISPLAY_DATA_SECTION")) {
+			/* Only explicit instances take their coordinates from here,
+			 * the others compute distances from NODE_COORD_SECTION */
+			if (spec.explicit) {
+				nodes = _read_coords(&scanner, &spec, nodes);
+			} else {
+				_skip_node_lines(&scanner, &spec);
+			}
+		} else if (_line_eq(line, len, "EDGE_WEIGHT_SECTION")) {
+			if (!spec.explicit || have_matrix) {
+				error(("%s: unexpected EDGE_WEIGHT_SECTION", fpath));
+			}
+			_read_edge_weights(&scanner, &spec, matrix);
+			have_matrix = true;
+		} else {
+			error(("line %zu in %s: unsupported section %.*s", scanner.token_lineno, fpath, (int)len, line));
+		}
+	}
+	tsp_scanner_close(&scanner);
+
+	if (spec.explicit ? !have_matrix : nodes == NULL) {
+		error(("%s: no %s", fpath, spec.explicit ? "EDGE_WEIGHT_SECTION" : "NODE_COORD_SECTION"));
+	}
+	if (nodes == NULL) {
+		nodes = calloc_or_die(spec.dimension * sizeof(struct tsp_node));
+		for (size_t i = 0; i < spec.dimension; i++) {
+			nodes[i].id = i;
+		}
+	}
+	if (costs_fpath != NULL) {
+		tsp_nodes_read_costs(nodes, spec.dimension, costs_fpath);
+	} else {
+		for (size_t i = 0; i < spec.dimension; i++) {
+			nodes[i].cost = randint(0, TSP_TSPLIB_MAX_COST);
+		}
+	}
+
+	struct tsp_graph *graph;
+	if (spec.explicit) {
+		/* Display coordinates and costs complete the nodes of the matrix */
+		graph = tsp_graph_empty();
+		tsp_dist_matrix_release(graph->dist_matrix);
+		graph->dist_matrix = matrix;
+		memcpy(graph->dist_matrix->nodes, nodes, spec.dimension * sizeof(struct tsp_node));
+		tsp_dist_matrix_update_costs(graph->dist_matrix);
+		if (tsp_dist_matrix_get_renumbering()) {
+			tsp_dist_matrix_renumber(graph->dist_matrix, tsp_dist_matrix_greedy_order(graph->dist_matrix));
+		}
+		tsp_tour_fill(graph->nodes_vacant, spec.dimension);
+	} else {
+		struct sp_stack *const stack = sp_stack_create(sizeof(struct tsp_node), spec.dimension);
+		for (size_t i = 0; i < spec.dimension; i++) {
+			sp_stack_push(stack, &nodes[i]);
+		}
+		graph = tsp_graph_create(stack);
+		sp_stack_destroy(stack, NULL);
+		tsp_dist_matrix_release(matrix);
+	}
+	free(nodes);
+	info(("successfully read %zu nodes from %s", spec.dimension, fpath));
+	return graph;
+}
+
+/* Writes the route of a graph as a TSPLIB TOUR file. Node numbers are the
+ * IDs in the instance file plus 1, even if the nodes were renumbered. */
+void tsp_graph_export_tour(const struct tsp_graph *graph, const char *fpath, const char *name)
+{
+	const struct tsp_tour *const active = graph->nodes_active;
+	FILE *const f = fopen(fpath, "w");
+	if (f == NULL) {
+		warn(("tsp_graph_export_tour: failed to open file %s for writing", fpath));
+		return;
+	}
+
+	fprintf(f, "NAME : %s\n", name);
+	fprintf(f, "TYPE : TOUR\n");
+	fprintf(f, "COMMENT : %zu of %zu nodes, objective %lu\n",
+		active->size, graph->dist_matrix->size, tsp_nodes_evaluate(active, graph->dist_matrix));
+	fprintf(f, "DIMENSION : %zu\n", active->size);
+	fprintf(f, "TOUR_SECTION\n");
+	for (size_t i = active->size; i-- > 0;) {
+		fprintf(f, "%u\n", tsp_dist_matrix_orig_id(graph->dist_matrix, tsp_tour_get(active, i)) + 1);
+	}
+	fprintf(f, "-1\nEOF\n");
+	fclose(f);
+}
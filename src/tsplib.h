@@ -0,0 +1,15 @@
+#ifndef TSP_TSPLIB_H
+#define TSP_TSPLIB_H
+
+#include "graph.h"
+
+/* Node costs are drawn from 0..TSP_TSPLIB_MAX_COST when no costs file is given */
+#define TSP_TSPLIB_MAX_COST 1000
+
+
+/* Functions */
+struct tsp_graph *tsp_graph_read_tsplib(const char *fpath, const char *costs_fpath);
+void tsp_graph_export_tour(const struct tsp_graph *graph, const char *fpath, const char *name);
+
+
+#endif /* TSP_TSPLIB_H */
@@ -19,47 +19,39 @@ static struct sp_stack *nodes[ARRLEN(files)];
 
 void greedy_cycle_2regret(struct tsp_graph *graph, size_t target_size)
 {
-	struct sp_stack *vacant = graph->nodes_vacant;
-	struct sp_stack *active = graph->nodes_active;
+	struct tsp_tour *vacant = graph->nodes_vacant;
+	struct tsp_tour *active = graph->nodes_active;
 
 	if (active->size == 0 && target_size != 0)
 		tsp_graph_activate_random(graph, 1);
 	if (active->size == 1 && target_size != 1) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_peek(active);
-		const size_t idx = tsp_nodes_find_nn(vacant, &graph->dist_matrix, node);
+		const size_t idx = tsp_nodes_find_nn(vacant, graph->dist_matrix, tsp_tour_peek(active));
 		tsp_graph_activate_node(graph, idx);
 	}
 	while (active->size < target_size) {
-		struct tsp_node node;
 		struct sp_stack *const rcl = tsp_graph_find_rcl(graph, 10, 0.04);
 		const struct tsp_move move = tsp_graph_find_2regret(graph, rcl);
 		sp_stack_destroy(rcl, NULL);
-		node = *(struct tsp_node*)sp_stack_get(vacant, move.src);
-		sp_stack_remove(vacant, move.src, NULL);
-		sp_stack_insert(active, move.dest, &node);
+		tsp_graph_insert(graph, move);
 	}
 }
 
 void greedy_cycle_wsc(struct tsp_graph *graph, size_t target_size)
 {
-	struct sp_stack *vacant = graph->nodes_vacant;
-	struct sp_stack *active = graph->nodes_active;
+	struct tsp_tour *vacant = graph->nodes_vacant;
+	struct tsp_tour *active = graph->nodes_active;
 
 	if (active->size == 0 && target_size != 0)
 		tsp_graph_activate_random(graph, 1);
 	if (active->size == 1 && target_size != 1) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_peek(active);
-		const size_t idx = tsp_nodes_find_nn(vacant, &graph->dist_matrix, node);
+		const size_t idx = tsp_nodes_find_nn(vacant, graph->dist_matrix, tsp_tour_peek(active));
 		tsp_graph_activate_node(graph, idx);
 	}
 	while (active->size < target_size) {
-		struct tsp_node node;
 		struct sp_stack *const rcl = tsp_graph_find_rcl(graph, 10, 0.04);
 		const struct tsp_move move = tsp_graph_find_wsc(graph, rcl, 0.5);
 		sp_stack_destroy(rcl, NULL);
-		node = *(struct tsp_node*)sp_stack_get(vacant, move.src);
-		sp_stack_remove(vacant, move.src, NULL);
-		sp_stack_insert(active, move.dest, &node);
+		tsp_graph_insert(graph, move);
 	}
 }
 
@@ -81,7 +73,7 @@ void run_greedy_algorithm(const char *algo_name, activate_func_t greedy_algo)
 	for (size_t i = 0; i < ARRLEN(files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
 
 		/* 200 solutions starting from each node */
 		for (int j = 0; j < 200; j++) {
@@ -89,7 +81,7 @@ void run_greedy_algorithm(const char *algo_name, activate_func_t greedy_algo)
 			tsp_graph_activate_node(graph, j);
 			greedy_algo(graph, target_size);
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			score_max[i] = MAX(score, score_max[i]);
 			if (score < score_min[i]) {
 				score_min[i] = score;
@@ -103,7 +95,7 @@ void run_greedy_algorithm(const char *algo_name, activate_func_t greedy_algo)
 			tsp_graph_deactivate_all(graph);
 			greedy_algo(graph, target_size);
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			score_max[i] = MAX(score, score_max[i]);
 			if (score < score_min[i]) {
 				score_min[i] = score;
@@ -67,10 +67,14 @@ struct sp_stack *init_moves(size_t n_nodes)
 
 void lsearch_greedy(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
 	struct sp_stack *const all_moves = init_moves(active->size);
 	struct sp_stack *const moves = sp_stack_create(sizeof(struct lsearch_move), all_moves->size);
 
+	struct tsp_eval eval;
+	tsp_eval_init(&eval, graph->dist_matrix);
+
 	bool did_improve = true;
 	while (did_improve) {
 		sp_stack_copy(moves, all_moves, NULL);
@@ -83,21 +87,21 @@ void lsearch_greedy(struct tsp_graph *graph)
 			long delta;
 			switch (m.type) {
 				case MOVE_TYPE_NODES:
-					delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_eval_swap_nodes(&eval, active, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_nodes(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_nodes(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
 				case MOVE_TYPE_EDGES:
-					delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_eval_swap_edges(&eval, active, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_edges(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_edges(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
 				case MOVE_TYPE_INTER:
-					delta = tsp_graph_evaluate_inter_swap(graph, m.indices.src, m.indices.dest);
+					delta = tsp_eval_inter_swap(&eval, active, vacant, m.indices.src, m.indices.dest);
 					if (delta < 0) {
 						tsp_graph_inter_swap(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
@@ -119,8 +123,9 @@ void lsearch_greedy(struct tsp_graph *graph)
 
 void lsearch_steepest(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_intra_rows *const rows = tsp_intra_rows_create(graph->dist_matrix->size);
 
 	bool did_improve = true;
 	while (did_improve) {
@@ -128,40 +133,29 @@ void lsearch_steepest(struct tsp_graph *graph)
 		long min_delta = 0;
 		did_improve = false;
 
+		tsp_intra_rows_load(rows, active, graph->dist_matrix);
 		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = i; j < active->size; j++) {
-				long delta;
-
-				delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_NODES;
-					did_improve = true;
-				}
-
-				delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_EDGES;
-					did_improve = true;
-				}
+			size_t j;
+			bool edges;
+			const long delta = tsp_intra_rows_find_best(rows, i, &j, &edges);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = edges ? MOVE_TYPE_EDGES : MOVE_TYPE_NODES;
+				did_improve = true;
 			}
 		}
 
-		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = 0; j < vacant->size; j++) {
-				const long delta = tsp_graph_evaluate_inter_swap(graph, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_INTER;
-					did_improve = true;
-				}
+		for (size_t i = 0; i < active->size && vacant->size != 0; i++) {
+			size_t j;
+			const long delta = tsp_graph_find_best_inter_swap(graph, i, &j);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = MOVE_TYPE_INTER;
+				did_improve = true;
 			}
 		}
 
@@ -170,10 +164,10 @@ void lsearch_steepest(struct tsp_graph *graph)
 			             j = best_move.indices.dest;
 			switch (best_move.type) {
 				case MOVE_TYPE_NODES:
-					tsp_nodes_swap_nodes(active, i, j);
+					tsp_graph_swap_nodes(graph, i, j);
 				break;
 				case MOVE_TYPE_EDGES:
-					tsp_nodes_swap_edges(active, i, j);
+					tsp_graph_swap_edges(graph, i, j);
 				break;
 				case MOVE_TYPE_INTER:
 					tsp_graph_inter_swap(graph, i, j);
@@ -181,6 +175,7 @@ void lsearch_steepest(struct tsp_graph *graph)
 			}
 		}
 	}
+	tsp_intra_rows_destroy(rows);
 }
 
 void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo, bool random_start)
@@ -207,7 +202,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo, bool
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
 
 		for (int j = 0; j < 200; j++) {
 			if (random_start) {
@@ -222,7 +217,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo, bool
 			lsearch_algo(graph);
 			time_after = clock();
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			const double time = (double)(time_after - time_before) / CLOCKS_PER_SEC;
 			score_min[i] = MIN(score, score_min[i]);
 			time_min[i] = MIN(time, time_min[i]);
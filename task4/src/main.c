@@ -61,15 +61,18 @@ struct sp_stack *init_moves(size_t n_nodes)
 
 void lsearch_candidates_steepest(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	const size_t n_nodes = graph->dist_matrix.size;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	const size_t n_nodes = graph->dist_matrix->size;
 	struct tsp_cand_matrix *const cand_matrix = tsp_graph_compute_candidates(graph, N_CANDIDATES);
 	bool *const inter_swap_adds_candidate = tsp_graph_cache_inter_swap_adds_candidates(graph, cand_matrix);
 	bool *const swap_nodes_adds_candidate = tsp_nodes_cache_swap_nodes_adds_candidates(active, cand_matrix);
 	bool *const swap_edges_adds_candidate = tsp_nodes_cache_swap_edges_adds_candidates(active, cand_matrix);
 	tsp_cand_matrix_destroy(cand_matrix);
 
+	struct tsp_eval eval;
+	tsp_eval_init(&eval, graph->dist_matrix);
+
 	bool did_improve = true;
 	while (did_improve) {
 		struct lsearch_move best_move = {0};
@@ -79,7 +82,7 @@ void lsearch_candidates_steepest(struct tsp_graph *graph)
 		for (size_t i = 0; i < active->size; i++) {
 			for (size_t j = i; j < active->size; j++) {
 				if (swap_nodes_adds_candidate[i * n_nodes + j]) {
-					const long delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, i, j);
+					const long delta = tsp_eval_swap_nodes(&eval, active, i, j);
 					if (delta < min_delta) {
 						min_delta = delta;
 						best_move.indices.src = i;
@@ -90,7 +93,7 @@ void lsearch_candidates_steepest(struct tsp_graph *graph)
 				}
 
 				if (swap_edges_adds_candidate[i * n_nodes + j]) {
-					const long delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, i, j);
+					const long delta = tsp_eval_swap_edges(&eval, active, i, j);
 					if (delta < min_delta) {
 						min_delta = delta;
 						best_move.indices.src = i;
@@ -107,7 +110,7 @@ void lsearch_candidates_steepest(struct tsp_graph *graph)
 				if (!inter_swap_adds_candidate[i * n_nodes + j]) {
 					continue;
 				}
-				const long delta = tsp_graph_evaluate_inter_swap(graph, i, j);
+				const long delta = tsp_eval_inter_swap(&eval, active, vacant, i, j);
 				if (delta < min_delta) {
 					min_delta = delta;
 					best_move.indices.src = i;
@@ -123,10 +126,10 @@ void lsearch_candidates_steepest(struct tsp_graph *graph)
 			             j = best_move.indices.dest;
 			switch (best_move.type) {
 				case MOVE_TYPE_NODES:
-					tsp_nodes_swap_nodes(active, i, j);
+					tsp_graph_swap_nodes(graph, i, j);
 				break;
 				case MOVE_TYPE_EDGES:
-					tsp_nodes_swap_edges(active, i, j);
+					tsp_graph_swap_edges(graph, i, j);
 				break;
 				case MOVE_TYPE_INTER:
 					tsp_graph_inter_swap(graph, i, j);
@@ -163,7 +166,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
 
 		for (int j = 0; j < 200; j++) {
 			tsp_graph_deactivate_all(graph);
@@ -174,7 +177,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 			lsearch_algo(graph);
 			time_after = clock();
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			const double time = (double)(time_after - time_before) / CLOCKS_PER_SEC;
 			score_min[i] = MIN(score, score_min[i]);
 			time_min[i] = MIN(time, time_min[i]);
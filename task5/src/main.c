@@ -61,9 +61,9 @@ struct sp_stack *init_moves(size_t n_nodes)
 
 void lsearch_delta_steepest(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	struct tsp_delta_cache *const delta_cache = tsp_delta_cache_create(graph->dist_matrix.size);
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_delta_cache *const delta_cache = tsp_delta_cache_create(graph->dist_matrix->size);
 
 	bool did_improve = true;
 	while (did_improve) {
@@ -129,9 +129,9 @@ void lsearch_delta_steepest(struct tsp_graph *graph)
 
 void lsearch_candidates_delta_steepest(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
-	const size_t n_nodes = graph->dist_matrix.size;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	const size_t n_nodes = graph->dist_matrix->size;
 	struct tsp_cand_matrix *const cand_matrix = tsp_graph_compute_candidates(graph, N_CANDIDATES);
 	bool *const inter_swap_adds_candidate = tsp_graph_cache_inter_swap_adds_candidates(graph, cand_matrix);
 	bool *const swap_nodes_adds_candidate = tsp_nodes_cache_swap_nodes_adds_candidates(active, cand_matrix);
@@ -233,7 +233,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
 
 		for (int j = 0; j < 200; j++) {
 			tsp_graph_deactivate_all(graph);
@@ -244,7 +244,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 			lsearch_algo(graph);
 			time_after = clock();
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			const double time = (double)(time_after - time_before) / CLOCKS_PER_SEC;
 			score_min[i] = MIN(score, score_min[i]);
 			time_min[i] = MIN(time, time_min[i]);
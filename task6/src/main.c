@@ -37,6 +37,8 @@ static const char *nodes_files[] = {
 };
 static struct sp_stack *nodes[ARRLEN(nodes_files)];
 static size_t lsearch_counter;
+static struct tsp_graph_pool *graph_pool;  /* Work graphs of the current instance */
+static struct tsp_intra_rows *intra_rows;  /* Row scan layout of the current instance */
 
 void lsearch_steepest(struct tsp_graph *graph);
 void iterated_lsearch_steepest_perturb(struct tsp_graph *graph, perturb_func_t perturb_func, clock_t deadline);
@@ -47,8 +49,9 @@ void iterated_lsearch_steepest(struct tsp_graph *graph);
 void lsearch_steepest(struct tsp_graph *graph)
 {
 	++lsearch_counter;
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_intra_rows *const rows = intra_rows;
 
 	bool did_improve = true;
 	while (did_improve) {
@@ -56,40 +59,29 @@ void lsearch_steepest(struct tsp_graph *graph)
 		long min_delta = 0;
 		did_improve = false;
 
+		tsp_intra_rows_load(rows, active, graph->dist_matrix);
 		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = i; j < active->size; j++) {
-				long delta;
-
-				delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_NODES;
-					did_improve = true;
-				}
-
-				delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_EDGES;
-					did_improve = true;
-				}
+			size_t j;
+			bool edges;
+			const long delta = tsp_intra_rows_find_best(rows, i, &j, &edges);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = edges ? MOVE_TYPE_EDGES : MOVE_TYPE_NODES;
+				did_improve = true;
 			}
 		}
 
-		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = 0; j < vacant->size; j++) {
-				const long delta = tsp_graph_evaluate_inter_swap(graph, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_INTER;
-					did_improve = true;
-				}
+		for (size_t i = 0; i < active->size && vacant->size != 0; i++) {
+			size_t j;
+			const long delta = tsp_graph_find_best_inter_swap(graph, i, &j);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = MOVE_TYPE_INTER;
+				did_improve = true;
 			}
 		}
 
@@ -98,10 +90,10 @@ void lsearch_steepest(struct tsp_graph *graph)
 			             j = best_move.indices.dest;
 			switch (best_move.type) {
 				case MOVE_TYPE_NODES:
-					tsp_nodes_swap_nodes(active, i, j);
+					tsp_graph_swap_nodes(graph, i, j);
 				break;
 				case MOVE_TYPE_EDGES:
-					tsp_nodes_swap_edges(active, i, j);
+					tsp_graph_swap_edges(graph, i, j);
 				break;
 				case MOVE_TYPE_INTER:
 					tsp_graph_inter_swap(graph, i, j);
@@ -116,9 +108,9 @@ void lsearch_steepest(struct tsp_graph *graph)
 
 void iterated_lsearch_steepest_perturb(struct tsp_graph *graph, perturb_func_t perturb_func, clock_t deadline)
 {
-	struct tsp_graph *const graph_copy = tsp_graph_empty();
+	struct tsp_graph *const graph_copy = tsp_graph_pool_acquire(graph_pool);
 	tsp_graph_copy(graph_copy, graph);
-	const size_t target_size = graph->dist_matrix.size / 2;
+	const size_t target_size = graph->dist_matrix->size / 2;
 
 	unsigned long best_score = ULONG_MAX;
 	for (size_t i = 0; i < N_MULTISTART && clock() < deadline; i++) {
@@ -130,7 +122,7 @@ void iterated_lsearch_steepest_perturb(struct tsp_graph *graph, perturb_func_t p
 		while (clock() < deadline) {
 			perturb_func(graph_copy);
 			lsearch_steepest(graph_copy);
-			const unsigned long score = tsp_nodes_evaluate(graph_copy->nodes_active, &graph_copy->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph_copy);
 			if (score < best_score) {
 				best_score = score;
 				tsp_graph_copy(graph, graph_copy);
@@ -138,7 +130,7 @@ void iterated_lsearch_steepest_perturb(struct tsp_graph *graph, perturb_func_t p
 		}
 		/* printf("perturb delta:\t%ld [TERMINATE; temp=%.3f]\n", perturb_delta, anneal_temp); */
 	}
-	tsp_graph_destroy(graph_copy);
+	tsp_graph_pool_release(graph_pool, graph_copy);
 }
 
 struct lsearch_move random_move(const struct tsp_graph *graph)
@@ -169,10 +161,10 @@ void perturb(struct tsp_graph *graph)
 			     j = move.indices.dest;
 		switch (move.type) {
 			case MOVE_TYPE_NODES:
-				tsp_nodes_swap_nodes(graph->nodes_active, i, j);
+				tsp_graph_swap_nodes(graph, i, j);
 			break;
 			case MOVE_TYPE_EDGES:
-				tsp_nodes_swap_edges(graph->nodes_active, i, j);
+				tsp_graph_swap_edges(graph, i, j);
 			break;
 			case MOVE_TYPE_INTER:
 				tsp_graph_inter_swap(graph, i, j);
@@ -186,9 +178,9 @@ void perturb(struct tsp_graph *graph)
 
 void multistart_lsearch_steepest(struct tsp_graph *graph)
 {
-	struct tsp_graph *const graph_copy = tsp_graph_empty();
+	struct tsp_graph *const graph_copy = tsp_graph_pool_acquire(graph_pool);
 	tsp_graph_copy(graph_copy, graph);
-	const size_t target_size = graph->dist_matrix.size / 2;
+	const size_t target_size = graph->dist_matrix->size / 2;
 
 	unsigned long best_score = ULONG_MAX;
 	for (size_t i = 0; i < N_MULTISTART; i++) {
@@ -199,13 +191,13 @@ void multistart_lsearch_steepest(struct tsp_graph *graph)
 		tsp_graph_activate_random(graph_copy, target_size);
 
 		lsearch_steepest(graph_copy);
-		const unsigned long score = tsp_nodes_evaluate(graph_copy->nodes_active, &graph_copy->dist_matrix);
+		const unsigned long score = tsp_graph_score(graph_copy);
 		if (score < best_score) {
 			best_score = score;
 			tsp_graph_copy(graph, graph_copy);
 		}
 	}
-	tsp_graph_destroy(graph_copy);
+	tsp_graph_pool_release(graph_pool, graph_copy);
 }
 
 void iterated_lsearch_steepest(struct tsp_graph *graph)
@@ -245,7 +237,9 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
+		graph_pool = tsp_graph_pool_create(graph, 1);
+		intra_rows = tsp_intra_rows_create(graph->dist_matrix->size);
 
 		for (int j = 0; j < N_EXPERIMENTS; j++) {
 			tsp_graph_deactivate_all(graph);
@@ -257,7 +251,7 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 			lsearch_algo(graph);
 			time_after = clock();
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			const double time = (double)(time_after - time_before) / CLOCKS_PER_SEC;
 			score_min[i] = MIN(score, score_min[i]);
 			time_min[i] = MIN(time, time_min[i]);
@@ -273,6 +267,8 @@ void run_lsearch_algorithm(const char *label, lsearch_func_t lsearch_algo)
 			lsearch_runs_sum[i] += lsearch_counter;
 		}
 
+		tsp_intra_rows_destroy(intra_rows);
+		tsp_graph_pool_destroy(graph_pool);
 		tsp_graph_destroy(graph);
 	}
 
@@ -33,6 +33,8 @@ static const char *nodes_files[] = {
 };
 static struct sp_stack *nodes[ARRLEN(nodes_files)];
 static size_t main_counter;
+static struct tsp_graph_pool *graph_pool;  /* Work graphs of the current instance */
+static struct tsp_intra_rows *intra_rows;  /* Row scan layout of the current instance */
 
 void greedy_cycle(struct tsp_graph *graph, size_t target_size);
 void lsearch_steepest(struct tsp_graph *graph);
@@ -42,29 +44,26 @@ void large_scale_search_with_lsearch(struct tsp_graph *graph);
 
 void greedy_cycle(struct tsp_graph *graph, size_t target_size)
 {
-	struct sp_stack *vacant = graph->nodes_vacant;
-	struct sp_stack *active = graph->nodes_active;
+	struct tsp_tour *vacant = graph->nodes_vacant;
+	struct tsp_tour *active = graph->nodes_active;
 
 	if (active->size == 0 && target_size != 0)
 		tsp_graph_activate_random(graph, 1);
 	if (active->size == 1 && target_size != 1) {
-		const struct tsp_node node = *(struct tsp_node*)sp_stack_peek(active);
-		const size_t idx = tsp_nodes_find_nn(vacant, &graph->dist_matrix, node);
+		const size_t idx = tsp_nodes_find_nn(vacant, graph->dist_matrix, tsp_tour_peek(active));
 		tsp_graph_activate_node(graph, idx);
 	}
 	while (active->size < target_size) {
-		struct tsp_node node;
 		const struct tsp_move move = tsp_graph_find_nc(graph);
-		node = *(struct tsp_node*)sp_stack_get(vacant, move.src);
-		sp_stack_remove(vacant, move.src, NULL);
-		sp_stack_insert(active, move.dest, &node);
+		tsp_graph_insert(graph, move);
 	}
 }
 
 void lsearch_steepest(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
-	struct sp_stack *const vacant = graph->nodes_vacant;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
+	struct tsp_intra_rows *const rows = intra_rows;
 
 	bool did_improve = true;
 	while (did_improve) {
@@ -72,40 +71,29 @@ void lsearch_steepest(struct tsp_graph *graph)
 		long min_delta = 0;
 		did_improve = false;
 
+		tsp_intra_rows_load(rows, active, graph->dist_matrix);
 		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = i; j < active->size; j++) {
-				long delta;
-
-				delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_NODES;
-					did_improve = true;
-				}
-
-				delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_EDGES;
-					did_improve = true;
-				}
+			size_t j;
+			bool edges;
+			const long delta = tsp_intra_rows_find_best(rows, i, &j, &edges);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = edges ? MOVE_TYPE_EDGES : MOVE_TYPE_NODES;
+				did_improve = true;
 			}
 		}
 
-		for (size_t i = 0; i < active->size; i++) {
-			for (size_t j = 0; j < vacant->size; j++) {
-				const long delta = tsp_graph_evaluate_inter_swap(graph, i, j);
-				if (delta < min_delta) {
-					min_delta = delta;
-					best_move.indices.src = i;
-					best_move.indices.dest = j;
-					best_move.type = MOVE_TYPE_INTER;
-					did_improve = true;
-				}
+		for (size_t i = 0; i < active->size && vacant->size != 0; i++) {
+			size_t j;
+			const long delta = tsp_graph_find_best_inter_swap(graph, i, &j);
+			if (delta < min_delta) {
+				min_delta = delta;
+				best_move.indices.src = i;
+				best_move.indices.dest = j;
+				best_move.type = MOVE_TYPE_INTER;
+				did_improve = true;
 			}
 		}
 
@@ -114,10 +102,10 @@ void lsearch_steepest(struct tsp_graph *graph)
 			             j = best_move.indices.dest;
 			switch (best_move.type) {
 				case MOVE_TYPE_NODES:
-					tsp_nodes_swap_nodes(active, i, j);
+					tsp_graph_swap_nodes(graph, i, j);
 				break;
 				case MOVE_TYPE_EDGES:
-					tsp_nodes_swap_edges(active, i, j);
+					tsp_graph_swap_edges(graph, i, j);
 				break;
 				case MOVE_TYPE_INTER:
 					tsp_graph_inter_swap(graph, i, j);
@@ -136,9 +124,9 @@ void large_scale_lsearch_steepest(struct tsp_graph *graph, bool use_lsearch)
 	const clock_t timeout_cycles = (ITERATED_TIMEOUT_MS / 1000.0) * CLOCKS_PER_SEC;
 	const clock_t deadline = clock() + timeout_cycles;
 
-	struct tsp_graph *const graph_copy = tsp_graph_empty();
+	struct tsp_graph *const graph_copy = tsp_graph_pool_acquire(graph_pool);
 	tsp_graph_copy(graph_copy, graph);
-	const size_t target_size = graph->dist_matrix.size / 2;
+	const size_t target_size = graph->dist_matrix->size / 2;
 
 	unsigned long best_score = ULONG_MAX;
 	for (size_t i = 0; i < N_MULTISTART && clock() < deadline; i++) {
@@ -152,14 +140,14 @@ void large_scale_lsearch_steepest(struct tsp_graph *graph, bool use_lsearch)
 		while (clock() < deadline) {
 			main_counter++;
 			tsp_graph_large_scale_destroy_repair(graph, ROUND(DESTROY_PERC * graph->nodes_active->size));
-			const unsigned long score = tsp_nodes_evaluate(graph_copy->nodes_active, &graph_copy->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph_copy);
 			if (score < best_score) {
 				best_score = score;
 				tsp_graph_copy(graph, graph_copy);
 			}
 		}
 	}
-	tsp_graph_destroy(graph_copy);
+	tsp_graph_pool_release(graph_pool, graph_copy);
 }
 
 void large_scale_search(struct tsp_graph *graph)
@@ -202,7 +190,9 @@ void run_search_algorithm(const char *label, search_func_t search_algo, bool gre
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		struct tsp_graph *const graph = tsp_graph_create(nodes[i]);
 		const size_t target_size = nodes[i]->size / 2;
-		best_solution[i] = tsp_graph_create(nodes[i]);
+		best_solution[i] = tsp_graph_create_shared(graph);
+		graph_pool = tsp_graph_pool_create(graph, 1);
+		intra_rows = tsp_intra_rows_create(graph->dist_matrix->size);
 
 		/* Run search_algo from greedy solutions */
 		for (int j = 0; j < N_EXPERIMENTS; j++) {
@@ -221,7 +211,7 @@ void run_search_algorithm(const char *label, search_func_t search_algo, bool gre
 			search_algo(graph);
 			time_after = clock();
 
-			const unsigned long score = tsp_nodes_evaluate(graph->nodes_active, &graph->dist_matrix);
+			const unsigned long score = tsp_graph_score(graph);
 			const double time = (double)(time_after - time_before) / CLOCKS_PER_SEC;
 			score_min[i] = MIN(score, score_min[i]);
 			time_min[i] = MIN(time, time_min[i]);
@@ -237,6 +227,8 @@ void run_search_algorithm(const char *label, search_func_t search_algo, bool gre
 			main_runs_sum[i] += main_counter;
 		}
 
+		tsp_intra_rows_destroy(intra_rows);
+		tsp_graph_pool_destroy(graph_pool);
 		tsp_graph_destroy(graph);
 	}
 
@@ -8,7 +8,7 @@
 #include <float.h>
 
 /* Typedefs */
-typedef size_t (*sim_func_t)(const struct sp_stack *nodes1, const struct sp_stack *nodes2);
+typedef size_t (*sim_func_t)(const struct tsp_graph *graph1, const struct tsp_graph *graph2);
 
 #define NO_ITERS 1000
 
@@ -74,7 +74,7 @@ struct sp_stack *init_moves(size_t n_nodes)
 
 void lsearch_greedy(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	struct tsp_tour *const active = graph->nodes_active;
 	struct sp_stack *const all_moves = init_moves(active->size);
 	struct sp_stack *const moves = sp_stack_create(sizeof(struct lsearch_move), all_moves->size);
 
@@ -90,16 +90,16 @@ void lsearch_greedy(struct tsp_graph *graph)
 			long delta;
 			switch (m.type) {
 				case MOVE_TYPE_NODES:
-					delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_nodes_evaluate_swap_nodes(active, graph->dist_matrix, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_nodes(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_nodes(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
 				case MOVE_TYPE_EDGES:
-					delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_nodes_evaluate_swap_edges(active, graph->dist_matrix, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_edges(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_edges(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
@@ -124,48 +124,77 @@ void lsearch_greedy(struct tsp_graph *graph)
 	sp_stack_destroy(all_moves, NULL);
 }
 
+/* Makes the route of graph the one in nodes */
+void load_solution(struct tsp_graph *graph, const struct tsp_tour *nodes)
+{
+	tsp_graph_deactivate_all(graph);
+	for (size_t i = nodes->size; i-- > 0;) {
+		tsp_graph_activate_node_by_id(graph, tsp_tour_get(nodes, i));
+	}
+}
+
 /* Generate a single plot.
  * Arguments:
  * - `data_fpath`: output filename (csv)
  * - `instance`: the type of instance (`INST_TSPA`, `INST_TSPB`, ...)
  * - `similarity`: the similarity function to use
  * - `reference_solution`: a solution to compare to, or `NULL` to compare with the average of NO_ITERS instances.
+ *
+ * Local optima are kept encoded in a solution store rather than as graphs,
+ * and decoded one at a time in streaming passes over it.
  */
-void compute_similarities(const char *data_fpath, enum instance instance, sim_func_t similarity, const struct sp_stack *reference_solution)
+void compute_similarities(const char *data_fpath, enum instance instance, sim_func_t similarity, const struct tsp_graph *reference_solution)
 {
 	/* Initialization */
-	struct tsp_graph **const graphs = malloc_or_die(NO_ITERS * sizeof(struct tsp_graph*));
-	unsigned long *const graph_scores = malloc_or_die(NO_ITERS * sizeof(unsigned long));
+	struct tsp_optstore *const optima = tsp_optstore_create(NULL);
+	struct tsp_optstore_reader reader;
 	size_t *const sims = malloc_or_die(NO_ITERS * sizeof(size_t));
 	const size_t target_size = nodes[instance]->size / 2;
+	struct tsp_graph *const instance_graph = tsp_graph_create(nodes[instance]);
+	struct tsp_graph_pool *const pool = tsp_graph_pool_create(instance_graph, 2);
+	struct tsp_tour *const solution = tsp_tour_create(target_size);
+	unsigned long score;
 
 	/* Generate NO_ITERS local optima solutions and compute their similarities to the reference solution */
 	for (size_t i = 0; i < NO_ITERS; i++) {
 		fprintf(stderr, "\r   Generating solutions...  %3zu.%zu%%", i * 100 / NO_ITERS, (i * 1000 / NO_ITERS) % 10);
-		graphs[i] = tsp_graph_create(nodes[instance]);
-		tsp_graph_activate_random(graphs[i], target_size);
-		lsearch_greedy(graphs[i]);
-		graph_scores[i] = tsp_nodes_evaluate(graphs[i]->nodes_active, &graphs[i]->dist_matrix);
+		struct tsp_graph *const graph = tsp_graph_pool_acquire(pool);
+		tsp_graph_activate_random(graph, target_size);
+		lsearch_greedy(graph);
+		tsp_optstore_append(optima, graph->nodes_active, tsp_graph_score(graph));
 
 		if (reference_solution != NULL) {
-			sims[i] = similarity(graphs[i]->nodes_active, reference_solution);
+			sims[i] = similarity(graph, reference_solution);
 		}
+		tsp_graph_pool_release(pool, graph);
 	}
 	fprintf(stderr, "\r   Generating solutions...  100%%  \n");
 
 	if (reference_solution == NULL) {
 		/* Compute each solution's average similarity to all other solutions */
-		for (size_t i = 0; i < NO_ITERS; i++) {
+		struct tsp_graph *const graph1 = tsp_graph_pool_acquire(pool);
+		struct tsp_graph *const graph2 = tsp_graph_pool_acquire(pool);
+		tsp_optstore_reader_open(&reader, optima);
+		while (tsp_optstore_read(&reader, solution, &score)) {
+			const size_t i = reader.index - 1;
+			struct tsp_optstore_reader others;
 			fprintf(stderr, "\r   Computing average similarities...  %3zu.%zu%%", i / 10, i % 10);
+			load_solution(graph1, solution);
 			double sum = 0.0;
-			for (size_t j = 0; j < NO_ITERS; j++) {
-				if (j == i) {
+			tsp_optstore_reader_open(&others, optima);
+			while (tsp_optstore_read(&others, solution, &score)) {
+				if (others.index - 1 == i) {
 					continue;
 				}
-				sum += similarity(graphs[i]->nodes_active, graphs[j]->nodes_active);
+				load_solution(graph2, solution);
+				sum += similarity(graph1, graph2);
 			}
+			tsp_optstore_reader_close(&others);
 			sims[i] = ROUND(sum / NO_ITERS);
 		}
+		tsp_optstore_reader_close(&reader);
+		tsp_graph_pool_release(pool, graph1);
+		tsp_graph_pool_release(pool, graph2);
 		fprintf(stderr, "\r   Computing average similarities...  100%%  \n");
 	}
 
@@ -173,19 +202,20 @@ void compute_similarities(const char *data_fpath, enum instance instance, sim_fu
 	FILE *fout = fopen(data_fpath, "w");
 	if (fout == NULL) {
 		perror("Failed to open file for writing");
-		return;
-	}
-	for (size_t i = 0; i < NO_ITERS; i++) {
-		fprintf(fout, "%lu,%zu\n", graph_scores[i], sims[i]);
+	} else {
+		tsp_optstore_reader_open(&reader, optima);
+		while (tsp_optstore_read(&reader, solution, &score)) {
+			fprintf(fout, "%lu,%zu\n", score, sims[reader.index - 1]);
+		}
+		tsp_optstore_reader_close(&reader);
+		fclose(fout);
 	}
-	fclose(fout);
 
 	/* Cleanup */
-	for (size_t i = 0; i < NO_ITERS; i++) {
-		tsp_graph_destroy(graphs[i]);
-	}
-	free(graphs);
-	free(graph_scores);
+	tsp_tour_destroy(solution);
+	tsp_graph_pool_destroy(pool);
+	tsp_graph_destroy(instance_graph);
+	tsp_optstore_destroy(optima);
 	free(sims);
 }
 
@@ -206,7 +236,7 @@ void plot_similarities(const char *data_fpath, const char *plot_fpath)
 	fprintf(stderr, "done.\n");
 }
 
-void run(enum instance instance, sim_func_t similarity, const struct sp_stack *reference_solution)
+void run(enum instance instance, sim_func_t similarity, const struct tsp_graph *reference_solution)
 {
 	char data_fpath[64];
 	char plot_fpath[64];
@@ -218,9 +248,9 @@ void run(enum instance instance, sim_func_t similarity, const struct sp_stack *r
 		case INST_TSPC: fprintf(stderr, "TSPC, "); break;
 		case INST_TSPD: fprintf(stderr, "TSPD, "); break;
 	}
-	if (similarity == tsp_nodes_compute_similarity_nodes) {
+	if (similarity == tsp_graph_compute_similarity_nodes) {
 		fprintf(stderr, "sim=nodes, ");
-	} else if (similarity == tsp_nodes_compute_similarity_edges) {
+	} else if (similarity == tsp_graph_compute_similarity_edges) {
 		fprintf(stderr, "sim=edges, ");
 	}
 	switch ((int)(reference_solution != NULL)) {
@@ -230,12 +260,12 @@ void run(enum instance instance, sim_func_t similarity, const struct sp_stack *r
 
 	sprintf(data_fpath, "results/TSP%c_%s_%s.csv",
 		'A' + instance,
-		similarity == tsp_nodes_compute_similarity_nodes ? "nodes" : "edges",
+		similarity == tsp_graph_compute_similarity_nodes ? "nodes" : "edges",
 		reference_solution != NULL ? "best" : "avg"
 	);
 	sprintf(plot_fpath, "results/TSP%c_%s_%s.pdf",
 		'A' + instance,
-		similarity == tsp_nodes_compute_similarity_nodes ? "nodes" : "edges",
+		similarity == tsp_graph_compute_similarity_nodes ? "nodes" : "edges",
 		reference_solution != NULL ? "best" : "avg"
 	);
 
@@ -260,25 +290,25 @@ int main(void)
 		starting_graphs[i] = tsp_graph_import(best_graphs[i]);
 	}
 
-	run(INST_TSPA, tsp_nodes_compute_similarity_nodes, starting_graphs[INST_TSPA]->nodes_active);
-	run(INST_TSPB, tsp_nodes_compute_similarity_nodes, starting_graphs[INST_TSPB]->nodes_active);
-	run(INST_TSPC, tsp_nodes_compute_similarity_nodes, starting_graphs[INST_TSPC]->nodes_active);
-	run(INST_TSPD, tsp_nodes_compute_similarity_nodes, starting_graphs[INST_TSPD]->nodes_active);
+	run(INST_TSPA, tsp_graph_compute_similarity_nodes, starting_graphs[INST_TSPA]);
+	run(INST_TSPB, tsp_graph_compute_similarity_nodes, starting_graphs[INST_TSPB]);
+	run(INST_TSPC, tsp_graph_compute_similarity_nodes, starting_graphs[INST_TSPC]);
+	run(INST_TSPD, tsp_graph_compute_similarity_nodes, starting_graphs[INST_TSPD]);
 
-	run(INST_TSPA, tsp_nodes_compute_similarity_edges, starting_graphs[INST_TSPA]->nodes_active);
-	run(INST_TSPB, tsp_nodes_compute_similarity_edges, starting_graphs[INST_TSPB]->nodes_active);
-	run(INST_TSPC, tsp_nodes_compute_similarity_edges, starting_graphs[INST_TSPC]->nodes_active);
-	run(INST_TSPD, tsp_nodes_compute_similarity_edges, starting_graphs[INST_TSPD]->nodes_active);
+	run(INST_TSPA, tsp_graph_compute_similarity_edges, starting_graphs[INST_TSPA]);
+	run(INST_TSPB, tsp_graph_compute_similarity_edges, starting_graphs[INST_TSPB]);
+	run(INST_TSPC, tsp_graph_compute_similarity_edges, starting_graphs[INST_TSPC]);
+	run(INST_TSPD, tsp_graph_compute_similarity_edges, starting_graphs[INST_TSPD]);
 
-	run(INST_TSPA, tsp_nodes_compute_similarity_nodes, NULL);
-	run(INST_TSPB, tsp_nodes_compute_similarity_nodes, NULL);
-	run(INST_TSPC, tsp_nodes_compute_similarity_nodes, NULL);
-	run(INST_TSPD, tsp_nodes_compute_similarity_nodes, NULL);
+	run(INST_TSPA, tsp_graph_compute_similarity_nodes, NULL);
+	run(INST_TSPB, tsp_graph_compute_similarity_nodes, NULL);
+	run(INST_TSPC, tsp_graph_compute_similarity_nodes, NULL);
+	run(INST_TSPD, tsp_graph_compute_similarity_nodes, NULL);
 
-	run(INST_TSPA, tsp_nodes_compute_similarity_edges, NULL);
-	run(INST_TSPB, tsp_nodes_compute_similarity_edges, NULL);
-	run(INST_TSPC, tsp_nodes_compute_similarity_edges, NULL);
-	run(INST_TSPD, tsp_nodes_compute_similarity_edges, NULL);
+	run(INST_TSPA, tsp_graph_compute_similarity_edges, NULL);
+	run(INST_TSPB, tsp_graph_compute_similarity_edges, NULL);
+	run(INST_TSPC, tsp_graph_compute_similarity_edges, NULL);
+	run(INST_TSPD, tsp_graph_compute_similarity_edges, NULL);
 
 	for (size_t i = 0; i < ARRLEN(nodes_files); i++) {
 		sp_stack_destroy(nodes[i], NULL);
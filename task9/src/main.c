@@ -61,10 +61,14 @@ struct sp_stack *init_moves(size_t n_nodes)
 
 void lsearch_greedy(struct tsp_graph *graph)
 {
-	struct sp_stack *const active = graph->nodes_active;
+	struct tsp_tour *const active = graph->nodes_active;
+	struct tsp_tour *const vacant = graph->nodes_vacant;
 	struct sp_stack *const all_moves = init_moves(active->size);
 	struct sp_stack *const moves = sp_stack_create(sizeof(struct lsearch_move), all_moves->size);
 
+	struct tsp_eval eval;
+	tsp_eval_init(&eval, graph->dist_matrix);
+
 	bool did_improve = true;
 	while (did_improve) {
 		sp_stack_copy(moves, all_moves, NULL);
@@ -77,21 +81,21 @@ void lsearch_greedy(struct tsp_graph *graph)
 			long delta;
 			switch (m.type) {
 				case MOVE_TYPE_NODES:
-					delta = tsp_nodes_evaluate_swap_nodes(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_eval_swap_nodes(&eval, active, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_nodes(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_nodes(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
 				case MOVE_TYPE_EDGES:
-					delta = tsp_nodes_evaluate_swap_edges(active, &graph->dist_matrix, m.indices.src, m.indices.dest);
+					delta = tsp_eval_swap_edges(&eval, active, m.indices.src, m.indices.dest);
 					if (delta < 0) {
-						tsp_nodes_swap_edges(active, m.indices.src, m.indices.dest);
+						tsp_graph_swap_edges(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
 					}
 				break;
 				case MOVE_TYPE_INTER:
-					delta = tsp_graph_evaluate_inter_swap(graph, m.indices.src, m.indices.dest);
+					delta = tsp_eval_inter_swap(&eval, active, vacant, m.indices.src, m.indices.dest);
 					if (delta < 0) {
 						tsp_graph_inter_swap(graph, m.indices.src, m.indices.dest);
 						did_improve = true;
@@ -128,11 +132,8 @@ void offspring_func_fill_repair(struct tsp_graph *graph, const struct tsp_graph
 	tsp_graph_deactivate_all(graph);
 	tsp_graph_activate_common_from_parents(graph, parent1, parent2);
 	while (graph->nodes_active->size < parent1->nodes_active->size) {
-		struct tsp_node node;
 		const struct tsp_move move = tsp_graph_find_nc(graph);
-		node = *(struct tsp_node*)sp_stack_get(graph->nodes_vacant, move.src);
-		sp_stack_remove(graph->nodes_vacant, move.src, NULL);
-		sp_stack_insert(graph->nodes_active, move.dest, &node);
+		tsp_graph_insert(graph, move);
 	}
 	assert(graph->nodes_active->size == parent1->nodes_active->size);
 }
@@ -158,8 +159,11 @@ void run_evolutionary_algorithm(const char *label, size_t population_size, offsp
 
 		const size_t target_size = nodes[i]->size / 2;
 		best_solution[i] = tsp_graph_create(nodes[i]);
+
+		/* The population and a child, recycled so that the timed loop does not allocate */
+		struct tsp_graph_pool *const pool = tsp_graph_pool_create(best_solution[i], population_size + 1);
 		for (size_t j = 0; j < population_size; j++) {
-			population[j] = tsp_graph_create(nodes[i]);
+			population[j] = tsp_graph_pool_acquire(pool);
 		}
 
 		/* Run evolutionary from greedy solutions */
@@ -174,7 +178,7 @@ void run_evolutionary_algorithm(const char *label, size_t population_size, offsp
 			const clock_t deadline = clock() + timeout_cycles;
 			while (clock() < deadline) {
 				/* Advance population by `population_size` new children (steady-state) */
-				struct tsp_graph *const child = tsp_graph_create(nodes[i]);
+				struct tsp_graph *const child = tsp_graph_pool_acquire(pool);
 				for (size_t k = 0; k < population_size; k++) {
 					/* Choose parents */
 					const size_t parent1_idx = randint(0, population_size - 1);
@@ -189,18 +193,18 @@ void run_evolutionary_algorithm(const char *label, size_t population_size, offsp
 					tsp_graph_deactivate_all(child);
 					offspring_func(child, parent1, parent2);
 					for (size_t l = 0; l < population_size; l++) {
-						if (tsp_nodes_eq(child->nodes_active, population[l]->nodes_active)) {
+						if (tsp_graph_eq(child, population[l])) {
 							/* This solution already exists in the population */
 							goto skip_to_next_child;
 						}
 					}
-					const unsigned long child_score = tsp_nodes_evaluate(child->nodes_active, &child->dist_matrix);
+					const unsigned long child_score = tsp_graph_score(child);
 
 					/* Find the worst solution in the population */
 					size_t worst_idx = 0;
 					unsigned long worst_score = 0;
 					for (size_t l = 0; l < population_size; l++) {
-						const unsigned long score = tsp_nodes_evaluate(population[l]->nodes_active, &population[l]->dist_matrix);
+						const unsigned long score = tsp_graph_score(population[l]);
 						if (worst_score < score) {
 							worst_score = score;
 							worst_idx = l;
@@ -214,14 +218,14 @@ void run_evolutionary_algorithm(const char *label, size_t population_size, offsp
 
 					skip_to_next_child: ;
 				}
-				tsp_graph_destroy(child);
+				tsp_graph_pool_release(pool, child);
 			}
 
 			/* Find the best solution in the population */
 			size_t best_idx = 0;
 			unsigned long best_score = ULONG_MAX;
 			for (size_t k = 0; k < population_size; k++) {
-				const unsigned long score = tsp_nodes_evaluate(population[k]->nodes_active, &population[k]->dist_matrix);
+				const unsigned long score = tsp_graph_score(population[k]);
 				if (score < best_score) {
 					best_score = score;
 					best_idx = k;
@@ -238,8 +242,9 @@ void run_evolutionary_algorithm(const char *label, size_t population_size, offsp
 		}
 
 		for (size_t j = 0; j < population_size; j++) {
-			tsp_graph_destroy(population[j]);
+			tsp_graph_pool_release(pool, population[j]);
 		}
+		tsp_graph_pool_destroy(pool);
 		free(population);
 	}
 